@@ -1,9 +1,10 @@
 
+// Per-object matrices, concatenated on the CPU (see TransformationBuffer in Scene.h)
 cbuffer TransformationBuffer : register(b0)
 {
 	matrix ModelToWorldMatrix;
-	matrix WorldToViewMatrix;
-	matrix ProjectionMatrix;
+	matrix ModelToClipMatrix;	// Projection * WorldToView * ModelToWorld
+	matrix NormalMatrix;		// Inverse transpose of ModelToWorld
 };
 
 struct VSIn
@@ -33,16 +34,10 @@ PSIn VS_main(VSIn input)
 {
 	PSIn output = (PSIn)0;
 	
-	// Model->View transformation
-	matrix MV = mul(WorldToViewMatrix, ModelToWorldMatrix);
-
-	// Model->View->Projection (clip space) transformation
-	// SV_Position expects the output position to be in clip space
-	matrix MVP = mul(ProjectionMatrix, MV);
-	
 	// Perform transformations and send to output
-	output.Pos = mul(MVP, float4(input.Pos, 1));
-	output.Normal = normalize( mul(ModelToWorldMatrix, float4(input.Normal,0)).xyz );
+	// SV_Position expects the output position to be in clip space
+	output.Pos = mul(ModelToClipMatrix, float4(input.Pos, 1));
+	output.Normal = normalize( mul(NormalMatrix, float4(input.Normal,0)).xyz );
 	float texScale = 1;
 	output.TexCoord = input.TexCoord * texScale;
 	output.WorldPos = mul(ModelToWorldMatrix, float4(input.Pos, 1));
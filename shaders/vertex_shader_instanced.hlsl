@@ -0,0 +1,56 @@
+// World-to-clip matrix of the frame (see InstancingBuffer in Scene.h)
+cbuffer InstancingBuffer : register(b0)
+{
+	matrix WorldToClipMatrix;	// Projection * WorldToView
+};
+
+struct VSIn
+{
+	float3 Pos : POSITION;
+	float3 Normal : NORMAL;
+	float3 Tangent : TANGENT;
+	float3 Binormal : BINORMAL;
+	float2 TexCoord : TEX;
+
+	// Per instance, see InstanceData in Instancing.h
+	float4 ModelToWorld0 : WORLD0;
+	float4 ModelToWorld1 : WORLD1;
+	float4 ModelToWorld2 : WORLD2;
+	float4 Normal0 : NORMALMATRIX0;
+	float4 Normal1 : NORMALMATRIX1;
+	float4 Normal2 : NORMALMATRIX2;
+};
+
+struct PSIn
+{
+	float4 Pos  : SV_Position;
+	float3 Normal : NORMAL;
+	float2 TexCoord : TEX;
+	float4 WorldPos : POSITION;
+	float3 Tangent : TANGENT;
+	float3 Binormal : BINORMAL;
+};
+
+//-----------------------------------------------------------------------------------------
+// Vertex Shader
+//-----------------------------------------------------------------------------------------
+
+PSIn VS_main(VSIn input)
+{
+	PSIn output = (PSIn)0;
+
+	float3x4 ModelToWorldMatrix = float3x4(input.ModelToWorld0, input.ModelToWorld1, input.ModelToWorld2);
+	float3x3 NormalMatrix = float3x3(input.Normal0.xyz, input.Normal1.xyz, input.Normal2.xyz);
+
+	// Perform transformations and send to output
+	// SV_Position expects the output position to be in clip space
+	output.WorldPos = float4(mul(ModelToWorldMatrix, float4(input.Pos, 1)), 1);
+	output.Pos = mul(WorldToClipMatrix, output.WorldPos);
+	output.Normal = normalize( mul(NormalMatrix, input.Normal) );
+	float texScale = 1;
+	output.TexCoord = input.TexCoord * texScale;
+	output.Tangent = normalize(mul((float3x3)ModelToWorldMatrix, input.Tangent));
+	output.Binormal = normalize(mul((float3x3)ModelToWorldMatrix, input.Binormal));
+		
+	return output;
+}
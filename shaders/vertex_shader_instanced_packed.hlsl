@@ -0,0 +1,78 @@
+// World-to-clip matrix of the frame (see InstancingBuffer in Scene.h)
+cbuffer InstancingBuffer : register(b0)
+{
+	matrix WorldToClipMatrix;	// Projection * WorldToView
+};
+
+// Dequantization of packed positions, see VertexQuantization in VertexFormat.h
+cbuffer VertexQuantizationBuffer : register(b1)
+{
+	float4 PositionScale;
+	float4 PositionOffset;
+};
+
+// PackedVertex, see VertexFormat.h
+struct VSIn
+{
+	float4 Pos : POSITION;		// xyz in [0,1] over the mesh AABB, w = binormal sign (1 = +, 0 = -)
+	float2 Normal : NORMAL;		// octahedral
+	float2 Tangent : TANGENT;	// octahedral
+	float2 TexCoord : TEX;
+
+	// Per instance, see InstanceData in Instancing.h
+	float4 ModelToWorld0 : WORLD0;
+	float4 ModelToWorld1 : WORLD1;
+	float4 ModelToWorld2 : WORLD2;
+	float4 Normal0 : NORMALMATRIX0;
+	float4 Normal1 : NORMALMATRIX1;
+	float4 Normal2 : NORMALMATRIX2;
+};
+
+struct PSIn
+{
+	float4 Pos  : SV_Position;
+	float3 Normal : NORMAL;
+	float2 TexCoord : TEX;
+	float4 WorldPos : POSITION;
+	float3 Tangent : TANGENT;
+	float3 Binormal : BINORMAL;
+};
+
+// Unit vector from the [-1,1]^2 octahedral square
+float3 OctDecode(float2 e)
+{
+	float3 n = float3(e, 1 - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0 ? -t : t;
+	return normalize(n);
+}
+
+//-----------------------------------------------------------------------------------------
+// Vertex Shader
+//-----------------------------------------------------------------------------------------
+
+PSIn VS_main(VSIn input)
+{
+	PSIn output = (PSIn)0;
+
+	// Unpack
+	float3 pos = PositionOffset.xyz + input.Pos.xyz * PositionScale.xyz;
+	float3 normal = OctDecode(input.Normal);
+	float3 tangent = OctDecode(input.Tangent);
+	float3 binormal = cross(normal, tangent) * (input.Pos.w * 2 - 1);
+
+	float3x4 ModelToWorldMatrix = float3x4(input.ModelToWorld0, input.ModelToWorld1, input.ModelToWorld2);
+	float3x3 NormalMatrix = float3x3(input.Normal0.xyz, input.Normal1.xyz, input.Normal2.xyz);
+
+	// Perform transformations and send to output
+	// SV_Position expects the output position to be in clip space
+	output.WorldPos = float4(mul(ModelToWorldMatrix, float4(pos, 1)), 1);
+	output.Pos = mul(WorldToClipMatrix, output.WorldPos);
+	output.Normal = normalize( mul(NormalMatrix, normal) );
+	float texScale = 1;
+	output.TexCoord = input.TexCoord * texScale;
+	output.Tangent = normalize(mul((float3x3)ModelToWorldMatrix, tangent));
+	output.Binormal = normalize(mul((float3x3)ModelToWorldMatrix, binormal));
+		
+	return output;
+}
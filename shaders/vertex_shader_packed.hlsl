@@ -0,0 +1,69 @@
+// Per-object matrices, concatenated on the CPU (see TransformationBuffer in Scene.h)
+cbuffer TransformationBuffer : register(b0)
+{
+	matrix ModelToWorldMatrix;
+	matrix ModelToClipMatrix;	// Projection * WorldToView * ModelToWorld
+	matrix NormalMatrix;		// Inverse transpose of ModelToWorld
+};
+
+// Dequantization of packed positions, see VertexQuantization in VertexFormat.h
+cbuffer VertexQuantizationBuffer : register(b1)
+{
+	float4 PositionScale;
+	float4 PositionOffset;
+};
+
+// PackedVertex, see VertexFormat.h
+struct VSIn
+{
+	float4 Pos : POSITION;		// xyz in [0,1] over the mesh AABB, w = binormal sign (1 = +, 0 = -)
+	float2 Normal : NORMAL;		// octahedral
+	float2 Tangent : TANGENT;	// octahedral
+	float2 TexCoord : TEX;
+};
+
+struct PSIn
+{
+	float4 Pos  : SV_Position;
+	float3 Normal : NORMAL;
+	float2 TexCoord : TEX;
+	float4 WorldPos : POSITION;
+	float3 Tangent : TANGENT;
+	float3 Binormal : BINORMAL;
+};
+
+// Unit vector from the [-1,1]^2 octahedral square
+float3 OctDecode(float2 e)
+{
+	float3 n = float3(e, 1 - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0 ? -t : t;
+	return normalize(n);
+}
+
+//-----------------------------------------------------------------------------------------
+// Vertex Shader
+//-----------------------------------------------------------------------------------------
+
+PSIn VS_main(VSIn input)
+{
+	PSIn output = (PSIn)0;
+
+	// Unpack
+	float3 pos = PositionOffset.xyz + input.Pos.xyz * PositionScale.xyz;
+	float3 normal = OctDecode(input.Normal);
+	float3 tangent = OctDecode(input.Tangent);
+	float3 binormal = cross(normal, tangent) * (input.Pos.w * 2 - 1);
+
+	// Perform transformations and send to output
+	// SV_Position expects the output position to be in clip space
+	output.Pos = mul(ModelToClipMatrix, float4(pos, 1));
+	output.Normal = normalize( mul(NormalMatrix, float4(normal,0)).xyz );
+	float texScale = 1;
+	output.TexCoord = input.TexCoord * texScale;
+	output.WorldPos = mul(ModelToWorldMatrix, float4(pos, 1));
+	output.Tangent = normalize(mul(ModelToWorldMatrix, float4(tangent, 0)).xyz);
+	output.Binormal = normalize(mul(ModelToWorldMatrix, float4(binormal, 0)).xyz);
+		
+	return output;
+}
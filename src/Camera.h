@@ -4,6 +4,9 @@
 //
 //	Basic camera class
 //
+//	The view and projection matrices are cached, and rebuilt on access only
+//	after the position, orientation or aperture attributes have changed
+//
 
 #pragma once
 #ifndef CAMERA_H
@@ -11,6 +14,7 @@
 
 #include "vec\vec.h"
 #include "vec\mat.h"
+#include "vec\quat.h"
 
 using namespace linalg;
 
@@ -59,68 +63,166 @@ public:
 
 	void moveForward(const float& v, float& dt) 
 	{
-		vec4f fwdView = { 0, 0, -1, 0 };
-		mat4f rotationmatrix = mat4f::rotation(0, yaw, pitch);
-		mat4f pos = mat4f::translation(position);
-		mat4f viewtoworld = pos * rotationmatrix;
-		vec4f fwdWorld = viewtoworld * fwdView;
-		position += fwdWorld.xyz() * v * dt;
+		vec3f fwdWorld = quatf::rotation(0.0f, yaw, pitch).rotate({ 0, 0, -1 });
+		position += fwdWorld * v * dt;
 	}
 
 	void moveBackward(const float& v, float& dt) 
 	{
-		vec4f bwdView = { 0, 0, 1, 0 };
-		mat4f rotationmatrix = mat4f::rotation(0, yaw, pitch);
-		mat4f pos = mat4f::translation(position);
-		mat4f viewtoworld = pos * rotationmatrix;
-		vec4f bwdWorld = viewtoworld * bwdView;
-		position += bwdWorld.xyz() * v * dt;
+		vec3f bwdWorld = quatf::rotation(0.0f, yaw, pitch).rotate({ 0, 0, 1 });
+		position += bwdWorld * v * dt;
 	}
 
 	void moveLeft(const float& v, float& dt) 
 	{
-		vec4f leftView = { 1, 0, 0, 0 };
-		mat4f rotationmatrix = mat4f::rotation(0, yaw, pitch);
-		mat4f pos = mat4f::translation(position);
-		mat4f viewtoworld = pos * rotationmatrix;
-		vec4f leftWorld = viewtoworld * leftView;
-		position += leftWorld.xyz() * v * dt;
+		vec3f leftWorld = quatf::rotation(0.0f, yaw, pitch).rotate({ 1, 0, 0 });
+		position += leftWorld * v * dt;
 	}
 
 	void moveRight(const float& v, float& dt) 
 	{
-		vec4f rightView = {-1, 0, 0, 0 };
-		mat4f rotationmatrix = mat4f::rotation(0, yaw, pitch);
-		mat4f pos = mat4f::translation(position);
-		mat4f viewtoworld = pos * rotationmatrix;
-		vec4f rightWorld = viewtoworld * rightView;
-		position += rightWorld.xyz() * v * dt;
+		vec3f rightWorld = quatf::rotation(0.0f, yaw, pitch).rotate({ -1, 0, 0 });
+		position += rightWorld * v * dt;
 	}
 
 	// Return World-to-View matrix for this camera
 	//
-	mat4f get_WorldToViewMatrix()
-	{
-		// Assuming a camera's position and rotation is defined by matrices T(p) and R,
-		// the View-to-World transform is T(p)*R (for a first-person style camera).
-		//
-		// World-to-View then is the inverse of T(p)*R;
-		//		inverse(T(p)*R) = inverse(R)*inverse(T(p)) = transpose(R)*T(-p)
-		// Since now there is no rotation, this matrix is simply T(-p)
-		
-		mat4f rotationmatrix = mat4f::rotation(0, yaw, pitch);			
-		rotationmatrix.transpose();
+	const mat4f& get_WorldToViewMatrix()
+	{
+		Update();
+		return view;
+	}
 
-		return rotationmatrix * mat4f::translation(-position);		
+	// Return View-to-World matrix for this camera
+	//
+	const mat4f& get_ViewToWorldMatrix()
+	{
+		Update();
+		return view_inverse;
 	}
 
 	// Matrix transforming from View space to Clip space
-	// In a performance sensitive situation this matrix should be precomputed
-	// if possible
 	//
-	mat4f get_ProjectionMatrix()
+	const mat4f& get_ProjectionMatrix()
+	{
+		Update();
+		return projection;
+	}
+
+	// Matrix transforming from World space to Clip space, Projection * World-to-View
+	//
+	const mat4f& get_ViewProjectionMatrix()
+	{
+		Update();
+		return view_projection;
+	}
+
+	// The six world space planes of the view frustum, left, right, bottom, top,
+	// near and far. A point p is on the inside of plane P when
+	// dot(P.xyz(), p) + P.w >= 0; the planes are normalized so this is the
+	// signed distance to the plane
+	//
+	const vec4f* get_FrustumPlanes()
+	{
+		Update();
+		return frustum_planes;
+	}
+
+	// Number of times the matrices have been rebuilt since the last reset
+	//
+	unsigned get_RebuildCount() const
+	{
+		return rebuild_count;
+	}
+
+	void ResetRebuildCount()
+	{
+		rebuild_count = 0;
+	}
+
+private:
+	// The attributes the cached matrices were built from
+	struct state_t
+	{
+		vec3f position;
+		float yaw, pitch;
+		float vfov, aspect, zNear, zFar;
+
+		bool ViewEquals(const state_t& s) const
+		{
+			return position.x == s.position.x && position.y == s.position.y && position.z == s.position.z &&
+				yaw == s.yaw && pitch == s.pitch;
+		}
+
+		bool ProjectionEquals(const state_t& s) const
+		{
+			return vfov == s.vfov && aspect == s.aspect && zNear == s.zNear && zFar == s.zFar;
+		}
+	};
+
+	state_t built_state;
+	bool built = false;
+	unsigned rebuild_count = 0;
+
+	mat4f view, view_inverse, projection, view_projection;
+	vec4f frustum_planes[6];
+
+	// Rebuild the cached matrices if any of the public attributes changed
+	// since they were last built. The attributes are public and written
+	// directly, so they are compared against a snapshot rather than
+	// tracked by setters
+	//
+	void Update()
+	{
+		const state_t state = { position, yaw, pitch, vfov, aspect, zNear, zFar };
+		const bool view_dirty = !built || !state.ViewEquals(built_state);
+		const bool projection_dirty = !built || !state.ProjectionEquals(built_state);
+		if (!view_dirty && !projection_dirty)
+			return;
+
+		if (view_dirty)
+		{
+			// Assuming a camera's position and rotation is defined by matrices T(p) and R,
+			// the View-to-World transform is T(p)*R (for a first-person style camera).
+			//
+			// World-to-View then is the inverse of T(p)*R;
+			//		inverse(T(p)*R) = inverse(R)*inverse(T(p)) = transpose(R)*T(-p)
+			// which is what inverse_rigid computes, without a general inverse
+			view_inverse = mat4f::translation(position) * mat4f::rotation(0, yaw, pitch);
+			view = inverse_rigid(view_inverse);
+		}
+		if (projection_dirty)
+			projection = mat4f::projection(vfov, aspect, zNear, zFar);
+
+		view_projection = projection * view;
+		ExtractFrustumPlanes();
+
+		built_state = state;
+		built = true;
+		rebuild_count++;
+	}
+
+	// Clip space is -w <= x, y, z <= w, so with rows r1..r4 of the
+	// View-to-Clip matrix the planes are r4 + r1, r4 - r1 etc.
+	// (Gribb & Hartmann)
+	//
+	void ExtractFrustumPlanes()
 	{
-		return mat4f::projection(vfov, aspect, zNear, zFar);
+		const mat4f& M = view_projection;
+		const vec4f r1 = { M.m11, M.m12, M.m13, M.m14 };
+		const vec4f r2 = { M.m21, M.m22, M.m23, M.m24 };
+		const vec4f r3 = { M.m31, M.m32, M.m33, M.m34 };
+		const vec4f r4 = { M.m41, M.m42, M.m43, M.m44 };
+
+		frustum_planes[0] = r4 + r1;
+		frustum_planes[1] = r4 - r1;
+		frustum_planes[2] = r4 + r2;
+		frustum_planes[3] = r4 - r2;
+		frustum_planes[4] = r4 + r3;
+		frustum_planes[5] = r4 - r3;
+
+		for (vec4f& P : frustum_planes)
+			P = P * (1.0f / P.xyz().norm2());
 	}
 };
 
@@ -0,0 +1,24 @@
+//
+//  ConstantRing.cpp
+//
+
+#include "ConstantRing.h"
+
+bool ConstantRing::Allocate(
+	size_t size,
+	size_t& offset,
+	bool& discard)
+{
+	size = Align(size);
+	if (size == 0 || size > capacity)
+		return false;
+
+	// Wrap when the range does not fit before the end
+	if (head + size > capacity)
+		head = 0;
+
+	offset = head;
+	discard = offset == 0;
+	head += size;
+	return true;
+}
@@ -0,0 +1,56 @@
+//
+//  ConstantRing.h
+//
+//  Ring allocation of constant buffer ranges
+//
+
+#pragma once
+#ifndef CONSTANTRING_H
+#define CONSTANTRING_H
+
+#include <cstddef>
+
+//
+// Constant ring
+//
+// Hands out ranges of one large dynamic constant buffer, front to back,
+// to be bound per draw with constant buffer offsets (D3D11.1
+// XSSetConstantBuffers1). Ranges handed out since the buffer was last
+// discarded are never handed out again, so they can be written with
+// WRITE_NO_OVERWRITE while the GPU still reads earlier ones. When the
+// ring is full, it wraps to the start, and that range must be written
+// with WRITE_DISCARD, which gives the buffer new memory. Only offsets are
+// tracked; the buffer itself belongs to the caller.
+//
+class ConstantRing
+{
+public:
+	// Constant buffer offsets and sizes are multiples of 16 constants
+	// of 16 bytes
+	static const size_t Alignment = 256;
+
+	static constexpr size_t Align(size_t size) { return (size + Alignment - 1) & ~(Alignment - 1); }
+
+	explicit ConstantRing(size_t capacity = 0) : capacity(capacity & ~(Alignment - 1)) { }
+
+	//
+	// Allocate size bytes, rounded up to Alignment. Returns false if size
+	// is 0 or larger than the ring. discard is set if the range is to be written
+	// with WRITE_DISCARD (it starts at offset 0), else WRITE_NO_OVERWRITE
+	//
+	bool Allocate(
+		size_t size,
+		size_t& offset,
+		bool& discard);
+
+	size_t Capacity() const { return capacity; }
+
+	// Offset of the next allocation
+	size_t Head() const { return head; }
+
+private:
+	size_t capacity;
+	size_t head = 0;
+};
+
+#endif
@@ -61,6 +61,10 @@ struct Material
 	Texture specular_texture;
 	// + other texture types
 	Texture cube_texture;
+
+	// Device constant buffer holding the colors and shininess, created once
+	// the material is loaded (see Model::CreateMaterialBuffer)
+	ID3D11Buffer* constant_buffer = nullptr;
 };
 
 static Material DefaultMaterial = Material();
@@ -91,4 +95,15 @@ struct Drawcall
     }
 };
 
+//
+// Index range, representing a drawcall, within an index array
+//
+struct IndexRange
+{
+	unsigned int start;
+	unsigned int size;
+	unsigned ofs;		// base vertex, added to each index when drawn
+	int mtl_index;
+};
+
 #endif
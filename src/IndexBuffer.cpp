@@ -0,0 +1,95 @@
+//
+//  IndexBuffer.cpp
+//
+//  Packing of index arrays into 16- or 32-bit GPU index buffers
+//
+
+#include <algorithm>
+#include "IndexBuffer.h"
+
+static const unsigned MaxSpan16 = 0xffff;	// max - min of a 16-bit range
+
+//
+// Append the 16-bit ranges of a range to packed, writing their indices
+// relative to the base vertex of each. Returns false if some triangle cannot
+// be expressed with 16-bit indices
+//
+static bool PackRange16(
+	const unsigned* indices,
+	const IndexRange& range,
+	PackedIndices& packed)
+{
+	const unsigned* begin = indices + range.start;
+	const unsigned* end = begin + range.size;
+
+	auto emit = [&](IndexRange sub, unsigned base)
+	{
+		for (unsigned i = sub.start; i < sub.start + sub.size; i++)
+			packed.indices16[i] = (uint16_t)(indices[i] - base);
+		sub.ofs = range.ofs + base;
+		packed.ranges.push_back(sub);
+	};
+
+	// Ranges that fit as they are keep their base vertex
+	if (begin == end || *std::max_element(begin, end) <= MaxSpan16)
+	{
+		emit(range, 0);
+		return true;
+	}
+
+	IndexRange current = { range.start, 0, 0, range.mtl_index };
+	unsigned lo = ~0u, hi = 0;
+	for (unsigned i = 0; i < range.size; i += 3)
+	{
+		const unsigned* tri = begin + i;
+		const unsigned tri_lo = std::min(std::min(tri[0], tri[1]), tri[2]);
+		const unsigned tri_hi = std::max(std::max(tri[0], tri[1]), tri[2]);
+		if (tri_hi - tri_lo > MaxSpan16)
+			return false;
+
+		// Close the current range if the triangle does not fit in it
+		if (current.size && std::max(hi, tri_hi) - std::min(lo, tri_lo) > MaxSpan16)
+		{
+			emit(current, lo);
+			current.start += current.size;
+			current.size = 0;
+			lo = ~0u; hi = 0;
+		}
+		lo = std::min(lo, tri_lo);
+		hi = std::max(hi, tri_hi);
+		current.size += 3;
+	}
+	emit(current, lo);
+	return true;
+}
+
+PackedIndices PackIndices(
+	const unsigned* indices,
+	size_t nbr_indices,
+	const std::vector<IndexRange>& ranges,
+	bool allow_16bit)
+{
+	PackedIndices packed;
+
+	if (allow_16bit)
+	{
+		// Indices not covered by any range are never drawn and packed as 0
+		packed.index_size = 2;
+		packed.indices16.assign(nbr_indices, 0);
+
+		bool fits = true;
+		for (auto& range : ranges)
+			if (!(fits = PackRange16(indices, range, packed)))
+				break;
+		if (fits)
+			return packed;
+
+		packed.indices16.clear();
+		packed.ranges.clear();
+	}
+
+	packed.index_size = 4;
+	packed.indices32.assign(indices, indices + nbr_indices);
+	packed.ranges = ranges;
+	return packed;
+}
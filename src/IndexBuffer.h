@@ -0,0 +1,59 @@
+//
+//  IndexBuffer.h
+//
+//  Packing of index arrays into 16- or 32-bit GPU index buffers
+//
+
+#pragma once
+#ifndef INDEXBUFFER_H
+#define INDEXBUFFER_H
+
+#include <cstdint>
+#include <vector>
+#include "Drawcall.h"
+
+// Upload index buffers with 16-bit indices whenever their ranges allow it
+#define INDEX_BUFFER_16BIT
+
+//
+// Index data in its GPU layout, with the ranges to draw it by
+//
+// With 16-bit indices, each range holds indices relative to its base vertex
+// (IndexRange::ofs, the BaseVertexLocation of DrawIndexed). Ranges are only
+// rebased if they reference vertices past 65535, and ranges that span more
+// than 65536 vertices are split at triangle boundaries, in which case there
+// are more ranges than went in (with the same mtl_index)
+//
+struct PackedIndices
+{
+	unsigned index_size = 4;			// bytes per index, 2 or 4
+	std::vector<uint16_t> indices16;	// used if index_size is 2
+	std::vector<uint32_t> indices32;	// used if index_size is 4
+	std::vector<IndexRange> ranges;
+
+	const void* Data() const
+	{
+		return index_size == 2 ? (const void*)indices16.data() : (const void*)indices32.data();
+	}
+
+	unsigned Count() const
+	{
+		return (unsigned)(index_size == 2 ? indices16.size() : indices32.size());
+	}
+
+	size_t ByteSize() const { return (size_t)Count() * index_size; }
+};
+
+//
+// Pack an index array drawn by ranges of triangles. Indices are relative to
+// the ofs of their range, as for DrawIndexed. Falls back to 32-bit indices,
+// leaving the ranges as they are, if allow_16bit is false or a triangle spans
+// more than 65536 vertices
+//
+PackedIndices PackIndices(
+	const unsigned* indices,
+	size_t nbr_indices,
+	const std::vector<IndexRange>& ranges,
+	bool allow_16bit = true);
+
+#endif
@@ -0,0 +1,118 @@
+//
+//  Instancing.cpp
+//
+
+#include "Instancing.h"
+#include <algorithm>
+#include <cassert>
+
+const D3D11_INPUT_ELEMENT_DESC InstanceLayout[6] =
+{
+	{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "NORMALMATRIX", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "NORMALMATRIX", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "NORMALMATRIX", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 80, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+};
+
+std::vector<D3D11_INPUT_ELEMENT_DESC> InstancedLayout(
+	const D3D11_INPUT_ELEMENT_DESC* vertex_layout,
+	size_t nbr_elements)
+{
+	std::vector<D3D11_INPUT_ELEMENT_DESC> layout(vertex_layout, vertex_layout + nbr_elements);
+	layout.insert(layout.end(), InstanceLayout, InstanceLayout + ARRAYSIZE(InstanceLayout));
+	return layout;
+}
+
+unsigned ModelInstances::AddMaterial(const Material* mtl)
+{
+	materials.push_back(mtl);
+	return (unsigned)materials.size() - 1;
+}
+
+unsigned ModelInstances::AddInstance(
+	const mat4f& ModelToWorldMatrix,
+	unsigned material)
+{
+	assert(material < std::max<size_t>(materials.size(), 1));
+
+	model_to_world.push_back(ModelToWorldMatrix);
+	instance_material.push_back(material);
+	return (unsigned)model_to_world.size() - 1;
+}
+
+size_t ModelInstances::Gather(
+	const vec4f* frustum_planes,
+	CullStats& stats)
+{
+	const size_t n = model_to_world.size();
+	if (visible_capacity < n)
+	{
+		visible.reset(new bool[n]);
+		visible_capacity = n;
+	}
+
+	size_t nbr_visible = n;
+	if (frustum_planes)
+	{
+		// World space bounds of all instances, tested in one batch
+		const aabb3f& bounds = model->GetBounds();
+		world_bounds.resize(n);
+		for (size_t i = 0; i < n; i++)
+			world_bounds[i] = transform_aabb(model_to_world[i], bounds);
+		nbr_visible = cull_aabbs(frustum_planes, world_bounds.data(), visible.get(), n);
+
+		stats.instances_tested += (unsigned)n;
+		stats.instances_culled += (unsigned)(n - nbr_visible);
+	}
+	else
+		std::fill(visible.get(), visible.get() + n, true);
+
+	// Visible instances per material, then a batch for each material that
+	// has any, in palette order
+	const size_t nbr_materials = std::max<size_t>(materials.size(), 1);
+	material_next.assign(nbr_materials, 0);
+	for (size_t i = 0; i < n; i++)
+		material_next[instance_material[i]] += visible[i];
+
+	batches.clear();
+	unsigned first = 0;
+	for (unsigned m = 0; m < nbr_materials; m++)
+	{
+		const unsigned count = material_next[m];
+		if (!count)
+			continue;
+		batches.push_back({ m, first, count });
+		material_next[m] = first;
+		first += count;
+	}
+
+	// Place the visible instances in their batches, keeping their order
+	visible_model_to_world.resize(nbr_visible);
+	visible_normal.resize(nbr_visible);
+	for (size_t i = 0; i < n; i++)
+	{
+		if (visible[i])
+			visible_model_to_world[material_next[instance_material[i]]++] = model_to_world[i];
+	}
+	normal_matrices(visible_model_to_world.data(), visible_normal.data(), nbr_visible);
+
+	return nbr_visible;
+}
+
+void ModelInstances::WriteVisible(InstanceData* out) const
+{
+	for (size_t i = 0; i < visible_model_to_world.size(); i++)
+	{
+		const mat4f& M = visible_model_to_world[i];
+		const mat4f& N = visible_normal[i];
+		InstanceData& data = out[i];
+		data.ModelToWorldRows[0] = { M.m11, M.m12, M.m13, M.m14 };
+		data.ModelToWorldRows[1] = { M.m21, M.m22, M.m23, M.m24 };
+		data.ModelToWorldRows[2] = { M.m31, M.m32, M.m33, M.m34 };
+		data.NormalRows[0] = { N.m11, N.m12, N.m13, 0 };
+		data.NormalRows[1] = { N.m21, N.m22, N.m23, 0 };
+		data.NormalRows[2] = { N.m31, N.m32, N.m33, 0 };
+	}
+}
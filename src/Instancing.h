@@ -0,0 +1,140 @@
+//
+//  Instancing.h
+//
+//  Instances of a model drawn with one instanced draw per drawcall and material
+//
+
+#pragma once
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <vector>
+#include <memory>
+#include "Model.h"
+
+//
+// Per-instance data, in vertex buffer slot 1 of the instanced vertex
+// shaders (see InstanceLayout). Rows of the affine model-to-world matrix
+// and of the normal matrix. The model-to-clip matrix is the world-to-clip
+// matrix of the frame times the model-to-world matrix, in the shader
+//
+struct InstanceData
+{
+	vec4f ModelToWorldRows[3];
+	vec4f NormalRows[3];	// w = 0
+};
+
+static_assert(sizeof(InstanceData) == 96, "InstanceData must match InstanceLayout");
+
+//
+// Input layout of InstanceData, in vertex buffer slot 1
+//
+extern const D3D11_INPUT_ELEMENT_DESC InstanceLayout[6];
+
+//
+// Input layout of a vertex layout in slot 0 followed by InstanceLayout
+//
+std::vector<D3D11_INPUT_ELEMENT_DESC> InstancedLayout(
+	const D3D11_INPUT_ELEMENT_DESC* vertex_layout,
+	size_t nbr_elements);
+
+//
+// Model instances
+//
+// Instances of one model, each with its own model-to-world matrix and a
+// material from a palette. Gather culls the instances and orders the
+// visible ones by material, in one batch per material, so that each
+// drawcall of the model is drawn once per batch with DrawIndexedInstanced,
+// however many instances there are. With an empty palette, drawcalls are
+// drawn with their own materials.
+//
+class ModelInstances
+{
+public:
+	//
+	// Visible instances of one material, at [first, first + count)
+	// of the instances written by WriteVisible
+	//
+	struct Batch
+	{
+		unsigned material;
+		unsigned first;
+		unsigned count;
+	};
+
+	explicit ModelInstances(const Model* model) : model(model) { }
+
+	const Model* GetModel() const { return model; }
+
+	//
+	// Add a material to the palette, returns its index. Materials are
+	// owned by the caller
+	//
+	unsigned AddMaterial(const Material* mtl);
+
+	//
+	// Add an instance, returns its index. material is an index into the
+	// palette, 0 if the palette is empty
+	//
+	unsigned AddInstance(
+		const mat4f& ModelToWorldMatrix,
+		unsigned material = 0);
+
+	void SetTransform(
+		unsigned instance,
+		const mat4f& ModelToWorldMatrix)
+	{
+		model_to_world[instance] = ModelToWorldMatrix;
+	}
+
+	unsigned InstanceCount() const { return (unsigned)model_to_world.size(); }
+
+	//
+	// Material to draw the drawcall of instances with material with
+	//
+	const Material* DrawcallMaterial(
+		unsigned material,
+		unsigned drawcall) const
+	{
+		return materials.empty() ? model->DrawcallMaterial(drawcall) : materials[material];
+	}
+
+	//
+	// Test the world space bounds of each instance against world space
+	// frustum planes (all instances are visible if frustum_planes is
+	// nullptr), and batch the visible instances by material. Returns the
+	// number of visible instances
+	//
+	size_t Gather(
+		const vec4f* frustum_planes,
+		CullStats& stats);
+
+	const std::vector<Batch>& Batches() const { return batches; }
+
+	size_t VisibleCount() const { return visible_model_to_world.size(); }
+
+	//
+	// Write the instance data of the visible instances, in batch order,
+	// to out[0..VisibleCount())
+	//
+	void WriteVisible(InstanceData* out) const;
+
+private:
+	const Model* model;
+	std::vector<const Material*> materials;
+
+	// Per instance
+	std::vector<mat4f> model_to_world;
+	std::vector<unsigned> instance_material;
+
+	// Gather results and scratch
+	std::vector<aabb3f> world_bounds;
+	std::unique_ptr<bool[]> visible;
+	size_t visible_capacity = 0;
+	std::vector<unsigned> material_next;	// per material, the next slot of its batch
+	std::vector<Batch> batches;
+	std::vector<mat4f> visible_model_to_world;
+	std::vector<mat4f> visible_normal;
+};
+
+#endif
@@ -34,7 +34,9 @@ ID3D11Texture2D*        g_DepthStencil			= nullptr;
 ID3D11DepthStencilView* g_DepthStencilView		= nullptr;
 ID3D11Device*			g_Device				= nullptr;
 ID3D11DeviceContext*	g_DeviceContext			= nullptr;
+ID3D11DeviceContext1*	g_DeviceContext1		= nullptr;
 ID3D11RasterizerState*	g_RasterState			= nullptr;
+std::unique_ptr<StateCache> g_StateCache;
 
 shader_data*			g_VertexShader			= nullptr;
 shader_data*			g_PixelShader			= nullptr;
@@ -108,23 +110,29 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 
 			g_DeviceContext->OMSetRenderTargets( 1, &g_RenderTargetView, g_DepthStencilView );
 
-			const D3D11_INPUT_ELEMENT_DESC inputDesc[5] = {
-					{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-					{ "TEX", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 48, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
+#ifdef VERTEX_FORMAT_PACKED
+			// Layout of PackedVertex, see VertexFormat.h
+			const D3D11_INPUT_ELEMENT_DESC* inputDesc = PackedVertexLayout;
+			const uint32_t inputDescCount = (uint32_t)ARRAYSIZE(PackedVertexLayout);
+			const char* vertex_shader_path = "shaders/vertex_shader_packed.hlsl";
+#else
+			const D3D11_INPUT_ELEMENT_DESC* inputDesc = VertexLayout;
+			const uint32_t inputDescCount = (uint32_t)ARRAYSIZE(VertexLayout);
+			const char* vertex_shader_path = "shaders/vertex_shader.hlsl";
+#endif
 
-			if (FAILED(create_shader(g_Device,  "shaders/vertex_shader.hlsl", "VS_main", SHADER_VERTEX, &inputDesc[0], 5, &g_VertexShader)) || 
+			if (FAILED(create_shader(g_Device, vertex_shader_path, "VS_main", SHADER_VERTEX, inputDesc, inputDescCount, &g_VertexShader)) || 
 				FAILED(create_shader(g_Device, "shaders/pixel_shader.hlsl", "PS_main", SHADER_PIXEL, nullptr, 0, &g_PixelShader)))
 			{
 				__debugbreak();
 			}
 
+			g_StateCache = std::make_unique<StateCache>(g_DeviceContext, g_DeviceContext1);
+
 			scene = std::make_unique<OurTestScene>(
 				g_Device,
 				g_DeviceContext,
+				g_StateCache.get(),
 				g_InitialWinWidth,
 				g_InitialWinHeight);
 			scene->Init();
@@ -288,6 +296,12 @@ HRESULT InitDirect3DAndSwapChain(int width, int height)
 	SETNAME(g_Device, "Device");
 	SETNAME(g_DeviceContext, "Context");
 #endif // _DEBUG
+
+	// The Direct3D 11.1 interface of the context, for binding ranges of
+	// constant buffers. Without it, g_DeviceContext1 stays nullptr and
+	// objects map their constants one at a time
+	if (SUCCEEDED(hr) && FAILED(g_DeviceContext->QueryInterface(&g_DeviceContext1)))
+		g_DeviceContext1 = nullptr;
 	return hr;
 }
 
@@ -386,12 +400,23 @@ HRESULT Render(float deltaTime)
 	// Clear depth and stencil buffer
 	g_DeviceContext->ClearDepthStencilView( g_DepthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0 );
 	
+	// Binding call counters per frame
+	g_StateCache->ResetStats();
+
 	// Set topology
-	g_DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	g_StateCache->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		
-	// Bind shaders
-	bind_shader(g_Device, g_DeviceContext, g_VertexShader);
-	bind_shader(g_Device, g_DeviceContext, g_PixelShader);
+	// Hot reload shaders if changed, and bind them through the state cache
+	bind_shader(g_Device, nullptr, g_VertexShader);
+	bind_shader(g_Device, nullptr, g_PixelShader);
+	ID3D11VertexShader* vertex_shader;
+	ID3D11InputLayout* input_layout;
+	ID3D11PixelShader* pixel_shader;
+	get_shader_objects(g_VertexShader, &vertex_shader, &input_layout, nullptr);
+	get_shader_objects(g_PixelShader, nullptr, nullptr, &pixel_shader);
+	g_StateCache->IASetInputLayout(input_layout);
+	g_StateCache->VSSetShader(vertex_shader);
+	g_StateCache->PSSetShader(pixel_shader);
 	//g_DeviceContext->VSSetShader(g_VertexShader, nullptr, 0);
 	g_DeviceContext->HSSetShader(nullptr, nullptr, 0);
 	g_DeviceContext->DSSetShader(nullptr, nullptr, 0);
@@ -414,6 +439,7 @@ HRESULT Render(float deltaTime)
 void Release()
 {
 	SAFE_RELEASE(scene);
+	g_StateCache.reset();
 
 	SAFE_DELETE(g_InputHandler);
 
@@ -425,6 +451,7 @@ void Release()
 	SAFE_RELEASE(g_DepthStencil);
 	SAFE_RELEASE(g_DepthStencilView);
 	SAFE_RELEASE(g_RasterState);
+	SAFE_RELEASE(g_DeviceContext1);
 	SAFE_RELEASE(g_DeviceContext);
 #ifdef _DEBUG
 	/*
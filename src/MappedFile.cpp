@@ -0,0 +1,145 @@
+//
+//  MappedFile.cpp
+//
+//  Read-only, in-place view of a whole file
+//
+
+#include "MappedFile.h"
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+	return Map(filename) || Read(filename);
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Map(const std::string& filename)
+{
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		// Empty files cannot be mapped, but are read trivially
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	data = (const char*)view;
+	size = (size_t)file_size.QuadPart;
+	mapped = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mapped)
+	{
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE)mapping_handle);
+		CloseHandle((HANDLE)file_handle);
+		file_handle = mapping_handle = nullptr;
+	}
+	buffer.clear();
+	buffer.shrink_to_fit();
+	data = nullptr;
+	size = 0;
+	mapped = false;
+}
+
+#else
+
+bool MappedFile::Map(const std::string& filename)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after the descriptor is closed
+	close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	data = (const char*)view;
+	size = (size_t)st.st_size;
+	mapped = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mapped)
+		munmap((void*)data, size);
+	buffer.clear();
+	buffer.shrink_to_fit();
+	data = nullptr;
+	size = 0;
+	mapped = false;
+}
+
+#endif
+
+bool MappedFile::Read(const std::string& filename)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+	if (!in)
+		return false;
+
+	std::streamoff file_size = in.tellg();
+	if (file_size < 0)
+		return false;
+	in.seekg(0);
+
+	buffer.resize((size_t)file_size);
+	if (file_size && !in.read(buffer.data(), file_size))
+	{
+		buffer.clear();
+		return false;
+	}
+
+	data = buffer.data();
+	size = buffer.size();
+	mapped = false;
+	return true;
+}
@@ -0,0 +1,59 @@
+//
+//  MappedFile.h
+//
+//  Read-only, in-place view of a whole file
+//
+
+#pragma once
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+
+//
+// Maps a file into memory so that parsers can walk it in place.
+// If mapping fails (e.g. on file systems that do not support it),
+// the file is instead read into a single heap buffer.
+//
+class MappedFile
+{
+	const char* data = nullptr;
+	size_t size = 0;
+	bool mapped = false;
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+
+	// Fallback storage when the file could not be mapped
+	std::vector<char> buffer;
+
+	bool Map(const std::string& filename);
+	bool Read(const std::string& filename);
+
+public:
+
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+
+	~MappedFile() { Close(); }
+
+	//
+	// Open a file for reading. Returns false if the file could not be opened
+	//
+	bool Open(const std::string& filename);
+
+	void Close();
+
+	const char* Data() const { return data; }
+	const char* End() const { return data + size; }
+	size_t Size() const { return size; }
+
+	// True if the view is backed by a memory mapping rather than a copy
+	bool IsMapped() const { return mapped; }
+};
+
+#endif
@@ -0,0 +1,183 @@
+//
+//  MeshAsset.cpp
+//
+//  Device meshes shared between models, with a registry that hands them out
+//
+
+#include "MeshAsset.h"
+#include "Model.h"
+#include "VertexFormat.h"
+#include "IndexBuffer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <climits>
+#include <cstdlib>
+#endif
+
+MeshAsset::~MeshAsset()
+{
+	SAFE_RELEASE(vertex_buffer);
+	SAFE_RELEASE(index_buffer);
+	SAFE_RELEASE(vertex_quantization_buffer);
+	for (auto& material : materials)
+		Model::ReleaseMaterial(material);
+}
+
+void MeshAsset::CreateVertexBuffer(
+	ID3D11Device* dxdevice,
+	const Vertex* vertices,
+	unsigned nbr_vertices)
+{
+	const void* vertex_data = vertices;
+
+#ifdef VERTEX_FORMAT_PACKED
+	std::vector<PackedVertex> packed;
+	VertexQuantization quantization;
+	PackVertices(vertices, nbr_vertices, packed, quantization);
+	vertex_data = packed.data();
+	vertex_stride = sizeof(PackedVertex);
+
+	// Constant buffer with the position dequantization, never updated
+	D3D11_BUFFER_DESC qbufferDesc = { 0 };
+	qbufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	qbufferDesc.CPUAccessFlags = 0;
+	qbufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	qbufferDesc.MiscFlags = 0;
+	qbufferDesc.ByteWidth = sizeof(VertexQuantization);
+	D3D11_SUBRESOURCE_DATA qdata;
+	qdata.pSysMem = &quantization;
+	ASSERT(dxdevice->CreateBuffer(&qbufferDesc, &qdata, &vertex_quantization_buffer));
+	SETNAME(vertex_quantization_buffer, "VertexQuantizationBuffer");
+#endif
+
+	// Vertex array descriptor
+	D3D11_BUFFER_DESC vbufferDesc = { 0 };
+	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbufferDesc.CPUAccessFlags = 0;
+	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	vbufferDesc.MiscFlags = 0;
+	vbufferDesc.ByteWidth = nbr_vertices * vertex_stride;
+	// Data resource
+	D3D11_SUBRESOURCE_DATA vdata;
+	vdata.pSysMem = vertex_data;
+	// Create vertex buffer on device using descriptor & data
+	ASSERT(dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer));
+	SETNAME(vertex_buffer, "VertexBuffer");
+
+	vertex_bytes = vbufferDesc.ByteWidth;
+}
+
+void MeshAsset::CreateIndexBuffer(
+	ID3D11Device* dxdevice,
+	const unsigned* indices,
+	unsigned nbr_indices)
+{
+#ifdef INDEX_BUFFER_16BIT
+	PackedIndices packed = PackIndices(indices, nbr_indices, index_ranges);
+#else
+	PackedIndices packed = PackIndices(indices, nbr_indices, index_ranges, false);
+#endif
+	index_format = packed.index_size == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	index_ranges = packed.ranges;
+
+	// Index array descriptor
+	D3D11_BUFFER_DESC ibufferDesc = { 0 };
+	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibufferDesc.CPUAccessFlags = 0;
+	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	ibufferDesc.MiscFlags = 0;
+	ibufferDesc.ByteWidth = (UINT)packed.ByteSize();
+	// Data resource
+	D3D11_SUBRESOURCE_DATA idata;
+	idata.pSysMem = packed.Data();
+	// Create index buffer on device using descriptor & data
+	ASSERT(dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer));
+	SETNAME(index_buffer, "IndexBuffer");
+
+	index_bytes = ibufferDesc.ByteWidth;
+}
+
+aabb3f MeshAsset::IndexedBounds(
+	const Vertex* vertices,
+	const unsigned* indices,
+	unsigned nbr_indices)
+{
+	if (!nbr_indices)
+		return { { 0, 0, 0 }, { 0, 0, 0 } };
+
+	aabb3f box = { vertices[indices[0]].Pos, vertices[indices[0]].Pos };
+	for (unsigned i = 1; i < nbr_indices; i++)
+	{
+		const vec3f& p = vertices[indices[i]].Pos;
+		box.min = { std::min(box.min.x, p.x), std::min(box.min.y, p.y), std::min(box.min.z, p.z) };
+		box.max = { std::max(box.max.x, p.x), std::max(box.max.y, p.y), std::max(box.max.z, p.z) };
+	}
+	return box;
+}
+
+size_t MeshAsset::TextureBytes() const
+{
+	size_t bytes = 0;
+	for (const Material& mtl : materials)
+	{
+		bytes += (size_t)mtl.diffuse_texture.width * mtl.diffuse_texture.height * 4;
+		bytes += (size_t)mtl.normal_texture.width * mtl.normal_texture.height * 4;
+		bytes += (size_t)mtl.specular_texture.width * mtl.specular_texture.height * 4;
+		// 6 faces
+		bytes += (size_t)mtl.cube_texture.width * mtl.cube_texture.height * 4 * 6;
+	}
+	return bytes;
+}
+
+size_t MeshAsset::ConstantBytes() const
+{
+	size_t bytes = vertex_quantization_buffer ? sizeof(VertexQuantization) : 0;
+	for (const Material& mtl : materials)
+		bytes += mtl.constant_buffer ? sizeof(MaterialBuffer_t) : 0;
+	return bytes;
+}
+
+size_t MeshAsset::DeviceBytes() const
+{
+	return vertex_bytes + index_bytes + TextureBytes() + ConstantBytes();
+}
+
+std::string MeshRegistry::CanonicalPath(const std::string& path)
+{
+#ifdef _WIN32
+	char full[MAX_PATH];
+	DWORD length = GetFullPathNameA(path.c_str(), MAX_PATH, full, NULL);
+	std::string canonical = length && length < MAX_PATH ? std::string(full, length) : path;
+
+	// Paths are not case sensitive, and may use either separator
+	for (char& c : canonical)
+		c = c == '/' ? '\\' : (char)std::tolower((unsigned char)c);
+	return canonical;
+#else
+	char full[PATH_MAX];
+	return realpath(path.c_str(), full) ? std::string(full) : path;
+#endif
+}
+
+void MeshRegistry::PrintReport() const
+{
+	size_t total = 0;
+	printf("Mesh assets (%u loads, %u shared):\n", stats.loads, stats.hits);
+	for (const auto& entry : assets)
+	{
+		std::shared_ptr<const MeshAsset> asset = entry.second.lock();
+		if (!asset)
+			continue;
+
+		// Less the reference held here
+		printf("\t%s: %ld users, vertices %zu KB, indices %zu KB, textures %zu KB, constants %zu B\n",
+			asset->name.c_str(), asset.use_count() - 1,
+			asset->vertex_bytes / 1024, asset->index_bytes / 1024,
+			asset->TextureBytes() / 1024, asset->ConstantBytes());
+		total += asset->DeviceBytes();
+	}
+	printf("\ttotal %zu KB\n", total / 1024);
+}
@@ -0,0 +1,161 @@
+//
+//  MeshAsset.h
+//
+//  Device meshes shared between models, with a registry that hands them out
+//
+
+#pragma once
+#ifndef MESHASSET_H
+#define MESHASSET_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "stdafx.h"
+#include "vec/transform.h"
+#include "Drawcall.h"
+
+using namespace linalg;
+
+//
+// Mesh asset
+//
+// The device data of a mesh: its vertex and index buffers, the index ranges
+// that draw it, and their materials with their textures and constant
+// buffers. Models of the same mesh share one asset (see MeshRegistry), so
+// an asset is not changed once created, and is released with its last model.
+//
+struct MeshAsset
+{
+	std::string name;	// the registry key
+
+	ID3D11Buffer* vertex_buffer = nullptr;
+	ID3D11Buffer* index_buffer = nullptr;
+
+	// Size of one vertex in vertex_buffer
+	UINT vertex_stride = sizeof(Vertex);
+
+	// Position dequantization of packed vertices, bound to slot b1 of the VS
+	ID3D11Buffer* vertex_quantization_buffer = nullptr;
+
+	// Format of the indices in index_buffer
+	DXGI_FORMAT index_format = DXGI_FORMAT_R32_UINT;
+
+	// index ranges, representing drawcalls, within index_buffer
+	std::vector<IndexRange> index_ranges;
+	std::vector<Material> materials;
+
+	// Model space bounds, of all geometry and per index range
+	aabb3f bounds = { { 0, 0, 0 }, { 0, 0, 0 } };
+	std::vector<aabb3f> range_bounds;
+
+	// Bytes of vertex_buffer and index_buffer
+	size_t vertex_bytes = 0;
+	size_t index_bytes = 0;
+
+	explicit MeshAsset(const std::string& name) : name(name) { }
+
+	MeshAsset(const MeshAsset&) = delete;
+	MeshAsset& operator=(const MeshAsset&) = delete;
+
+	~MeshAsset();
+
+	//
+	// Create vertex_buffer from a vertex array, in the
+	// packed format if VERTEX_FORMAT_PACKED is defined
+	//
+	void CreateVertexBuffer(
+		ID3D11Device* dxdevice,
+		const Vertex* vertices,
+		unsigned nbr_vertices);
+
+	//
+	// Create index_buffer from an index array drawn by index_ranges, with
+	// 16-bit indices if INDEX_BUFFER_16BIT is defined and the ranges allow it.
+	// index_ranges is replaced by the ranges to draw the buffer with
+	//
+	void CreateIndexBuffer(
+		ID3D11Device* dxdevice,
+		const unsigned* indices,
+		unsigned nbr_indices);
+
+	//
+	// Bounds of the vertices referenced by indices[0..nbr_indices)
+	//
+	static aabb3f IndexedBounds(
+		const Vertex* vertices,
+		const unsigned* indices,
+		unsigned nbr_indices);
+
+	//
+	// Device memory of the textures (32 bits per texel) and the constant
+	// buffers of the materials, and of the whole asset, in bytes
+	//
+	size_t TextureBytes() const;
+	size_t ConstantBytes() const;
+	size_t DeviceBytes() const;
+};
+
+//
+// Mesh registry
+//
+// Hands out shared mesh assets by key: the canonical path of a mesh file
+// (see CanonicalPath), or a name for generated meshes. The first Acquire of
+// a key loads the asset, and later ones return it for as long as a model
+// holds it, so loading a mesh twice costs a map lookup. The registry only
+// holds weak references, and does not keep assets alive by itself.
+//
+class MeshRegistry
+{
+public:
+	struct Stats
+	{
+		unsigned loads = 0;	// Acquires that loaded an asset
+		unsigned hits = 0;	// Acquires that shared a live one
+	};
+
+	//
+	// The asset of key, if one is alive, else the one load(key) returns
+	// (a std::shared_ptr<MeshAsset>)
+	//
+	template<class F>
+	std::shared_ptr<const MeshAsset> Acquire(
+		const std::string& key,
+		F&& load)
+	{
+		auto it = assets.find(key);
+		if (it != assets.end())
+		{
+			if (std::shared_ptr<const MeshAsset> asset = it->second.lock())
+			{
+				stats.hits++;
+				return asset;
+			}
+		}
+
+		std::shared_ptr<const MeshAsset> asset = load(key);
+		assets[key] = asset;
+		stats.loads++;
+		return asset;
+	}
+
+	//
+	// Absolute path of a file, with the separators and (on Windows) case of
+	// all paths to the same file made the same
+	//
+	static std::string CanonicalPath(const std::string& path);
+
+	//
+	// Print the live assets with their number of users and device memory
+	//
+	void PrintReport() const;
+
+	const Stats& GetStats() const { return stats; }
+
+private:
+	std::map<std::string, std::weak_ptr<const MeshAsset>> assets;
+	Stats stats;
+};
+
+#endif
@@ -0,0 +1,349 @@
+//
+//  MeshCache.cpp
+//
+//  Binary cache of processed OBJ meshes
+//
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "MeshCache.h"
+
+//
+// File layout
+//
+// header
+// dependencies		(source file first, then e.g. MTL files)
+// vertices			(16-byte aligned)
+// indices
+// index ranges
+// materials		(runs to the end of the file)
+//
+struct mesh_cache_header_t
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t vertex_size;
+	uint32_t nbr_dependencies;
+	uint32_t nbr_vertices;
+	uint32_t nbr_indices;
+	uint32_t nbr_ranges;
+	uint32_t nbr_materials;
+	uint32_t reserved;
+	uint64_t vertices_offset;
+	uint64_t indices_offset;
+	uint64_t ranges_offset;
+	uint64_t materials_offset;
+	uint64_t file_size;
+	uint64_t settings;		// hash of the load settings
+};
+
+static const char MeshCacheMagic[8] = { 'E', 'D', 'U', 'M', 'E', 'S', 'H', 0 };
+
+struct mesh_cache_dependency_t
+{
+	std::string path;
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	uint64_t hash = 0;
+};
+
+//
+// Append-only binary writer
+//
+struct cache_writer_t
+{
+	std::vector<char> blob;
+
+	void put(const void* data, size_t size)
+	{
+		blob.insert(blob.end(), (const char*)data, (const char*)data + size);
+	}
+
+	template<class T> void put(const T& value) { put(&value, sizeof(T)); }
+
+	void put_string(const std::string& str)
+	{
+		put((uint32_t)str.size());
+		put(str.data(), str.size());
+	}
+
+	void align(size_t alignment)
+	{
+		blob.resize((blob.size() + alignment - 1) / alignment * alignment, 0);
+	}
+};
+
+//
+// Bounds-checked binary reader. Reads past the end fail and set ok to false
+//
+struct cache_reader_t
+{
+	const char* p;
+	const char* end;
+	bool ok = true;
+
+	bool get(void* data, size_t size)
+	{
+		if (!ok || (size_t)(end - p) < size) return ok = false;
+		memcpy(data, p, size);
+		p += size;
+		return true;
+	}
+
+	template<class T> bool get(T& value) { return get(&value, sizeof(T)); }
+
+	bool get_string(std::string& str)
+	{
+		uint32_t size;
+		if (!get(size) || (size_t)(end - p) < size) return ok = false;
+		str.assign(p, size);
+		p += size;
+		return true;
+	}
+};
+
+static bool GetFileInfo(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(path.c_str(), &st) != 0) return false;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return false;
+#endif
+	size = (uint64_t)st.st_size;
+	mtime = (int64_t)st.st_mtime;
+	return true;
+}
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+//
+// 64-bit content hash, one multiply-rotate round per 8-byte word
+//
+static uint64_t HashContent(const char* data, size_t size)
+{
+	uint64_t h = 0xcbf29ce484222325ull ^ size;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t w;
+		memcpy(&w, data + i, 8);
+		w *= 0x87c37b91114253d5ull;
+		w = rotl64(w, 31);
+		w *= 0x4cf5ad432745937full;
+		h ^= w;
+		h = rotl64(h, 27) * 5 + 0x52dce729;
+	}
+	for (; i < size; i++)
+		h = (h ^ (unsigned char)data[i]) * 0x100000001b3ull;
+
+	// final avalanche
+	h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+static bool HashFile(const std::string& path, uint64_t& hash)
+{
+	MappedFile file;
+	if (!file.Open(path)) return false;
+	hash = HashContent(file.Data(), file.Size());
+	return true;
+}
+
+//
+// A file is unchanged if its size and time stamp match, or if only
+// the time stamp differs (e.g. after a copy or checkout) but the content does not
+//
+static bool IsUnchanged(const mesh_cache_dependency_t& dep)
+{
+	uint64_t size, hash;
+	int64_t mtime;
+	if (!GetFileInfo(dep.path, size, mtime) || size != dep.size)
+		return false;
+	if (mtime == dep.mtime)
+		return true;
+	return HashFile(dep.path, hash) && hash == dep.hash;
+}
+
+std::string MeshCache::CachePath(const std::string& source)
+{
+	return source + ".meshcache";
+}
+
+uint64_t MeshCache::Hash(const void* data, size_t size)
+{
+	return HashContent((const char*)data, size);
+}
+
+bool MeshCache::Load(
+	const std::string& source,
+	uint64_t settings)
+{
+	std::string path = CachePath(source);
+	if (!file.Open(path))
+		return false;
+
+	auto reject = [&](const char* reason)
+	{
+		file.Close();
+		vertices = nullptr; indices = nullptr;
+		nbr_vertices = nbr_indices = 0;
+		index_ranges.clear(); materials.clear();
+		std::cout << "Ignoring mesh cache " << path << ": " << reason << std::endl;
+		return false;
+	};
+
+	cache_reader_t in = { file.Data(), file.End() };
+
+	mesh_cache_header_t header;
+	if (!in.get(header) || memcmp(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0)
+		return reject("not a mesh cache");
+	if (header.version != Version || header.vertex_size != sizeof(Vertex))
+		return reject("old format");
+	if (header.file_size != file.Size())
+		return reject("truncated");
+	if (header.settings != settings)
+		return reject("built with other settings");
+
+	// Source and dependencies
+	for (uint32_t i = 0; i < header.nbr_dependencies; i++)
+	{
+		mesh_cache_dependency_t dep;
+		if (!in.get_string(dep.path) || !in.get(dep.size) || !in.get(dep.mtime) || !in.get(dep.hash))
+			return reject("corrupt");
+		if (i == 0 && dep.path != source)
+			return reject("built from another source");
+		if (!IsUnchanged(dep))
+			return reject("source has changed");
+	}
+
+	// Array sections
+	const uint64_t size = file.Size();
+	if (header.vertices_offset % 16 ||
+		header.indices_offset % sizeof(unsigned) ||
+		header.vertices_offset + (uint64_t)header.nbr_vertices * sizeof(Vertex) > size ||
+		header.indices_offset + (uint64_t)header.nbr_indices * sizeof(unsigned) > size ||
+		header.ranges_offset + (uint64_t)header.nbr_ranges * sizeof(IndexRange) > size ||
+		header.materials_offset > size)
+		return reject("corrupt");
+
+	vertices = (const Vertex*)(file.Data() + header.vertices_offset);
+	indices = (const unsigned*)(file.Data() + header.indices_offset);
+	nbr_vertices = header.nbr_vertices;
+	nbr_indices = header.nbr_indices;
+
+	index_ranges.resize(header.nbr_ranges);
+	if (header.nbr_ranges)
+		memcpy(index_ranges.data(), file.Data() + header.ranges_offset, header.nbr_ranges * sizeof(IndexRange));
+
+	// Materials
+	in = { file.Data() + header.materials_offset, file.End() };
+	materials.resize(header.nbr_materials);
+	for (auto& mtl : materials)
+	{
+		in.get(mtl.Ka); in.get(mtl.Kd); in.get(mtl.Ks); in.get(mtl.shininess);
+		in.get_string(mtl.name);
+		in.get_string(mtl.Kd_texture_filename);
+		in.get_string(mtl.normal_texture_filename);
+		in.get_string(mtl.specular_texture_filename);
+	}
+	if (!in.ok)
+		return reject("corrupt");
+
+	for (auto& range : index_ranges)
+		if ((uint64_t)range.start + range.size > nbr_indices || range.mtl_index >= (int)materials.size())
+			return reject("corrupt");
+
+	return true;
+}
+
+bool MeshCache::Save(
+	const std::string& source,
+	uint64_t settings,
+	const std::vector<std::string>& dependencies,
+	const std::vector<Vertex>& vertices,
+	const std::vector<unsigned>& indices,
+	const std::vector<IndexRange>& index_ranges,
+	const std::vector<Material>& materials)
+{
+	std::vector<std::string> paths = { source };
+	paths.insert(paths.end(), dependencies.begin(), dependencies.end());
+
+	mesh_cache_header_t header = {};
+	memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+	header.version = Version;
+	header.vertex_size = sizeof(Vertex);
+	header.nbr_dependencies = (uint32_t)paths.size();
+	header.nbr_vertices = (uint32_t)vertices.size();
+	header.nbr_indices = (uint32_t)indices.size();
+	header.nbr_ranges = (uint32_t)index_ranges.size();
+	header.nbr_materials = (uint32_t)materials.size();
+	header.settings = settings;
+
+	cache_writer_t out;
+	out.put(header);
+
+	for (auto& path : paths)
+	{
+		mesh_cache_dependency_t dep;
+		dep.path = path;
+		if (!GetFileInfo(path, dep.size, dep.mtime) || !HashFile(path, dep.hash))
+			return false;
+		out.put_string(dep.path);
+		out.put(dep.size); out.put(dep.mtime); out.put(dep.hash);
+	}
+
+	out.align(16);
+	header.vertices_offset = out.blob.size();
+	out.put(vertices.data(), vertices.size() * sizeof(Vertex));
+
+	header.indices_offset = out.blob.size();
+	out.put(indices.data(), indices.size() * sizeof(unsigned));
+
+	header.ranges_offset = out.blob.size();
+	out.put(index_ranges.data(), index_ranges.size() * sizeof(IndexRange));
+
+	header.materials_offset = out.blob.size();
+	for (auto& mtl : materials)
+	{
+		out.put(mtl.Ka); out.put(mtl.Kd); out.put(mtl.Ks); out.put(mtl.shininess);
+		out.put_string(mtl.name);
+		out.put_string(mtl.Kd_texture_filename);
+		out.put_string(mtl.normal_texture_filename);
+		out.put_string(mtl.specular_texture_filename);
+	}
+
+	header.file_size = out.blob.size();
+	memcpy(out.blob.data(), &header, sizeof(header));
+
+	// Write to a temporary file first so that a failed write never
+	// leaves a truncated cache behind
+	std::string path = CachePath(source);
+	std::string tmp_path = path + ".tmp";
+	{
+		std::ofstream f(tmp_path.c_str(), std::ios::binary | std::ios::trunc);
+		if (!f || !f.write(out.blob.data(), out.blob.size()))
+			return false;
+	}
+	std::remove(path.c_str());
+	if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+	{
+		std::remove(tmp_path.c_str());
+		return false;
+	}
+
+	std::cout << "Wrote " << path << std::endl;
+	return true;
+}
@@ -0,0 +1,96 @@
+//
+//  MeshCache.h
+//
+//  Binary cache of processed OBJ meshes
+//
+
+#pragma once
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Drawcall.h"
+#include "MappedFile.h"
+
+// Store processed OBJ meshes next to their source file as <file>.meshcache,
+// and map them back in on later loads instead of re-parsing the source
+#define MESH_USE_CACHE
+
+//
+// Mesh cache
+//
+// A cache file holds the final vertex array, index array, index ranges and
+// materials of a mesh, as produced by the OBJModel load pipeline. Vertex and
+// index data are stored in their GPU layout so they can be uploaded straight
+// from the mapped file.
+//
+// A cache is keyed by the path of its source file, and is valid as long as
+// the source and the MTL files it depends on are unchanged. Files are compared
+// by size and modification time, and if only the time differs, by content hash.
+// The processed data also depends on settings that are not in any file, such as
+// the MESH_* switches and the loader options. The caller hashes these (see Hash),
+// and a cache built with other settings is rejected.
+// Bump MeshCache::Version whenever Vertex or the code of the load pipeline changes.
+//
+class MeshCache
+{
+	MappedFile file;
+
+	const Vertex* vertices = nullptr;
+	const unsigned* indices = nullptr;
+	unsigned nbr_vertices = 0;
+	unsigned nbr_indices = 0;
+
+	std::vector<IndexRange> index_ranges;
+	std::vector<Material> materials;
+
+public:
+
+	static const unsigned Version = 5;
+
+	//
+	// Path of the cache file that belongs to a source file
+	//
+	static std::string CachePath(const std::string& source);
+
+	//
+	// 64-bit hash of data, e.g. of the load settings
+	//
+	static uint64_t Hash(const void* data, size_t size);
+
+	//
+	// Map the cache of a source file and validate it, against the hash of
+	// the load settings. Returns false (leaving the cache empty) if there is
+	// no valid cache
+	//
+	bool Load(
+		const std::string& source,
+		uint64_t settings);
+
+	//
+	// Write the cache of a source file. dependencies are other files
+	// (e.g. MTL files) whose changes should invalidate the cache
+	//
+	static bool Save(
+		const std::string& source,
+		uint64_t settings,
+		const std::vector<std::string>& dependencies,
+		const std::vector<Vertex>& vertices,
+		const std::vector<unsigned>& indices,
+		const std::vector<IndexRange>& index_ranges,
+		const std::vector<Material>& materials);
+
+	// Vertex and index arrays point into the mapped cache file,
+	// and are valid until the cache is destroyed
+	const Vertex* Vertices() const { return vertices; }
+	const unsigned* Indices() const { return indices; }
+	unsigned VertexCount() const { return nbr_vertices; }
+	unsigned IndexCount() const { return nbr_indices; }
+
+	const std::vector<IndexRange>& IndexRanges() const { return index_ranges; }
+	const std::vector<Material>& Materials() const { return materials; }
+};
+
+#endif
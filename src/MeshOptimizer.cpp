@@ -0,0 +1,345 @@
+//
+//  MeshOptimizer.cpp
+//
+//  Index and vertex reordering for post-transform cache, overdraw and fetch locality
+//
+
+#include <algorithm>
+#include <cmath>
+#include "MeshOptimizer.h"
+
+using namespace linalg;
+
+//
+// FIFO post-transform cache over vertex indices [0, nbr_vertices)
+//
+struct fifo_cache_t
+{
+	std::vector<unsigned> stamp;
+	unsigned cache_size;
+	unsigned time;
+
+	// A vertex is cached if fewer than cache_size vertices were inserted after it.
+	// Starting the clock at cache_size makes the initial stamps of 0 uncached
+	fifo_cache_t(unsigned nbr_vertices, unsigned cache_size)
+		: stamp(nbr_vertices, 0), cache_size(cache_size), time(cache_size)
+	{ }
+
+	// Returns true on a miss, which inserts the vertex
+	bool access(unsigned v)
+	{
+		if (time - stamp[v] < cache_size)
+			return false;
+		stamp[v] = ++time;
+		return true;
+	}
+};
+
+static unsigned max_index(const unsigned* indices, size_t nbr_indices)
+{
+	unsigned m = 0;
+	for (size_t i = 0; i < nbr_indices; i++)
+		m = std::max(m, indices[i]);
+	return m;
+}
+
+VertexCacheStats AnalyzeVertexCache(
+	const unsigned* indices,
+	size_t nbr_indices,
+	unsigned cache_size)
+{
+	VertexCacheStats stats;
+	if (!nbr_indices) return stats;
+
+	const unsigned nbr_vertices = max_index(indices, nbr_indices) + 1;
+	fifo_cache_t cache(nbr_vertices, cache_size);
+	std::vector<bool> referenced(nbr_vertices, false);
+
+	for (size_t i = 0; i < nbr_indices; i++)
+	{
+		if (cache.access(indices[i]))
+			stats.nbr_transformed++;
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			stats.nbr_vertices++;
+		}
+	}
+
+	stats.nbr_triangles = (unsigned)(nbr_indices / 3);
+	stats.acmr = (float)stats.nbr_transformed / stats.nbr_triangles;
+	stats.atvr = (float)stats.nbr_transformed / stats.nbr_vertices;
+	return stats;
+}
+
+//
+// Forsyth vertex scoring
+//
+namespace forsyth
+{
+	const int CacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+	const int MaxValence = 64;
+
+	struct score_table_t
+	{
+		float cache[CacheSize + 1];		// by cache position + 1, 0 = not cached
+		float valence[MaxValence + 1];	// by remaining triangles
+
+		score_table_t()
+		{
+			cache[0] = 0.0f;
+			for (int pos = 0; pos < CacheSize; pos++)
+				cache[pos + 1] = pos < 3 ? LastTriScore :
+					std::pow(1.0f - (float)(pos - 3) / (CacheSize - 3), CacheDecayPower);
+
+			valence[0] = 0.0f;
+			for (int n = 1; n <= MaxValence; n++)
+				valence[n] = ValenceBoostScale * std::pow((float)n, -ValenceBoostPower);
+		}
+
+		float score(int cache_pos, unsigned live) const
+		{
+			// vertices without triangles left are never wanted
+			if (!live) return -1.0f;
+			return cache[cache_pos + 1] + valence[std::min<unsigned>(live, MaxValence)];
+		}
+	};
+}
+
+void OptimizeVertexCache(
+	unsigned* indices,
+	size_t nbr_indices)
+{
+	using namespace forsyth;
+	static const score_table_t table;
+
+	const size_t nbr_triangles = nbr_indices / 3;
+	if (nbr_triangles < 2) return;
+
+	// Work on local vertex indices
+	unsigned base = indices[0], top = indices[0];
+	for (size_t i = 0; i < nbr_indices; i++)
+	{
+		base = std::min(base, indices[i]);
+		top = std::max(top, indices[i]);
+	}
+	const unsigned nbr_vertices = top - base + 1;
+
+	// Triangles at each vertex, the live ones first:
+	// vertex_triangles[vertex_offsets[v]] .. vertex_triangles[vertex_offsets[v] + live[v] - 1]
+	std::vector<unsigned> live(nbr_vertices, 0);
+	for (size_t i = 0; i < nbr_indices; i++)
+		live[indices[i] - base]++;
+
+	std::vector<unsigned> vertex_offsets(nbr_vertices + 1, 0);
+	for (unsigned v = 0; v < nbr_vertices; v++)
+		vertex_offsets[v + 1] = vertex_offsets[v] + live[v];
+
+	std::vector<unsigned> vertex_triangles(nbr_indices);
+	{
+		std::vector<unsigned> fill(vertex_offsets.begin(), vertex_offsets.end() - 1);
+		for (size_t i = 0; i < nbr_indices; i++)
+			vertex_triangles[fill[indices[i] - base]++] = (unsigned)(i / 3);
+	}
+
+	std::vector<int> cache_pos(nbr_vertices, -1);
+	std::vector<float> vertex_score(nbr_vertices);
+	for (unsigned v = 0; v < nbr_vertices; v++)
+		vertex_score[v] = table.score(-1, live[v]);
+
+	std::vector<float> triangle_score(nbr_triangles);
+	std::vector<bool> emitted(nbr_triangles, false);
+	long best = -1;
+	for (size_t t = 0; t < nbr_triangles; t++)
+	{
+		triangle_score[t] =
+			vertex_score[indices[3 * t + 0] - base] +
+			vertex_score[indices[3 * t + 1] - base] +
+			vertex_score[indices[3 * t + 2] - base];
+		if (best < 0 || triangle_score[t] > triangle_score[best])
+			best = (long)t;
+	}
+
+	std::vector<unsigned> output;
+	output.reserve(nbr_indices);
+
+	int cache[CacheSize + 3];
+	int cache_count = 0;
+	size_t cursor = 0;
+
+	while (output.size() < nbr_indices)
+	{
+		// Nothing in the cache has triangles left, continue with any triangle
+		if (best < 0)
+		{
+			while (emitted[cursor]) cursor++;
+			best = (long)cursor;
+		}
+
+		const unsigned t = (unsigned)best;
+		emitted[t] = true;
+
+		// New cache: the triangle's vertices first, then the previous contents
+		int next_cache[CacheSize + 3];
+		int next_count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const unsigned v = indices[3 * t + k] - base;
+			output.push_back(v + base);
+
+			// remove t from the live triangles of v
+			unsigned* tris = &vertex_triangles[vertex_offsets[v]];
+			unsigned* last = tris + live[v] - 1;
+			std::swap(*std::find(tris, last, t), *last);
+			live[v]--;
+
+			if (std::find(next_cache, next_cache + next_count, (int)v) == next_cache + next_count)
+				next_cache[next_count++] = (int)v;
+		}
+		for (int i = 0; i < cache_count; i++)
+			if (std::find(next_cache, next_cache + next_count, cache[i]) == next_cache + next_count)
+				next_cache[next_count++] = cache[i];
+
+		// Rescore the cached vertices (and those pushed out) and their triangles
+		best = -1;
+		for (int i = 0; i < next_count; i++)
+		{
+			const int v = next_cache[i];
+			cache_pos[v] = i < CacheSize ? i : -1;
+			vertex_score[v] = table.score(cache_pos[v], live[v]);
+		}
+		for (int i = 0; i < next_count; i++)
+		{
+			const int v = next_cache[i];
+			for (unsigned j = 0; j < live[v]; j++)
+			{
+				const unsigned u = vertex_triangles[vertex_offsets[v] + j];
+				triangle_score[u] =
+					vertex_score[indices[3 * u + 0] - base] +
+					vertex_score[indices[3 * u + 1] - base] +
+					vertex_score[indices[3 * u + 2] - base];
+				if (best < 0 || triangle_score[u] > triangle_score[best])
+					best = (long)u;
+			}
+		}
+
+		cache_count = std::min(next_count, CacheSize);
+		std::copy(next_cache, next_cache + cache_count, cache);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(
+	unsigned* indices,
+	size_t nbr_indices,
+	const Vertex* vertices,
+	unsigned cache_size)
+{
+	const size_t nbr_triangles = nbr_indices / 3;
+	if (nbr_triangles < 2) return;
+
+	// Split into clusters at triangles that miss on all three vertices
+	std::vector<size_t> clusters;
+	{
+		fifo_cache_t cache(max_index(indices, nbr_indices) + 1, cache_size);
+		for (size_t t = 0; t < nbr_triangles; t++)
+		{
+			int misses = 0;
+			for (int k = 0; k < 3; k++)
+				misses += cache.access(indices[3 * t + k]);
+			if (misses == 3)
+				clusters.push_back(t);
+		}
+		if (clusters.empty() || clusters[0] != 0)
+			clusters.insert(clusters.begin(), 0);
+	}
+	const size_t nbr_clusters = clusters.size();
+	if (nbr_clusters < 2) return;
+	clusters.push_back(nbr_triangles);
+
+	// Area-weighted centroid and normal of each cluster, and of the whole mesh
+	struct cluster_t
+	{
+		size_t begin, end;
+		vec3f centroid;
+		vec3f normal;
+		float sort_key;
+	};
+	std::vector<cluster_t> cluster_info(nbr_clusters);
+	vec3f mesh_centroid = vec3f_zero;
+	float mesh_area = 0.0f;
+
+	for (size_t c = 0; c < nbr_clusters; c++)
+	{
+		cluster_t& cluster = cluster_info[c];
+		cluster.begin = clusters[c];
+		cluster.end = clusters[c + 1];
+		cluster.centroid = vec3f_zero;
+		cluster.normal = vec3f_zero;
+
+		float area = 0.0f;
+		for (size_t t = cluster.begin; t < cluster.end; t++)
+		{
+			const vec3f& p0 = vertices[indices[3 * t + 0]].Pos;
+			const vec3f& p1 = vertices[indices[3 * t + 1]].Pos;
+			const vec3f& p2 = vertices[indices[3 * t + 2]].Pos;
+			vec3f n = (p1 - p0) % (p2 - p0);
+			float a = std::sqrt(dot(n, n));
+			cluster.centroid += (p0 + p1 + p2) * (a / 3.0f);
+			cluster.normal += n;
+			area += a;
+		}
+
+		mesh_centroid += cluster.centroid;
+		mesh_area += area;
+		if (area > 0.0f)
+			cluster.centroid = cluster.centroid * (1.0f / area);
+	}
+	if (mesh_area > 0.0f)
+		mesh_centroid = mesh_centroid * (1.0f / mesh_area);
+
+	// Clusters facing away from the center, i.e. likely occluders, first
+	for (auto& cluster : cluster_info)
+	{
+		float len = std::sqrt(dot(cluster.normal, cluster.normal));
+		cluster.sort_key = len > 0.0f ? dot(cluster.centroid - mesh_centroid, cluster.normal) / len : 0.0f;
+	}
+	std::stable_sort(cluster_info.begin(), cluster_info.end(),
+		[](const cluster_t& a, const cluster_t& b) { return a.sort_key > b.sort_key; });
+
+	std::vector<unsigned> output;
+	output.reserve(nbr_indices);
+	for (auto& cluster : cluster_info)
+		output.insert(output.end(), indices + 3 * cluster.begin, indices + 3 * cluster.end);
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeVertexFetch(
+	std::vector<Vertex>& vertices,
+	std::vector<unsigned>& indices)
+{
+	const unsigned Unused = ~0u;
+	std::vector<unsigned> remap(vertices.size(), Unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == Unused)
+		{
+			remap[index] = (unsigned)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	for (size_t v = 0; v < vertices.size(); v++)
+		if (remap[v] == Unused)
+			reordered.push_back(vertices[v]);
+
+	vertices.swap(reordered);
+}
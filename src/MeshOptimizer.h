@@ -0,0 +1,69 @@
+//
+//  MeshOptimizer.h
+//
+//  Index and vertex reordering for post-transform cache, overdraw and fetch locality
+//
+
+#pragma once
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+#include "Drawcall.h"
+
+// Reorder the triangles of each OBJModel drawcall for vertex cache and
+// overdraw, and the vertices for fetch locality, when a model is loaded
+#define MESH_OPTIMIZE
+
+//
+// Post-transform cache efficiency of an index sequence, measured with a FIFO
+// cache simulator
+//
+// ACMR: average cache miss ratio, transformed vertices per triangle (0.5 - 3)
+// ATVR: average transform to vertex ratio, transformed vertices per referenced vertex (1 - 6)
+//
+struct VertexCacheStats
+{
+	unsigned nbr_triangles = 0;
+	unsigned nbr_vertices = 0;		// distinct vertices referenced
+	unsigned nbr_transformed = 0;	// cache misses
+	float acmr = 0;
+	float atvr = 0;
+};
+
+VertexCacheStats AnalyzeVertexCache(
+	const unsigned* indices,
+	size_t nbr_indices,
+	unsigned cache_size = 16);
+
+//
+// Reorder triangles for post-transform cache locality, using Tom Forsyth's
+// linear-speed vertex cache optimization. Indices may be any sub-range of
+// a larger vertex array
+//
+void OptimizeVertexCache(
+	unsigned* indices,
+	size_t nbr_indices);
+
+//
+// Reorder clusters of a cache-optimized triangle sequence so that triangles
+// facing outwards from the mesh center come first, which tends to draw
+// occluders before what they occlude. Clusters are split where the sequence
+// has a full cache miss (every vertex of a triangle is a miss), so moving them
+// does not change the ACMR much
+//
+void OptimizeOverdraw(
+	unsigned* indices,
+	size_t nbr_indices,
+	const Vertex* vertices,
+	unsigned cache_size = 16);
+
+//
+// Reorder vertices in order of first use by the index buffer and remap the
+// indices. Vertices that are not referenced are moved to the end
+//
+void OptimizeVertexFetch(
+	std::vector<Vertex>& vertices,
+	std::vector<unsigned>& indices);
+
+#endif
@@ -5,17 +5,182 @@
 //
 
 #include "Model.h"
+#include "Tangents.h"
+#include "MeshOptimizer.h"
 
-QuadModel::QuadModel(
+void Model::BindVertexBuffer(StateCache& state) const
+{
+	const UINT32 offset = 0;
+	state.IASetVertexBuffers(0, 1, &mesh->vertex_buffer, &mesh->vertex_stride, &offset);
+
+	if (mesh->vertex_quantization_buffer)
+		state.VSSetConstantBuffers(1, 1, &mesh->vertex_quantization_buffer);
+}
+
+bool Model::Cull(
+	const vec4f* frustum_planes,
+	CullStats& stats)
+{
+	bool visible;
+	cull_aabbs(frustum_planes, &mesh->bounds, &visible, 1);
+
+	stats.objects_tested++;
+	stats.objects_culled += !visible;
+	return visible;
+}
+
+void Model::Render(StateCache& state) const
+{
+	BindBuffers(state);
+
+	for (unsigned i = 0; i < DrawcallCount(); i++)
+	{
+		// Skip drawcalls outside the frustum, see Cull
+		if (!DrawcallVisible(i))
+			continue;
+
+		if (const Material* mtl = DrawcallMaterial(i))
+			BindMaterial(state, *mtl);
+
+		Draw(state, i);
+	}
+}
+
+void Model::BindBuffers(StateCache& state) const
+{
+	BindVertexBuffer(state);
+	state.IASetIndexBuffer(mesh->index_buffer, mesh->index_format, 0);
+}
+
+void Model::BindTextures(
+	StateCache& state,
+	const Material& mtl)
+{
+	// Diffuse, normal and specular maps to t0-t2
+	ID3D11ShaderResourceView* const srvs[] =
+	{
+		mtl.diffuse_texture.texture_SRV,
+		mtl.normal_texture.texture_SRV,
+		mtl.specular_texture.texture_SRV
+	};
+	state.PSSetShaderResources(0, 3, srvs);
+
+	// Cube map to t3, if any. Otherwise the one already bound is kept
+	if (mtl.cube_texture.texture_SRV)
+		state.PSSetShaderResources(3, 1, &mtl.cube_texture.texture_SRV);
+}
+
+void Model::BindMaterialBuffer(
+	StateCache& state,
+	const Material& mtl)
+{
+	state.PSSetConstantBuffers(1, 1, &mtl.constant_buffer);
+}
+
+void Model::BindMaterial(
+	StateCache& state,
+	const Material& mtl)
+{
+	BindMaterialBuffer(state, mtl);
+	BindTextures(state, mtl);
+}
+
+void Model::CreateMaterialBuffer(
 	ID3D11Device* dxdevice,
-	ID3D11DeviceContext* dxdevice_context)
-	: Model(dxdevice, dxdevice_context)
+	Material& mtl)
+{
+	// The colors never change after loading, so the buffer is immutable
+	// and only bound when drawing, never mapped
+	MaterialBuffer_t data = {};
+	data.Ka = mtl.Ka.xyz1();
+	data.Kd = mtl.Kd.xyz1();
+	data.Ks = mtl.Ks.xyz1();
+	data.shininess = mtl.shininess;
+
+	D3D11_BUFFER_DESC mbufferDesc = { 0 };
+	mbufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	mbufferDesc.ByteWidth = sizeof(MaterialBuffer_t);
+	mbufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA mdata = { 0 };
+	mdata.pSysMem = &data;
+	ASSERT(dxdevice->CreateBuffer(&mbufferDesc, &mdata, &mtl.constant_buffer));
+	SETNAME(mtl.constant_buffer, "MaterialBuffer");
+}
+
+void Model::LoadMaterial(
+	ID3D11Device* dxdevice,
+	Material& mtl,
+	bool load_cube_map)
+{
+	HRESULT hr;
+
+	// Load Diffuse texture
+	//
+	if (mtl.Kd_texture_filename.size()) {
+
+		hr = LoadTextureFromFile(
+			dxdevice,
+			mtl.Kd_texture_filename.c_str(), 
+			&mtl.diffuse_texture);
+		std::cout << "\t" << mtl.Kd_texture_filename 
+			<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
+	}
+
+	if (mtl.normal_texture_filename.size()) {
+
+		hr = LoadTextureFromFile(
+			dxdevice,
+			mtl.normal_texture_filename.c_str(),
+			&mtl.normal_texture);
+		std::cout << "\t" << mtl.normal_texture_filename
+			<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
+	}
+
+	if (mtl.specular_texture_filename.size()) {
+
+		hr = LoadTextureFromFile(
+			dxdevice,
+			mtl.specular_texture_filename.c_str(),
+			&mtl.specular_texture);
+		std::cout << "\t" << mtl.specular_texture_filename
+			<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
+	}
+
+	// + other texture types here - see Material class
+	// ...
+
+	if (load_cube_map)
+	{
+		hr = LoadCubeTextureFromFile(
+			dxdevice,
+			mtl.cube_filenames,
+			&mtl.cube_texture);
+		if (SUCCEEDED(hr)) std::cout << "Cubemap OK" << std::endl;
+		else std::cout << "Cubemap failed to load" << std::endl;
+	}
+
+	CreateMaterialBuffer(dxdevice, mtl);
+}
+
+void Model::ReleaseMaterial(Material& mtl)
+{
+	SAFE_RELEASE(mtl.diffuse_texture.texture_SRV);
+	SAFE_RELEASE(mtl.normal_texture.texture_SRV);
+	SAFE_RELEASE(mtl.specular_texture.texture_SRV);
+	SAFE_RELEASE(mtl.cube_texture.texture_SRV);
+	// Release other used textures ...
+	SAFE_RELEASE(mtl.constant_buffer);
+}
+
+std::shared_ptr<MeshAsset> QuadModel::CreateMesh(
+	const std::string& name,
+	ID3D11Device* dxdevice)
 {
 	// Vertex and index arrays
 	// Once their data is loaded to GPU buffers, they are not needed anymore
 	std::vector<Vertex> vertices;
 	std::vector<unsigned> indices;
-	material = new Material();
 	// Populate the vertex array with 4 vertices
 	Vertex v0, v1, v2, v3;
 	v0.Pos = { -0.5, -0.5f, 0.0f };
@@ -45,230 +210,261 @@ QuadModel::QuadModel(
 	indices.push_back(2);
 	indices.push_back(3);
 
-	// Vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0 };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = (UINT)(vertices.size()*sizeof(Vertex));
-	// Data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &vertices[0];
-	// Create vertex buffer on device using descriptor & data
-	const HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
-	SETNAME(vertex_buffer, "VertexBuffer");
-    
-	//  Index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0 };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = (UINT)(indices.size()*sizeof(unsigned));
-	// Data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// Create index buffer on device using descriptor & data
-	const HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
-	SETNAME(index_buffer, "IndexBuffer");
+	std::shared_ptr<MeshAsset> asset = std::make_shared<MeshAsset>(name);
+
+	// Create vertex buffer on device
+	asset->CreateVertexBuffer(dxdevice, &vertices[0], (unsigned)vertices.size());
     
-	nbr_indices = (unsigned int)indices.size();
-}
+	// Create index buffer on device. The mesh is too small to need base
+	// vertices, so it is drawn as a single range starting at vertex 0
+	asset->index_ranges = { { 0, (unsigned)indices.size(), 0, -1 } };
+	asset->CreateIndexBuffer(dxdevice, &indices[0], (unsigned)indices.size());
 
+	asset->bounds = MeshAsset::IndexedBounds(&vertices[0], &indices[0], (unsigned)indices.size());
+	return asset;
+}
 
-void QuadModel::Render(std::function<void(vec4f Ka, vec4f Kd, vec4f Ks, float shininess)> bufferUpdate) const
+QuadModel::QuadModel(
+	ID3D11Device* dxdevice,
+	ID3D11DeviceContext* dxdevice_context,
+	MeshRegistry* meshes)
+	: Model(dxdevice, dxdevice_context)
 {
-	// Bind our vertex buffer
-	const UINT32 stride = sizeof(Vertex); //  sizeof(float) * 8;
-	const UINT32 offset = 0;
-	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
+	material = new Material();
+	mesh = AcquireMesh(meshes, "<quad>", [=](const std::string& key) { return CreateMesh(key, dxdevice); });
+	nbr_indices = mesh->index_ranges[0].size;
+}
 
-	// Bind our index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
-
-	if (material)
-	{
-		if (bufferUpdate)
-		{
-			(bufferUpdate)(material->Ka.xyz1(), material->Kd.xyz1(), material->Ks.xyz1(), material->shininess);
-		}
-		dxdevice_context->PSSetShaderResources(0, 1, &material->diffuse_texture.texture_SRV);
-		dxdevice_context->PSSetShaderResources(1, 1, &material->normal_texture.texture_SRV);
-		dxdevice_context->PSSetShaderResources(2, 1, &material->specular_texture.texture_SRV);
-	}
 
+void QuadModel::Draw(StateCache& state, unsigned /*drawcall*/) const
+{
 	// Make the drawcall
-	dxdevice_context->DrawIndexed(nbr_indices, 0, 0);
+	state.DrawIndexed(nbr_indices, 0, 0);
 }
 
+void QuadModel::DrawInstanced(
+	StateCache& state,
+	unsigned /*drawcall*/,
+	unsigned nbr_instances,
+	unsigned first_instance) const
+{
+	state.DrawIndexedInstanced(nbr_indices, nbr_instances, 0, 0, first_instance);
+}
 
-OBJModel::OBJModel(
+
+#ifdef MESH_USE_CACHE
+//
+// Hash of the settings that shape a processed mesh besides its files: the
+// switches of the load pipeline and the options of the loader
+//
+static uint64_t MeshSettingsHash(
+	const OBJLoader& loader,
+	bool generate_normals,
+	bool triangulate)
+{
+	uint32_t switches = 0;
+#ifdef MESH_OPTIMIZE
+	switches |= 1;
+#endif
+#ifdef MESH_FORCE_CCW
+	switches |= 2;
+#endif
+#ifdef MESH_SORT_DRAWCALLS
+	switches |= 4;
+#endif
+
+	uint32_t settings[5] =
+	{
+		switches,
+		generate_normals,
+		triangulate,
+		loader.area_weighted_normals,
+		0
+	};
+	memcpy(&settings[4], &loader.crease_angle, sizeof(float));
+	return MeshCache::Hash(settings, sizeof(settings));
+}
+#endif
+
+std::shared_ptr<MeshAsset> OBJModel::LoadMesh(
 	const std::string& objfile,
-	ID3D11Device* dxdevice,
-	ID3D11DeviceContext* dxdevice_context)
-	: Model(dxdevice, dxdevice_context)
+	const std::string& name,
+	ID3D11Device* dxdevice)
 {
-	// Load the OBJ
-	OBJLoader* mesh = new OBJLoader();
-	mesh->Load(objfile);
+	std::shared_ptr<MeshAsset> asset = std::make_shared<MeshAsset>(name);
+	std::vector<IndexRange>& index_ranges = asset->index_ranges;
+	std::vector<Material>& materials = asset->materials;
 
-	// Load and organize indices in ranges per drawcall (material)
+	// Vertex and index data to upload, either from the cache or from a loaded OBJ
+	const Vertex* vertex_data = nullptr;
+	const unsigned* index_data = nullptr;
+	unsigned nbr_vertices = 0, nbr_indices = 0;
 
+	// The loader and its options, which the cache depends on as well
+	const bool generate_normals = true, triangulate = true;
+	OBJLoader* mesh = new OBJLoader();
 	std::vector<unsigned> indices;
-	unsigned int i_ofs = 0;
+	bool cached = false;
 
-	for (auto& dc : mesh->drawcalls)
+#ifdef MESH_USE_CACHE
+	// A valid cache is mapped and uploaded as-is, skipping parsing and processing
+	const uint64_t settings = MeshSettingsHash(*mesh, generate_normals, triangulate);
+	MeshCache cache;
+	if (cache.Load(objfile, settings))
 	{
-		// Append the drawcall indices
-		for (auto& tri : dc.tris)
-			indices.insert(indices.end(), tri.vi, tri.vi + 3);
-
-		// Create a range
-		unsigned int i_size = (unsigned int)dc.tris.size() * 3;
-		int mtl_index = dc.mtl_index > -1 ? dc.mtl_index : -1;
-		index_ranges.push_back({ i_ofs, i_size, 0, mtl_index });
-
-		i_ofs = (unsigned int)indices.size();
+		std::cout << "Loaded cached " << objfile << std::endl;
+		vertex_data = cache.Vertices();
+		nbr_vertices = cache.VertexCount();
+		index_data = cache.Indices();
+		nbr_indices = cache.IndexCount();
+		index_ranges = cache.IndexRanges();
+		materials = cache.Materials();
+		cached = true;
 	}
+#endif
 
-	for (int i = 0; i < indices.size(); i += 3)
+	if (!cached)
 	{
-		compute_TB(mesh->vertices[indices[i + 0]], mesh->vertices[indices[i + 1]], mesh->vertices[indices[i + 2]]);
-	}
-
-	// Vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0 };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = (UINT)(mesh->vertices.size()*sizeof(Vertex));
-	// Data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &(mesh->vertices)[0];
-	// Create vertex buffer on device using descriptor & data
-	HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
-	SETNAME(vertex_buffer, "VertexBuffer");
-    
-	// Index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0 };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = (UINT)(indices.size()*sizeof(unsigned));
-
-	// Data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// Create index buffer on device using descriptor & data
-	HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
-	SETNAME(index_buffer, "IndexBuffer");
-    
-	// Copy materials from mesh
-	append_materials(mesh->materials);
+		// Load the OBJ
+		mesh->Load(objfile, generate_normals, triangulate);
 
-	// Go through materials and load textures (if any) to device
-	std::cout << "Loading textures..." << std::endl;
-	for (auto& mtl : materials)
-	{
-		HRESULT hr;
-
-		// Load Diffuse texture
-		//
-		if (mtl.Kd_texture_filename.size()) {
-
-			hr = LoadTextureFromFile(
-				dxdevice,
-				mtl.Kd_texture_filename.c_str(), 
-				&mtl.diffuse_texture);
-			std::cout << "\t" << mtl.Kd_texture_filename 
-				<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
-		}
+		// Load and organize indices in ranges per drawcall (material)
 
-		if (mtl.normal_texture_filename.size()) {
+		unsigned int i_ofs = 0;
 
-			hr = LoadTextureFromFile(
-				dxdevice,
-				mtl.normal_texture_filename.c_str(),
-				&mtl.normal_texture);
-			std::cout << "\t" << mtl.normal_texture_filename
-				<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
-		}
+		for (auto& dc : mesh->drawcalls)
+		{
+			// Append the drawcall indices
+			for (auto& tri : dc.tris)
+				indices.insert(indices.end(), tri.vi, tri.vi + 3);
 
-		if (mtl.specular_texture_filename.size()) {
+			// Create a range
+			unsigned int i_size = (unsigned int)dc.tris.size() * 3;
+			int mtl_index = dc.mtl_index > -1 ? dc.mtl_index : -1;
+			index_ranges.push_back({ i_ofs, i_size, 0, mtl_index });
 
-			hr = LoadTextureFromFile(
-				dxdevice,
-				mtl.specular_texture_filename.c_str(),
-				&mtl.specular_texture);
-			std::cout << "\t" << mtl.specular_texture_filename
-				<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
+			i_ofs = (unsigned int)indices.size();
 		}
 
-		// + other texture types here - see Material class
-		// ...
+#ifdef MESH_OPTIMIZE
+		// Triangle order per drawcall for the post-transform cache and overdraw,
+		// then vertex order for fetch locality
+		VertexCacheStats before = AnalyzeVertexCache(indices.data(), indices.size());
+		for (auto& irange : index_ranges)
+		{
+			if (!irange.size) continue;
+			OptimizeVertexCache(&indices[irange.start], irange.size);
+			OptimizeOverdraw(&indices[irange.start], irange.size, mesh->vertices.data());
+		}
+		OptimizeVertexFetch(mesh->vertices, indices);
+		VertexCacheStats after = AnalyzeVertexCache(indices.data(), indices.size());
+		std::cout << "Vertex cache: ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+#endif
+
+		// Tangent frames for normal mapping
+		GenerateTangents(mesh->vertices, indices);
+
+		// Copy materials from mesh
+		materials = mesh->materials;
+
+#ifdef MESH_USE_CACHE
+		if (!MeshCache::Save(objfile, settings, mesh->material_files, mesh->vertices, indices, index_ranges, materials))
+			std::cout << "Failed to write " << MeshCache::CachePath(objfile) << std::endl;
+#endif
+
+		vertex_data = mesh->vertices.data();
+		nbr_vertices = (unsigned)mesh->vertices.size();
+		index_data = indices.data();
+		nbr_indices = (unsigned)indices.size();
 	}
+
+	// Create vertex buffer on device
+	asset->CreateVertexBuffer(dxdevice, vertex_data, nbr_vertices);
+    
+	// Create index buffer on device, 16-bit if possible. This may split
+	// index_ranges into ranges with different base vertices
+	asset->CreateIndexBuffer(dxdevice, index_data, nbr_indices);
+
+	// Model space bounds, in total and per range, for frustum culling. The
+	// ranges keep their positions in the index array when split above
+	asset->bounds = MeshAsset::IndexedBounds(vertex_data, index_data, nbr_indices);
+	for (auto& irange : index_ranges)
+		asset->range_bounds.push_back(MeshAsset::IndexedBounds(vertex_data, index_data + irange.start, irange.size));
+
+	// Go through materials and load textures (if any) to device
+	std::cout << "Loading textures..." << std::endl;
+	for (auto& mtl : materials)
+		LoadMaterial(dxdevice, mtl, false);
 	std::cout << "Done." << std::endl;
 
 	SAFE_DELETE(mesh);
+	return asset;
 }
 
+OBJModel::OBJModel(
+	const std::string& objfile,
+	ID3D11Device* dxdevice,
+	ID3D11DeviceContext* dxdevice_context,
+	MeshRegistry* meshes)
+	: Model(dxdevice, dxdevice_context)
+{
+	mesh = AcquireMesh(meshes, MeshRegistry::CanonicalPath(objfile),
+		[&](const std::string& key) { return LoadMesh(objfile, key, dxdevice); });
 
-void OBJModel::Render(std::function<void(vec4f Ka, vec4f Kd, vec4f Ks, float shininess)> bufferUpdate) const
+	// Culling results are per model, the ranges are shared
+	const size_t nbr_ranges = mesh->index_ranges.size();
+	range_visible.reset(new bool[nbr_ranges]);
+	std::fill(range_visible.get(), range_visible.get() + nbr_ranges, true);
+}
+
+
+const Material* OBJModel::DrawcallMaterial(unsigned drawcall) const
 {
-	// Bind vertex buffer
-	const UINT32 stride = sizeof(Vertex);
-	const UINT32 offset = 0;
-	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
+	const int mtl_index = mesh->index_ranges[drawcall].mtl_index;
+	return mtl_index >= 0 ? &mesh->materials[mtl_index] : nullptr;
+}
 
-	// Bind index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+void OBJModel::Draw(StateCache& state, unsigned drawcall) const
+{
+	const IndexRange& irange = mesh->index_ranges[drawcall];
 
-	// Iterate drawcalls
-	for (auto& irange : index_ranges)
-	{
-		// Fetch material
-		const Material& mtl = materials[irange.mtl_index];
-
-		
-			if (bufferUpdate)
-			{
-				(bufferUpdate)(mtl.Ka.xyz1(), mtl.Kd.xyz1(), mtl.Ks.xyz1(), mtl.shininess);
-			}
-			dxdevice_context->PSSetShaderResources(0, 1, &mtl.diffuse_texture.texture_SRV);
-			dxdevice_context->PSSetShaderResources(1, 1, &mtl.normal_texture.texture_SRV);
-			dxdevice_context->PSSetShaderResources(2, 1, &mtl.specular_texture.texture_SRV);
-		
-
-		// Bind diffuse texture to slot t0 of the PS
-		dxdevice_context->PSSetShaderResources(0, 1, &mtl.diffuse_texture.texture_SRV);
-		// + bind other textures here, e.g. a normal map, to appropriate slots
-
-		// Make the drawcall
-		dxdevice_context->DrawIndexed(irange.size, irange.start, 0);
-	}
+	// Make the drawcall
+	state.DrawIndexed(irange.size, irange.start, (INT)irange.ofs);
 }
 
-OBJModel::~OBJModel()
+void OBJModel::DrawInstanced(
+	StateCache& state,
+	unsigned drawcall,
+	unsigned nbr_instances,
+	unsigned first_instance) const
 {
-	for (auto& material : materials)
-	{
-		SAFE_RELEASE(material.diffuse_texture.texture_SRV);
-		SAFE_RELEASE(material.normal_texture.texture_SRV);
-		SAFE_RELEASE(material.specular_texture.texture_SRV);
-		// Release other used textures ...
-	}
+	const IndexRange& irange = mesh->index_ranges[drawcall];
+
+	state.DrawIndexedInstanced(irange.size, nbr_instances, irange.start, (INT)irange.ofs, first_instance);
 }
 
-Cube::Cube(ID3D11Device* dxdevice, 
-	ID3D11DeviceContext* dxdevice_context)
-	: Model (dxdevice, dxdevice_context) 
+bool OBJModel::Cull(
+	const vec4f* frustum_planes,
+	CullStats& stats)
+{
+	if (!Model::Cull(frustum_planes, stats))
+		return false;
+
+	const std::vector<aabb3f>& range_bounds = mesh->range_bounds;
+	const size_t nbr_visible = cull_aabbs(frustum_planes, range_bounds.data(), range_visible.get(), range_bounds.size());
+
+	stats.ranges_tested += (unsigned)range_bounds.size();
+	stats.ranges_culled += (unsigned)(range_bounds.size() - nbr_visible);
+	return nbr_visible > 0;
+}
+
+std::shared_ptr<MeshAsset> Cube::CreateMesh(
+	const std::string& name,
+	ID3D11Device* dxdevice)
 {
 	std::vector<Vertex> vertices;
 	std::vector<unsigned> indices;
-	material = new Material();
 	//Vertex array and vertices
 	Vertex v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19, v20, v21, v22, v23;
 	v0.Pos = { -0.5f, 0.5f, -0.5f };
@@ -420,71 +616,43 @@ Cube::Cube(ID3D11Device* dxdevice,
 
 
 	//Copy from Quad class
-	// Vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0 };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = (UINT)(vertices.size() * sizeof(Vertex));
-	// Data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &vertices[0];
-	// Create vertex buffer on device using descriptor & data
-	const HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
-	SETNAME(vertex_buffer, "VertexBuffer");
-
-	//  Index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0 };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = (UINT)(indices.size() * sizeof(unsigned));
-	// Data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// Create index buffer on device using descriptor & data
-	const HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
-	SETNAME(index_buffer, "IndexBuffer");
-
-	nbr_indices = (unsigned int)indices.size();
-}
+	std::shared_ptr<MeshAsset> asset = std::make_shared<MeshAsset>(name);
 
-void Cube::Render(std::function<void(vec4f Ka, vec4f Kd, vec4f Ks, float shininess)> bufferUpdate) const
-{
-	// Bind our vertex buffer
-	const UINT32 stride = sizeof(Vertex); //  sizeof(float) * 8;
-	const UINT32 offset = 0;
-	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
+	// Create vertex buffer on device
+	asset->CreateVertexBuffer(dxdevice, &vertices[0], (unsigned)vertices.size());
 
-	// Bind our index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	// Create index buffer on device. The mesh is too small to need base
+	// vertices, so it is drawn as a single range starting at vertex 0
+	asset->index_ranges = { { 0, (unsigned)indices.size(), 0, -1 } };
+	asset->CreateIndexBuffer(dxdevice, &indices[0], (unsigned)indices.size());
 
-	if(material) 
-	{
-		if(bufferUpdate) 
-		{
-			(bufferUpdate)(material->Ka.xyz1(), material->Kd.xyz1(), material->Ks.xyz1(), material->shininess);
-		}
-		/*if(cubeBool)
-		dxdevice_context->PSSetShaderResources(3, 1, &material->cube_texture.texture_SRV);*/
-		/*else */
-		/*{*/
-		if (cubeBool)
-			dxdevice_context->PSSetShaderResources(3, 1, &material->cube_texture.texture_SRV);
-
-			dxdevice_context->PSSetShaderResources(0, 1, &material->diffuse_texture.texture_SRV);
-			dxdevice_context->PSSetShaderResources(1, 1, &material->normal_texture.texture_SRV);
-			dxdevice_context->PSSetShaderResources(2, 1, &material->specular_texture.texture_SRV);
-		/*}*/
-
-		
-	}
+	asset->bounds = MeshAsset::IndexedBounds(&vertices[0], &indices[0], (unsigned)indices.size());
+	return asset;
+}
 
+Cube::Cube(ID3D11Device* dxdevice, 
+	ID3D11DeviceContext* dxdevice_context,
+	MeshRegistry* meshes)
+	: Model (dxdevice, dxdevice_context) 
+{
+	material = new Material();
+	mesh = AcquireMesh(meshes, "<cube>", [=](const std::string& key) { return CreateMesh(key, dxdevice); });
+	nbr_indices = mesh->index_ranges[0].size;
+}
+
+void Cube::Draw(StateCache& state, unsigned /*drawcall*/) const
+{
 	// Make the drawcall
-	dxdevice_context->DrawIndexed(nbr_indices, 0, 0);
+	state.DrawIndexed(nbr_indices, 0, 0);
+}
 
+void Cube::DrawInstanced(
+	StateCache& state,
+	unsigned /*drawcall*/,
+	unsigned nbr_instances,
+	unsigned first_instance) const
+{
+	state.DrawIndexedInstanced(nbr_indices, nbr_instances, 0, 0, first_instance);
 }
 
 
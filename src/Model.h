@@ -13,14 +13,34 @@
 #include <vector>
 #include "vec\vec.h"
 #include "vec\mat.h"
+#include "vec\frustum.h"
 #include "ShaderBuffers.h"
 #include "Drawcall.h"
 #include "OBJLoader.h"
+#include "MeshCache.h"
+#include "MeshAsset.h"
+#include "VertexFormat.h"
+#include "IndexBuffer.h"
 #include "Texture.h"
+#include "StateCache.h"
 #include <functional>
+#include <memory>
 
 using namespace linalg;
 
+//
+// Frustum culling counters, see Model::Cull
+//
+struct CullStats
+{
+	unsigned objects_tested = 0;
+	unsigned objects_culled = 0;
+	unsigned ranges_tested = 0;
+	unsigned ranges_culled = 0;
+	unsigned instances_tested = 0;	// see ModelInstances::Gather
+	unsigned instances_culled = 0;
+};
+
 class Model
 {
 protected:
@@ -28,11 +48,42 @@ protected:
 	ID3D11Device* const			dxdevice;
 	ID3D11DeviceContext* const	dxdevice_context;
 
-	// Pointers to the class' vertex & index arrays
-	ID3D11Buffer* vertex_buffer = nullptr;
-	ID3D11Buffer* index_buffer = nullptr;
+	// Vertex & index buffers, index ranges, bounds and (for OBJModel)
+	// materials, shared with the other models of the same mesh
+	std::shared_ptr<const MeshAsset> mesh;
 
-	Material* material;
+	//
+	// The mesh of key from meshes, loaded by load(key) if it has none alive.
+	// Without a registry, the mesh is always loaded, and not shared
+	//
+	template<class F>
+	static std::shared_ptr<const MeshAsset> AcquireMesh(
+		MeshRegistry* meshes,
+		const std::string& key,
+		F&& load)
+	{
+		if (meshes)
+			return meshes->Acquire(key, load);
+		return load(key);
+	}
+
+	//
+	// Bind the vertex buffer (and its dequantization constants) for drawing
+	//
+	void BindVertexBuffer(StateCache& state) const;
+
+	//
+	// Create the immutable constant buffer of mtl
+	//
+	static void CreateMaterialBuffer(
+		ID3D11Device* dxdevice,
+		Material& mtl);
+
+	Material* material = nullptr;
+
+	// Material owned elsewhere, drawn with instead of material (see
+	// ShareMaterial)
+	const Material* shared_material = nullptr;
 	//Texture cube_texture;
 	//std::string cube_filename;
 
@@ -47,157 +98,128 @@ public:
 	{ 		
 	}
 	bool cubeBool = false;
+
 	//
-	// Abstract render method: must be implemented by derived classes
+	// Render all drawcalls that passed the last Cull, binding the
+	// buffers and the material of each drawcall
 	//
-	virtual void Render(std::function<void(vec4f, vec4f, vec4f, float)>) const = 0;
+	void Render(StateCache& state) const;
 
-	void SetMaterial(Material m) 
-	{
-		*material = m;
-
-		
-			std::cout << "Loading cube textures..." << std::endl;
-			HRESULT hr;
-
-			// Load Diffuse texture
-			//	
-			if (material->Kd_texture_filename.size()) {
-
-				hr = LoadTextureFromFile(
-					dxdevice,
-					material->Kd_texture_filename.c_str(),
-					&material->diffuse_texture);
-				std::cout << "\t" << material->Kd_texture_filename
-					<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
-			}
-
-			if (material->normal_texture_filename.size()) {
-
-				hr = LoadTextureFromFile(
-					dxdevice,
-					material->normal_texture_filename.c_str(),
-					&material->normal_texture);
-				std::cout << "\t" << material->normal_texture_filename
-					<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
-			}
-
-			if (material->specular_texture_filename.size()) {
-
-				hr = LoadTextureFromFile(
-					dxdevice,
-					material->specular_texture_filename.c_str(),
-					&material->specular_texture);
-				std::cout << "\t" << material->specular_texture_filename
-					<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
-			}
-
-			if(cubeBool) 
-			{
-				hr = LoadCubeTextureFromFile(
-					dxdevice,
-					material->cube_filenames,
-					&material->cube_texture);
-				if (SUCCEEDED(hr)) std::cout << "Cubemap OK" << std::endl;
-				else std::cout << "Cubemap failed to load" << std::endl;
-			}
-		
-	}
-
-	void compute_TB(Vertex& v0, Vertex& v1, Vertex& v2) 
-	{
-
-		/*vec3f tangent, binormal;
-		vec3f normal = v0.Normal;
-
-		vec2f texture1 = v0.TexCoord;
-		vec2f texture2 = v1.TexCoord;
-		vec2f texture3 = v2.TexCoord;
-
-		float det = (texture1.x * texture2.y) - (texture1.y * texture2.x);
-
-		det = 1.0f / det;
-
-		tangent.x = det * ((texture2.y * (v0.Pos.x - v1.Pos.x)) + (texture1.y * (v1.Pos.x - v2.Pos.x)));
-		tangent.y = det * ((texture2.y * (v0.Pos.y - v1.Pos.y)) + (texture1.y * (v1.Pos.y - v2.Pos.y)));
-		tangent.z = det * ((texture2.y * (v0.Pos.z - v1.Pos.z)) + (texture1.y * (v1.Pos.z - v2.Pos.z)));
-
-		binormal.x = det * ((texture1.x * (v1.Pos.x - v2.Pos.x)) + (texture2.x * (v0.Pos.x - v1.Pos.x)));
-		binormal.y = det * ((texture1.x * (v1.Pos.y - v2.Pos.y)) + (texture2.x * (v0.Pos.y - v1.Pos.y)));
-		binormal.z = det * ((texture1.x * (v1.Pos.z - v2.Pos.z)) + (texture2.x * (v0.Pos.z - v1.Pos.z)));
+	//
+	// Drawcalls, for rendering through a render queue. Draw issues one
+	// drawcall, with the buffers bound by BindBuffers and its material
+	// bound by BindMaterial
+	//
+	virtual unsigned DrawcallCount() const { return 1; }
 
-		v0.Tangent = tangent;
-		v1.Tangent = tangent;
-		v2.Tangent = tangent;
-		
-		v0.Binormal = binormal;
-		v1.Binormal = binormal;
-		v2.Binormal = binormal;*/
+	//
+	// Whether the drawcall passed the last Cull
+	//
+	virtual bool DrawcallVisible(unsigned /*drawcall*/) const { return true; }
 
-		vec3f tangent, binormal;
+	//
+	// Material of the drawcall, nullptr if none
+	//
+	virtual const Material* DrawcallMaterial(unsigned /*drawcall*/) const { return GetMaterial(); }
 
-		float vector1[3], vector2[3];
-		float tuVector[2], tvVector[2];
-		float den;
-		float length;
+	//
+	// Model space bounds of the drawcall
+	//
+	virtual const aabb3f& DrawcallBounds(unsigned /*drawcall*/) const { return mesh->bounds; }
 
+	virtual void Draw(StateCache& state, unsigned drawcall) const = 0;
 
-		// Calculate the two vectors for this face.
-		vector1[0] = v1.Pos.x - v0.Pos.x;
-		vector1[1] = v1.Pos.y - v0.Pos.y;
-		vector1[2] = v1.Pos.z - v0.Pos.z;
+	//
+	// Issue the drawcall for nbr_instances instances, starting at
+	// first_instance of the instance buffer (see ModelInstances)
+	//
+	virtual void DrawInstanced(
+		StateCache& state,
+		unsigned drawcall,
+		unsigned nbr_instances,
+		unsigned first_instance) const = 0;
 
-		vector2[0] = v2.Pos.x - v0.Pos.x;
-		vector2[1] = v2.Pos.y - v0.Pos.y;
-		vector2[2] = v2.Pos.z - v0.Pos.z;
+	//
+	// Bind the vertex and index buffers
+	//
+	void BindBuffers(StateCache& state) const;
 
-		// Calculate the tu and tv texture space vectors.
-		tuVector[0] = v1.TexCoord.x - v0.TexCoord.x;
-		tvVector[0] = v1.TexCoord.y - v0.TexCoord.y;
+	//
+	// Bind the textures of mtl to slots t0-t2 of the PS, and its
+	// cube map (if any) to t3
+	//
+	static void BindTextures(
+		StateCache& state,
+		const Material& mtl);
 
-		tuVector[1] = v2.TexCoord.x - v0.TexCoord.x;
-		tvVector[1] = v2.TexCoord.y - v0.TexCoord.y;
+	//
+	// Bind the constant buffer of mtl to slot b1 of the PS
+	//
+	static void BindMaterialBuffer(
+		StateCache& state,
+		const Material& mtl);
 
-		// Calculate the denominator of the tangent/binormal equation.
-		den = 1.0f / (tuVector[0] * tvVector[1] - tuVector[1] * tvVector[0]);
+	//
+	// Bind mtl: its constant buffer and its textures
+	//
+	static void BindMaterial(
+		StateCache& state,
+		const Material& mtl);
 
-		// Calculate the cross products and multiply by the coefficient to get the tangent and binormal.
-		tangent.x = (tvVector[1] * vector1[0] - tvVector[0] * vector2[0]) * den;
-		tangent.y = (tvVector[1] * vector1[1] - tvVector[0] * vector2[1]) * den;
-		tangent.z = (tvVector[1] * vector1[2] - tvVector[0] * vector2[2]) * den;
+	//
+	// Test the model against frustum planes in model space (see
+	// transform_planes). Returns false if it is entirely outside, so that
+	// it need not be rendered at all. Models with several drawcalls also
+	// mark which of them the next Render should skip
+	//
+	virtual bool Cull(
+		const vec4f* frustum_planes,
+		CullStats& stats);
 
-		binormal.x = (tuVector[0] * vector2[0] - tuVector[1] * vector1[0]) * den;
-		binormal.y = (tuVector[0] * vector2[1] - tuVector[1] * vector1[1]) * den;
-		binormal.z = (tuVector[0] * vector2[2] - tuVector[1] * vector1[2]) * den;
+	const Material* GetMaterial() const { return shared_material ? shared_material : material; }
 
-		// Calculate the length of this normal.
-		length = sqrt((tangent.x * tangent.x) + (tangent.y * tangent.y) + (tangent.z * tangent.z));
+	// Model space bounds of all drawcalls
+	const aabb3f& GetBounds() const { return mesh->bounds; }
 
-		// Normalize the normal and then store it
-		tangent.x = tangent.x / length;
-		tangent.y = tangent.y / length;
-		tangent.z = tangent.z / length;
+	const MeshAsset& GetMesh() const { return *mesh; }
 
-		// Calculate the length of this normal.
-		length = sqrt((binormal.x * binormal.x) + (binormal.y * binormal.y) + (binormal.z * binormal.z));
+	//
+	// Load the textures of mtl to the device, and its cube map if
+	// load_cube_map is set, and create its constant buffer
+	//
+	static void LoadMaterial(
+		ID3D11Device* dxdevice,
+		Material& mtl,
+		bool load_cube_map);
 
-		// Normalize the normal and then store it
-		binormal.x = binormal.x / length;
-		binormal.y = binormal.y / length;
-		binormal.z = binormal.z / length;
+	//
+	// Release what LoadMaterial created
+	//
+	static void ReleaseMaterial(Material& mtl);
 
-		v0.Tangent = v1.Tangent = v2.Tangent = tangent;
-		v0.Binormal = v1.Binormal = v2.Binormal = binormal;
+	void SetMaterial(Material m) 
+	{
+		SAFE_RELEASE(material->constant_buffer);
+		*material = m;
 
+		std::cout << "Loading cube textures..." << std::endl;
+		LoadMaterial(dxdevice, *material, cubeBool);
 	}
 
+	//
+	// Draw with mtl, already loaded and owned by the caller, so that its
+	// textures and constant buffer are shared with the other users of it
+	// rather than loaded again as by SetMaterial
+	//
+	void ShareMaterial(const Material* mtl) { shared_material = mtl; }
+
 	//
 	// Destructor
 	//
 	virtual ~Model()
 	{ 
-		SAFE_RELEASE(vertex_buffer);
-		SAFE_RELEASE(index_buffer);
+		if (material)
+			SAFE_RELEASE(material->constant_buffer);
 	}
 };
 
@@ -205,46 +227,73 @@ class QuadModel : public Model
 {
 	unsigned nbr_indices = 0;
 
+	static std::shared_ptr<MeshAsset> CreateMesh(
+		const std::string& name,
+		ID3D11Device* dxdevice);
+
 public:
 
 	QuadModel(
 		ID3D11Device* dx3ddevice,
-		ID3D11DeviceContext* dx3ddevice_context);
+		ID3D11DeviceContext* dx3ddevice_context,
+		MeshRegistry* meshes = nullptr);
+
+	virtual void Draw(StateCache& state, unsigned drawcall) const;
 
-	virtual void Render(std::function<void(vec4f, vec4f, vec4f, float)>) const;
+	virtual void DrawInstanced(
+		StateCache& state,
+		unsigned drawcall,
+		unsigned nbr_instances,
+		unsigned first_instance) const;
 
 	~QuadModel() { }
 };
 
 class OBJModel : public Model
 {
-	// index ranges, representing drawcalls, within an index array
-	struct IndexRange
-	{
-		unsigned int start;
-		unsigned int size;
-		unsigned ofs;
-		int mtl_index;
-	};
-
-	std::vector<IndexRange> index_ranges;
-	std::vector<Material> materials;
+	// Whether each index range of the mesh passed the last Cull
+	std::unique_ptr<bool[]> range_visible;
 
-	void append_materials(const std::vector<Material>& mtl_vec)
-	{
-		materials.insert(materials.end(), mtl_vec.begin(), mtl_vec.end());
-	}
+	//
+	// Load, process and upload an OBJ file, or its mesh cache
+	//
+	static std::shared_ptr<MeshAsset> LoadMesh(
+		const std::string& objfile,
+		const std::string& name,
+		ID3D11Device* dxdevice);
 
 public:
 
+	//
+	// Load objfile, or share its mesh with the other models of meshes
+	//
 	OBJModel(
 		const std::string& objfile,
 		ID3D11Device* dxdevice,
-		ID3D11DeviceContext* dxdevice_context);
+		ID3D11DeviceContext* dxdevice_context,
+		MeshRegistry* meshes = nullptr);
+
+	virtual unsigned DrawcallCount() const { return (unsigned)mesh->index_ranges.size(); }
+
+	virtual bool DrawcallVisible(unsigned drawcall) const { return range_visible[drawcall]; }
+
+	virtual const Material* DrawcallMaterial(unsigned drawcall) const;
 
-	virtual void Render(std::function<void(vec4f, vec4f, vec4f, float)>) const;
+	virtual const aabb3f& DrawcallBounds(unsigned drawcall) const { return mesh->range_bounds[drawcall]; }
 
-	~OBJModel();
+	virtual void Draw(StateCache& state, unsigned drawcall) const;
+
+	virtual void DrawInstanced(
+		StateCache& state,
+		unsigned drawcall,
+		unsigned nbr_instances,
+		unsigned first_instance) const;
+
+	virtual bool Cull(
+		const vec4f* frustum_planes,
+		CullStats& stats);
+
+	~OBJModel() { }
 };
 
 class Cube : public Model 
@@ -252,14 +301,25 @@ class Cube : public Model
 
 	unsigned nbr_indices = 0;
 
+	static std::shared_ptr<MeshAsset> CreateMesh(
+		const std::string& name,
+		ID3D11Device* dxdevice);
+
 public:
 
 	Cube(
 		ID3D11Device* dx3ddevice,
-		ID3D11DeviceContext* dx33ddevice_context
+		ID3D11DeviceContext* dx33ddevice_context,
+		MeshRegistry* meshes = nullptr
 	);
 	
-	virtual void Render(std::function<void(vec4f, vec4f, vec4f, float)>) const;
+	virtual void Draw(StateCache& state, unsigned drawcall) const;
+
+	virtual void DrawInstanced(
+		StateCache& state,
+		unsigned drawcall,
+		unsigned nbr_instances,
+		unsigned first_instance) const;
 
 	~Cube() {}
 
@@ -5,9 +5,14 @@
 //  Carl Johan Gribel 2016-2021, cjgribel@gmail.com
 //
 
-#include <fstream>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include "OBJLoader.h"
+#include "VertexWelder.h"
+#include "MappedFile.h"
+#include "Parallel.h"
 #include "vec/vec.h"
 #include "parseutil.h"
 
@@ -27,49 +32,483 @@ struct unwelded_drawcall_t
 	int v_ofs = 0;
 };
 
+//
+// Parse one face corner (v, v/vt, v//vn or v/vt/vn) into an int3 of raw,
+// 1-based OBJ (vertex, normal, texel) indices, with 0 for absent ones
+//
+static bool parse_face_corner(
+	const char*& p, 
+	const char* end, 
+	int3& corner)
+{
+	int i;
+	if (!parse_int(p, end, i)) return false;
+
+	corner = { i, 0, 0 };
+	if (p < end && *p == '/')
+	{
+		p++;
+		if (p < end && *p != '/' && parse_int(p, end, i))
+			corner.z = i;
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (parse_int(p, end, i))
+				corner.y = i;
+		}
+	}
+	return true;
+}
+
+//
+// Move the contents of src to the end of dst
+//
+template<class T>
+static void append_vector(std::vector<T>& dst, std::vector<T>& src)
+{
+	if (dst.empty())
+		dst = std::move(src);
+	else
+		dst.insert(dst.end(), std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+	std::vector<T>().swap(src);
+}
+
+//
+// Raw data from a contiguous, newline-aligned chunk of an OBJ file
+//
+// Chunks are parsed independently and then stitched together in file order.
+// State that a chunk cannot know on its own (indices relative to the end of 
+// earlier chunks, the active group and drawcall, the skinning offset) is kept 
+// in chunk-local form and resolved when the chunks are merged
+//
+struct obj_chunk_t
+{
+	std::vector<vec3f> vertices, normals;
+	std::vector<vec2f> texcoords;
+	std::vector<std::string> mtllibs;
+
+	// faces before the first usemtl of the chunk, which belong to 
+	// the drawcall that is active where the chunk starts
+	unwelded_drawcall_t leading;
+	std::vector<unwelded_drawcall_t> drawcalls;
+
+	// drawcalls started before the first 'g' of the chunk use the incoming group
+	size_t drawcalls_with_incoming_group = 0;
+	bool has_group = false;
+	std::string group_name;
+
+	// negative indices are stored chunk-relative (see relative_index)
+	bool has_relative_indices = false;
+
+	// skinning offsets: v_ofs and last_ofs are chunk-local, 
+	// or -1 if they are inherited from the previous chunk
+	int last_ofs = -1;
+	int face_section = -1;			// -1 = unknown, 0 = false, 1 = true
+	bool leading_vertices = false;	// vertices before the first usemtl
+};
+
+//
+// Convert a raw 1-based OBJ index to a 0-based one (-1 if absent).
+// Negative indices, relative to the end of the array parsed so far, are 
+// encoded below -1: they refer to element (value + RelativeIndexBias) 
+// counted from the start of the chunk
+//
+const int RelativeIndexBias = 1 << 30;
+
+inline int relative_index(int i, int count)
+{
+	return i < 0 ? count + i - RelativeIndexBias : i - 1;
+}
+
+inline void rebase_index(int& i, int base)
+{
+	if (i < -1) i += RelativeIndexBias + base;
+}
+
+static void ParseChunk(
+	const char* chunk_begin,
+	const char* chunk_end,
+	bool triangulate,
+	obj_chunk_t& chunk)
+{
+	unwelded_drawcall_t* current_drawcall = &chunk.leading;
+
+	// reused between faces so that parsing does not allocate once warmed up
+	std::vector<int3> face;
+
+	for (const char* line = chunk_begin; line < chunk_end; )
+	{
+		const char* end = (const char*)memchr(line, '\n', chunk_end - line);
+		if (!end) end = chunk_end;
+		const char* p = line;
+		line = end + 1;
+		float x, y, z;
+
+		p = skip_blanks(p, end);
+		if (p == end) continue;
+
+		// dispatch on the first character of the line, then on the full keyword
+		switch (*p)
+		{
+		case 'v':
+			// 3D or 2D vertex
+			//
+			if (parse_keyword(p, end, "v"))
+			{
+				if (!parse_float(p, end, x) || !parse_float(p, end, y)) break;
+				if (!parse_float(p, end, z)) z = 0.0f;
+
+				// update vertex offset and mark end to a face section
+				if (chunk.face_section == 1)
+					chunk.last_ofs = (int)chunk.vertices.size();
+				else if (chunk.face_section == -1)
+					chunk.leading_vertices = true;
+				chunk.face_section = 0;
+
+				chunk.vertices.push_back(vec3f(x, y, z));
+			}
+			// 2D texel (a 3D texel has its last component ignored)
+			//
+			else if (parse_keyword(p, end, "vt"))
+			{
+				if (parse_float(p, end, x) && parse_float(p, end, y))
+					chunk.texcoords.push_back(vec2f(x, y));
+			}
+			// normal
+			//
+			else if (parse_keyword(p, end, "vn"))
+			{
+				if (parse_float(p, end, x) && parse_float(p, end, y) && parse_float(p, end, z))
+					chunk.normals.push_back(vec3f(x, y, z));
+			}
+			break;
+
+		case 'f':
+			// face: n corners of the form v, v/vt, v//vn or v/vt/vn
+			// negative indices are relative to the end of the respective array
+			//
+			if (parse_keyword(p, end, "f"))
+			{
+				face.clear();
+				int3 corner;
+				while (parse_face_corner(p, end, corner))
+				{
+					if (corner.x < 0 || corner.y < 0 || corner.z < 0)
+						chunk.has_relative_indices = true;
+
+					face.push_back({
+						relative_index(corner.x, (int)chunk.vertices.size()),
+						relative_index(corner.y, (int)chunk.normals.size()),
+						relative_index(corner.z, (int)chunk.texcoords.size()) });
+				}
+
+				if (face.size() < 3) break;
+
+				if (face.size() == 4 && !triangulate)
+				{
+					const int3 &a = face[0], &b = face[1], &c = face[2], &d = face[3];
+					current_drawcall->quads.push_back({ a.x, b.x, c.x, d.x, a.y, b.y, c.y, d.y, a.z, b.z, c.z, d.z });
+					break;
+				}
+
+				// triangle fan around the first corner
+				for (size_t i = 1; i + 1 < face.size(); i++)
+				{
+					const int3 &a = face[0], &b = face[i], &c = face[i + 1];
+					current_drawcall->tris.push_back({ a.x, b.x, c.x, a.y, b.y, c.y, a.z, b.z, c.z });
+				}
+			}
+			break;
+
+		case 'g':
+			if (parse_keyword(p, end, "g") && p < end)
+			{
+				if (!chunk.has_group)
+					chunk.drawcalls_with_incoming_group = chunk.drawcalls.size();
+				chunk.group_name.assign(p, skip_token(p, end));
+				chunk.has_group = true;
+			}
+			break;
+
+		case 'u':
+			// active material
+			//
+			if (parse_keyword(p, end, "usemtl") && p < end)
+			{
+				unwelded_drawcall_t udc;
+				udc.mtl_name.assign(p, skip_token(p, end));
+				udc.group_name = chunk.group_name;
+				udc.v_ofs = chunk.last_ofs; chunk.face_section = 1; // skinning: set current vertex offset and mark beginning of a face-section
+				chunk.drawcalls.push_back(std::move(udc));
+				current_drawcall = &chunk.drawcalls.back();
+			}
+			break;
+
+		case 'm':
+			// material file
+			//
+			if (parse_keyword(p, end, "mtllib") && p < end)
+				chunk.mtllibs.push_back(std::string(p, skip_token(p, end)));
+			break;
+
+		default:
+			// unknown obj syntax
+			break;
+		}
+	}
+
+	if (!chunk.has_group)
+		chunk.drawcalls_with_incoming_group = chunk.drawcalls.size();
+}
+
+//
+// Resolve chunk-relative indices now that the array offsets of the chunk are known
+//
+static void RebaseChunkIndices(
+	obj_chunk_t& chunk, 
+	int v_base, 
+	int vn_base, 
+	int vt_base)
+{
+	auto rebase_drawcall = [&](unwelded_drawcall_t& dc)
+	{
+		for (auto& tri : dc.tris)
+			for (int i = 0; i < 3; i++)
+			{
+				rebase_index(tri.vi[0 + i], v_base);
+				rebase_index(tri.vi[3 + i], vn_base);
+				rebase_index(tri.vi[6 + i], vt_base);
+			}
+		for (auto& quad : dc.quads)
+			for (int i = 0; i < 4; i++)
+			{
+				rebase_index(quad.vi[0 + i], v_base);
+				rebase_index(quad.vi[4 + i], vn_base);
+				rebase_index(quad.vi[8 + i], vt_base);
+			}
+	};
+
+	rebase_drawcall(chunk.leading);
+	for (auto& dc : chunk.drawcalls)
+		rebase_drawcall(dc);
+}
+
+//
+// Face view over the triangles and quads of all drawcalls
+//
+struct normal_face_t
+{
+	int* vi;		// position indices, followed by normal indices
+	int nbr_corners;
+};
+
+inline float safe_acos(float x)
+{
+	return std::acos(std::max(-1.0f, std::min(1.0f, x)));
+}
+
 //
 // Creates normals to a set of vertices by averaging the 
-// geometric normals of the faces they belong to
+// geometric normals of the faces they belong to, weighted
+// by corner angle or by face area
 //
 // If a model lacks normals, this function can be used 
 // to create them. Works best for relatively smooth models.
 //
+// A vertex-to-corner table is built with a counting sort, after which each
+// thread gathers the normals of its own range of vertices, so no locks,
+// atomics or per-vertex allocations are needed.
+//
+// With crease_angle below 180 degrees, faces whose normals differ by more than
+// crease_angle do not smooth into each other, and vertices on creases get one
+// normal per side. Otherwise there is one normal per position.
+//
 void GenerateNormals(
 	const std::vector<vec3f>& v, 
 	std::vector<vec3f>& vn, 
-	std::vector<unwelded_drawcall_t>& drawcalls)
+	std::vector<unwelded_drawcall_t>& drawcalls,
+	bool area_weighted,
+	float crease_angle,
+	unsigned max_threads)
 {
-	std::vector<vec3f>* v_bin = new std::vector<vec3f>[v.size()];
+	std::vector<normal_face_t> faces;
+	size_t nbr_faces = 0;
+	for (auto& dc : drawcalls)
+		nbr_faces += dc.tris.size() + dc.quads.size();
+	faces.reserve(nbr_faces);
+	for (auto& dc : drawcalls)
+	{
+		for (auto& tri : dc.tris) faces.push_back({ tri.vi, 3 });
+		for (auto& quad : dc.quads) faces.push_back({ quad.vi, 4 });
+	}
+
+	const unsigned nbr_threads = parallel_thread_count(std::max(faces.size(), v.size()), 1 << 16, max_threads);
 
-	// bin normals from all faces to vertex bins
-	for (unwelded_drawcall_t& dc : drawcalls)
-		for (unwelded_triangle_t& tri : dc.tris)
+	// Pass 1: unit face normals and the weight of each corner,
+	// corner k of face f being 4 * f + k
+	//
+	std::vector<vec3f> face_normals(faces.size());
+	std::vector<float> corner_weights(faces.size() * 4);
+	parallel_ranges(faces.size(), nbr_threads, [&](unsigned, size_t begin, size_t end)
 		{
-			int a = tri.vi[0], b = tri.vi[1], c = tri.vi[2];
-			vec3f v0 = v[a], v1 = v[b], v2 = v[c];
-			vec3f n = linalg::normalize((v1 - v0) % (v2 - v0));
+			for (size_t f = begin; f < end; f++)
+			{
+				const int* vi = faces[f].vi;
+				const int n = faces[f].nbr_corners;
+				float* weights = &corner_weights[4 * f];
+
+				// length of the cross product is twice the triangle area,
+				// and twice the quad area for the diagonals of a quad
+				vec3f normal = n == 3 ?
+					(v[vi[1]] - v[vi[0]]) % (v[vi[2]] - v[vi[0]]) :
+					(v[vi[2]] - v[vi[0]]) % (v[vi[3]] - v[vi[1]]);
+				float area = std::sqrt(dot(normal, normal));
+				face_normals[f] = area > 0.0f ? normal * (1.0f / area) : vec3f_zero;
+
+				if (area_weighted)
+				{
+					for (int k = 0; k < n; k++)
+						weights[k] = area;
+				}
+				else if (n == 3)
+				{
+					vec3f e01 = safe_normalize(v[vi[1]] - v[vi[0]]);
+					vec3f e02 = safe_normalize(v[vi[2]] - v[vi[0]]);
+					vec3f e12 = safe_normalize(v[vi[2]] - v[vi[1]]);
+					weights[0] = safe_acos(dot(e01, e02));
+					weights[1] = safe_acos(-dot(e01, e12));
+					weights[2] = std::max(0.0f, 3.141592653f - weights[0] - weights[1]);
+				}
+				else
+				{
+					for (int k = 0; k < n; k++)
+					{
+						vec3f e0 = safe_normalize(v[vi[(k + 1) % n]] - v[vi[k]]);
+						vec3f e1 = safe_normalize(v[vi[(k + n - 1) % n]] - v[vi[k]]);
+						weights[k] = safe_acos(dot(e0, e1));
+					}
+				}
+			}
+		});
+
+	// Vertex-to-corner table: the corners at vertex i are
+	// vertex_corners[vertex_offsets[i]] .. vertex_corners[vertex_offsets[i+1]-1]
+	std::vector<unsigned> vertex_offsets(v.size() + 1, 0);
+	for (auto& face : faces)
+		for (int k = 0; k < face.nbr_corners; k++)
+			vertex_offsets[face.vi[k] + 1]++;
+	for (size_t i = 0; i < v.size(); i++)
+		vertex_offsets[i + 1] += vertex_offsets[i];
 
-			v_bin[a].push_back(n);
-			v_bin[b].push_back(n);
-			v_bin[c].push_back(n);
+	std::vector<unsigned> vertex_corners(vertex_offsets.back());
+	{
+		std::vector<unsigned> fill(vertex_offsets.begin(), vertex_offsets.end() - 1);
+		for (size_t f = 0; f < faces.size(); f++)
+			for (int k = 0; k < faces[f].nbr_corners; k++)
+				vertex_corners[fill[faces[f].vi[k]]++] = (unsigned)(4 * f + k);
+	}
 
-			memcpy(tri.vi + 3, tri.vi, 3 * sizeof(int));
-		}
+	// Pass 2, smooth everywhere: one normal per position, shared by all faces
+	//
+	if (crease_angle >= 180.0f)
+	{
+		vn.resize(v.size());
+		parallel_ranges(v.size(), nbr_threads, [&](unsigned, size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					vec3f n = vec3f_zero;
+					for (unsigned j = vertex_offsets[i]; j < vertex_offsets[i + 1]; j++)
+						n += face_normals[vertex_corners[j] / 4] * corner_weights[vertex_corners[j]];
+					vn[i] = safe_normalize(n);
+				}
+			});
+
+		for (auto& face : faces)
+			memcpy(face.vi + face.nbr_corners, face.vi, face.nbr_corners * sizeof(int));
+		return;
+	}
+
+	// Pass 2, with creases: the normal of a face at vertex i only averages
+	// faces at i within crease_angle of it. Equal normals at a vertex are
+	// shared, so smooth vertices still get a single normal
+	//
+	// The normals of vertex i are first collected in crease_normals[vertex_offsets[i]..],
+	// with corner_normals[j] the local index of the normal of corner vertex_corners[j]
+	const float cos_crease = std::cos(std::max(0.0f, crease_angle) * 3.141592653f / 180.0f);
+	std::vector<vec3f> crease_normals(vertex_corners.size());
+	std::vector<unsigned> corner_normals(vertex_corners.size());
+	std::vector<unsigned> normal_offsets(v.size() + 1, 0);
+
+	parallel_ranges(v.size(), nbr_threads, [&](unsigned, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const unsigned first = vertex_offsets[i], last = vertex_offsets[i + 1];
+				unsigned count = 0;
+
+				for (unsigned j = first; j < last; j++)
+				{
+					const vec3f& nf = face_normals[vertex_corners[j] / 4];
+					vec3f n = vec3f_zero;
+					for (unsigned k = first; k < last; k++)
+					{
+						const unsigned corner = vertex_corners[k];
+						if (k == j || dot(nf, face_normals[corner / 4]) >= cos_crease)
+							n += face_normals[corner / 4] * corner_weights[corner];
+					}
+					n = safe_normalize(n);
+
+					unsigned local = 0;
+					while (local < count && !(crease_normals[first + local] == n))
+						local++;
+					if (local == count)
+						crease_normals[first + count++] = n;
+					corner_normals[j] = local;
+				}
+				normal_offsets[i + 1] = count;
+			}
+		});
 
-	// average binned normals and add to array
 	for (size_t i = 0; i < v.size(); i++)
-	{
-		vec3f n = vec3f_zero;
-		for (size_t j = 0; j < v_bin[i].size(); j++)
+		normal_offsets[i + 1] += normal_offsets[i];
+
+	vn.resize(normal_offsets.back());
+	parallel_ranges(v.size(), nbr_threads, [&](unsigned, size_t begin, size_t end)
 		{
-			n += v_bin[i][j];
-		}
-		n = linalg::normalize(n);
+			for (size_t i = begin; i < end; i++)
+			{
+				const unsigned first = vertex_offsets[i];
+				std::copy(
+					crease_normals.begin() + first,
+					crease_normals.begin() + first + (normal_offsets[i + 1] - normal_offsets[i]),
+					vn.begin() + normal_offsets[i]);
 
-		vn.push_back(n);
-	}
+				for (unsigned j = first; j < vertex_offsets[i + 1]; j++)
+				{
+					const unsigned corner = vertex_corners[j];
+					normal_face_t& face = faces[corner / 4];
+					face.vi[face.nbr_corners + corner % 4] = (int)(normal_offsets[i] + corner_normals[j]);
+				}
+			}
+		});
+}
+
+//
+// Find the image file in the remainder of a map_* line
+//
+static std::string parse_map_filename(
+	const char* p, 
+	const char* eol, 
+	const Material& mtl, 
+	const char* keyword)
+{
+	while (eol > p && is_blank(eol[-1])) eol--;
 
-	delete[] v_bin;
+	std::string mapfile;
+	if (!find_filename_from_suffixes(std::string(p, eol), ALLOWED_TEXTURE_SUFFIXES, mapfile))
+		throw std::runtime_error(std::string("Error: no allowed format found for '") + keyword + "' in material " + mtl.name);
+	return mapfile;
 }
 
 void OBJLoader::LoadMaterials(
@@ -79,76 +518,64 @@ void OBJLoader::LoadMaterials(
 {
     std::string fullpath = path+filename;
     
-    std::ifstream in(fullpath.c_str());
-    if (!in)
+    MappedFile in;
+    if (!in.Open(fullpath))
         throw std::runtime_error(std::string("Failed to open ") + fullpath);
     std::cout << "Opened " << fullpath << "\n";
+    material_files.push_back(fullpath);
     
-    std::string line;
     Material *current_mtl = NULL;
     
-    while (getline(in, line, '\n'))
+    for (const char* line = in.Data(), *file_end = in.End(); line < file_end; )
     {
-		const int MaxChars = 1024;
-		char str0[MaxChars] = { 0 }; // , str1[MaxChars];
+        const char* eol = (const char*)memchr(line, '\n', file_end - line);
+        if (!eol) eol = file_end;
+        const char* p = skip_blanks(line, eol);
+        line = eol + 1;
         float a,b,c;
         
-		lrtrim(line);
-        if (sscanf_s(line.c_str(), "newmtl %s", str0, MaxChars) == 1)
+        if (parse_keyword(p, eol, "newmtl") && p < eol)
         {
+            std::string name(p, skip_token(p, eol));
+
             // check for duplicate
-            if (mtl_hash.find(str0) != mtl_hash.end() ) printf("Warning: duplicate material '%s'\n", str0);
+            if (mtl_hash.find(name) != mtl_hash.end() ) printf("Warning: duplicate material '%s'\n", name.c_str());
             
-            mtl_hash[str0] = Material();
-            current_mtl = &mtl_hash[str0];
-            current_mtl->name = str0;
+            mtl_hash[name] = Material();
+            current_mtl = &mtl_hash[name];
+            current_mtl->name = name;
         }
         else if (!current_mtl)
         {
             // no parsed material so can't add any content
             continue;
         }
-        else if (sscanf_s(line.c_str(), "map_Kd %[^\n]", str0, MaxChars) == 1)
+        else if (parse_keyword(p, eol, "map_Kd") && p < eol)
         {
             // search for the image file and ignore the rest
-            std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
-                current_mtl->Kd_texture_filename = path + mapfile;
-            else
-                throw std::runtime_error(std::string("Error: no allowed format found for 'map_Kd' in material ") + current_mtl->name);
+            current_mtl->Kd_texture_filename = path + parse_map_filename(p, eol, *current_mtl, "map_Kd");
         }
-        else if (sscanf_s(line.c_str(), "map_bump %[^\n]", str0, MaxChars) == 1)
+        else if (parse_keyword(p, eol, "map_bump") && p < eol)
         {
-            // search for the image file and ignore the rest
-            std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
-                current_mtl->normal_texture_filename = path+mapfile;
-            else
-                throw std::runtime_error(std::string("Error: no allowed format found for 'map_bump' in material ") + current_mtl->name);
+            current_mtl->normal_texture_filename = path + parse_map_filename(p, eol, *current_mtl, "map_bump");
         }
-        else if (sscanf_s(line.c_str(), "bump %[^\n]", str0, MaxChars) == 1)
+        else if (parse_keyword(p, eol, "bump") && p < eol)
         {
-            // search for the image file and ignore the rest
-            std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
-                current_mtl->normal_texture_filename = path+mapfile;
-            else
-                throw std::runtime_error(std::string("Error: no allowed format found for 'bump' in material ") + current_mtl->name);
+            current_mtl->normal_texture_filename = path + parse_map_filename(p, eol, *current_mtl, "bump");
         }
-        else if (sscanf_s(line.c_str(), "Ka %f %f %f", &a, &b, &c) == 3)
+        else if (parse_keyword(p, eol, "Ka") && parse_float(p, eol, a) && parse_float(p, eol, b) && parse_float(p, eol, c))
         {
             current_mtl->Ka = vec3f(a, b, c);
         }
-        else if (sscanf_s(line.c_str(), "Kd %f %f %f", &a, &b, &c) == 3)
+        else if (parse_keyword(p, eol, "Kd") && parse_float(p, eol, a) && parse_float(p, eol, b) && parse_float(p, eol, c))
         {
             current_mtl->Kd = vec3f(a, b, c);
         }
-        else if (sscanf_s(line.c_str(), "Ks %f %f %f", &a, &b, &c) == 3)
+        else if (parse_keyword(p, eol, "Ks") && parse_float(p, eol, a) && parse_float(p, eol, b) && parse_float(p, eol, c))
         {
             current_mtl->Ks = vec3f(a, b, c);
         }
     }
-    in.close();
 }
 
 void OBJLoader::Load(
@@ -158,9 +585,11 @@ void OBJLoader::Load(
 {
 	std::string parentdir = get_parentdir(filename);
 
-	std::ifstream in(filename.c_str());
-	if (!in) throw std::runtime_error(std::string("Failed to open ") + filename);
-	std::cout << "Opened " << filename << "\n";
+	// the file is walked in place, either through a memory mapping
+	// or, if that is not possible, a single read into one buffer
+	MappedFile in;
+	if (!in.Open(filename)) throw std::runtime_error(std::string("Failed to open ") + filename);
+	std::cout << "Opened " << filename << (in.IsMapped() ? " (mapped)" : "") << "\n";
 
 	// raw data from obj
 	std::vector<vec3f> file_vertices, file_normals;
@@ -168,152 +597,96 @@ void OBJLoader::Load(
 	std::vector<unwelded_drawcall_t> file_drawcalls;
 	MaterialHash file_materials;
 
+	auto parse_start = std::chrono::high_resolution_clock::now();
+
+	// Split the file into chunks, snapped to the start of a line, 
+	// and parse them in parallel
+	const size_t MinChunkSize = 1 << 20;
+	const unsigned nbr_chunks = parse_chunks ? parse_chunks : parallel_thread_count(in.Size(), MinChunkSize, max_threads);
+
+	std::vector<const char*> chunk_bounds(nbr_chunks + 1);
+	chunk_bounds[0] = in.Data();
+	chunk_bounds[nbr_chunks] = in.End();
+	for (unsigned i = 1; i < nbr_chunks; i++)
+	{
+		const char* p = std::max(in.Data() + in.Size() * i / nbr_chunks, chunk_bounds[i - 1]);
+		const char* eol = (const char*)memchr(p, '\n', in.End() - p);
+		chunk_bounds[i] = eol ? eol + 1 : in.End();
+	}
+
+	std::vector<obj_chunk_t> chunks(nbr_chunks);
+	parallel_tasks(nbr_chunks, [&](unsigned i) 
+		{
+			ParseChunk(chunk_bounds[i], chunk_bounds[i + 1], triangulate, chunks[i]);
+		});
+
+	// Array offsets of each chunk: prefix sums of the chunk sizes
+	std::vector<int3> chunk_bases(nbr_chunks);
+	int3 base = { 0, 0, 0 };
+	for (unsigned i = 0; i < nbr_chunks; i++)
+	{
+		chunk_bases[i] = base;
+		base.x += (int)chunks[i].vertices.size();
+		base.y += (int)chunks[i].normals.size();
+		base.z += (int)chunks[i].texcoords.size();
+	}
+
+	parallel_tasks(nbr_chunks, [&](unsigned i)
+		{
+			if (chunks[i].has_relative_indices)
+				RebaseChunkIndices(chunks[i], chunk_bases[i].x, chunk_bases[i].y, chunk_bases[i].z);
+		});
+
+	// Stitch the chunks together in file order. This replays the state that 
+	// carries over between chunks, so the result does not depend on the chunk count
 	std::string current_group_name;
 	unwelded_drawcall_t default_drawcall;
-	unwelded_drawcall_t* current_drawcall = &default_drawcall;
+	int current_drawcall = -1; // index in file_drawcalls, or -1 for the default drawcall
 	int last_ofs = 0; bool face_section = false; // info for skin weight mapping
 
-	std::string line;
-	while (getline(in, line))
+	for (unsigned i = 0; i < nbr_chunks; i++)
 	{
-		const int MaxChars = 1024;
-		float x, y, z;
-		int a[3], b[3], c[3], d[3];
-		char str[MaxChars];
+		obj_chunk_t& chunk = chunks[i];
 
-		// material file
-		//
-		if (sscanf_s(line.c_str(), "mtllib %s", str, MaxChars) == 1)
-		{
-			LoadMaterials(parentdir, str, file_materials);
-		}
-		// active material
-		//
-		else if (sscanf_s(line.c_str(), "usemtl %s", str, MaxChars) == 1)
-		{
-			unwelded_drawcall_t udc;
-			udc.mtl_name = str;
-			udc.group_name = current_group_name;
-			udc.v_ofs = last_ofs; face_section = true; // skinning: set current vertex offset and mark beginning of a face-section
-			file_drawcalls.push_back(udc);
-			current_drawcall = &file_drawcalls.back();
-		}
-		else if (sscanf_s(line.c_str(), "g %s", str, MaxChars) == 1)
-		{
-			current_group_name = str;
-		}
-		// 3D vertex
-		//
-		else if (sscanf_s(line.c_str(), "v %f %f %f", &x, &y, &z) == 3)
-		{
-			// update vertex offset and mark end to a face section
-			if (face_section) {
-				last_ofs = (int)file_vertices.size();
-				face_section = false;
-			}
+		for (auto& mtllib : chunk.mtllibs)
+			LoadMaterials(parentdir, mtllib, file_materials);
 
-			file_vertices.push_back(vec3f(x, y, z));
-		}
-		// 2D vertex
-		//
-		else if (sscanf_s(line.c_str(), "v %f %f", &x, &y) == 2)
-		{
-			file_vertices.push_back(vec3f(x, y, 0.0f));
-		}
-		// 3D texel (not supported: ignore last component)
-		//
-		else if (sscanf_s(line.c_str(), "vt %f %f %f", &x, &y, &z) == 3)
-		{
-			file_texcoords.push_back(vec2f(x, y));
-		}
-		// 2D texel
-		//
-		else if (sscanf_s(line.c_str(), "vt %f %f", &x, &y) == 2)
-		{
-			file_texcoords.push_back(vec2f(x, y));
-		}
-		// normal
-		//
-		else if (sscanf_s(line.c_str(), "vn %f %f %f", &x, &y, &z) == 3)
-		{
-			file_normals.push_back(vec3f(x, y, z));
-		}
-		// face: 4x vertex
-		//
-		else if (sscanf_s(line.c_str(), "f %d %d %d %d", &a[0], &b[0], &c[0], &d[0]) == 4)
-		{
-			if (triangulate) {
-				current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, -1, -1, -1, -1, -1, -1 });
-				current_drawcall->tris.push_back({ a[0] - 1, c[0] - 1, d[0] - 1, -1, -1, -1, -1, -1, -1 });
-			}
-			else
-				current_drawcall->quads.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, d[0] - 1, -1, -1, -1, -1, -1, -1, -1, -1 });
-		}
-		// face: 3x vertex
-		//
-		else if (sscanf_s(line.c_str(), "f %d %d %d", &a[0], &b[0], &c[0]) == 3)
-		{
-			current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, -1, -1, -1, -1, -1, -1 });
-		}
-		// face: 4x vertex/texel (triangulate)
-		//
-		else if (sscanf_s(line.c_str(), "f %d/%d %d/%d %d/%d %d/%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1], &d[0], &d[1]) == 8)
-		{
-			if (triangulate) {
-				current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, -1, -1, -1, a[1] - 1, b[1] - 1, c[1] - 1 });
-				current_drawcall->tris.push_back({ a[0] - 1, c[0] - 1, d[0] - 1, -1, -1, -1, a[1] - 1, c[1] - 1, d[1] - 1 });
-			}
-			else
-				current_drawcall->quads.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, d[0] - 1, -1, -1, -1, -1, a[1] - 1, b[1] - 1, c[1] - 1, d[1] - 1 });
-		}
-		// face: 3x vertex/texel
-		//
-		else if (sscanf_s(line.c_str(), "f %d/%d %d/%d %d/%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1]) == 6)
-		{
-			current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, -1, -1, -1, a[1] - 1, b[1] - 1, c[1] - 1 });
-		}
-		// face: 4x vertex//normal (triangulate)
-		//
-		else if (sscanf_s(line.c_str(), "f %d//%d %d//%d %d//%d %d//%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1], &d[0], &d[1]) == 8)
-		{
-			if (triangulate) {
-				current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, a[1] - 1, b[1] - 1, c[1] - 1, -1, -1, -1 });
-				current_drawcall->tris.push_back({ a[0] - 1, c[0] - 1, d[0] - 1, a[1] - 1, c[1] - 1, d[1] - 1, -1, -1, -1 });
-			}
-			else
-				current_drawcall->quads.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, d[0] - 1, a[2] - 1, b[2] - 1, c[2] - 1, d[2] - 1, -1, -1, -1, -1 });
-		}
-		// face: 3x vertex//normal
-		//
-		else if (sscanf_s(line.c_str(), "f %d//%d %d//%d %d//%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1]) == 6)
-		{
-			current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, a[1] - 1, b[1] - 1, c[1] - 1, -1, -1, -1 });
-		}
-		// face: 4x vertex/texel/normal (triangulate)
-		//
-		else if (sscanf_s(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", &a[0], &a[1], &a[2], &b[0], &b[1], &b[2], &c[0], &c[1], &c[2], &d[0], &d[1], &d[2]) == 12)
-		{
-			if (triangulate) {
-				current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, a[2] - 1, b[2] - 1, c[2] - 1, a[1] - 1, b[1] - 1, c[1] - 1 });
-				current_drawcall->tris.push_back({ a[0] - 1, c[0] - 1, d[0] - 1, a[2] - 1, c[2] - 1, d[2] - 1, a[1] - 1, c[1] - 1, d[1] - 1 });
-			}
-			else
-				current_drawcall->quads.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, d[0] - 1, a[2] - 1, b[2] - 1, c[2] - 1, d[2] - 1, a[1] - 1, b[1] - 1, c[1] - 1, d[1] - 1 });
-		}
-		// face: 3x vertex/texel/normal
-		//
-		else if (sscanf_s(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &a[0], &a[1], &a[2], &b[0], &b[1], &b[2], &c[0], &c[1], &c[2]) == 9)
-		{
-			current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, a[2] - 1, b[2] - 1, c[2] - 1, a[1] - 1, b[1] - 1, c[1] - 1 });
-		}
-		// unknown obj syntax
-		//
-		else
-		{
+		// skinning offset in effect at the first usemtl of the chunk
+		const int incoming_ofs = (face_section && chunk.leading_vertices) ? chunk_bases[i].x : last_ofs;
+
+		unwelded_drawcall_t& leading_target = current_drawcall < 0 ? default_drawcall : file_drawcalls[current_drawcall];
+		append_vector(leading_target.tris, chunk.leading.tris);
+		append_vector(leading_target.quads, chunk.leading.quads);
 
+		for (size_t j = 0; j < chunk.drawcalls.size(); j++)
+		{
+			unwelded_drawcall_t& dc = chunk.drawcalls[j];
+			if (j < chunk.drawcalls_with_incoming_group)
+				dc.group_name = current_group_name;
+			dc.v_ofs = dc.v_ofs < 0 ? incoming_ofs : chunk_bases[i].x + dc.v_ofs;
+			file_drawcalls.push_back(std::move(dc));
 		}
+		if (chunk.drawcalls.size())
+			current_drawcall = (int)file_drawcalls.size() - 1;
+
+		if (chunk.has_group)
+			current_group_name = chunk.group_name;
+		last_ofs = chunk.last_ofs < 0 ? incoming_ofs : chunk_bases[i].x + chunk.last_ofs;
+		if (chunk.face_section != -1)
+			face_section = chunk.face_section == 1;
+
+		append_vector(file_vertices, chunk.vertices);
+		append_vector(file_normals, chunk.normals);
+		append_vector(file_texcoords, chunk.texcoords);
+		chunk = obj_chunk_t();
 	}
-	in.close();
+
+	parse_secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - parse_start).count();
+	parsed_bytes = in.Size();
+	double parse_mb = in.Size() / (1024.0 * 1024.0);
+	printf("Parsed %.1f MB in %.3f s (%.1f MB/s, %u threads)\n", 
+		parse_mb, parse_secs, parse_secs > 0 ? parse_mb / parse_secs : 0.0, nbr_chunks);
+	in.Close();
 
 	// use defualt drawcall if no instance of usemtl
 	if (!file_drawcalls.size())
@@ -329,7 +702,8 @@ void OBJLoader::Load(
 	// auto-generate normals
 	if (!has_normals && auto_generate_normals)
 	{
-		GenerateNormals(file_vertices, file_normals, file_drawcalls);
+		GenerateNormals(file_vertices, file_normals, file_drawcalls,
+			area_weighted_normals, crease_angle, max_threads);
 		has_normals = true;
 		printf("Auto-generated %d normals\n", (int)file_normals.size());
 	}
@@ -337,14 +711,27 @@ void OBJLoader::Load(
 
 #if 1
 	printf("Welding vertex array...");
+	auto weld_start = std::chrono::high_resolution_clock::now();
 
 	std::unordered_map<std::string, unsigned> mtl_to_index_hash;
 
-	// hash function for int3
-	struct int3_hashfunction {
-		std::size_t operator () (const int3& i3) const {
-			return i3.x;
+	// one welder for all drawcalls, vertices are not shared between drawcalls
+	vertex_welder_t welder;
+
+	// welded index of a face corner, adding a new vertex if the
+	// index-combo has not been seen before in this drawcall
+	auto weld_corner = [&](int pos, int normal, int texcoord)
+	{
+		unsigned index;
+		if (welder.Insert({ pos, normal, texcoord }, (unsigned)vertices.size(), index))
+		{
+			Vertex v;
+			v.Pos = file_vertices[pos];
+			if (normal > -1) v.Normal = file_normals[normal];
+			if (texcoord > -1) v.TexCoord = file_texcoords[texcoord];
+			vertices.push_back(v);
 		}
+		return index;
 	};
 
 	for (auto &dc : file_drawcalls)
@@ -352,7 +739,9 @@ void OBJLoader::Load(
 		Drawcall wdc;
 		wdc.group_name = dc.group_name;
 
-		std::unordered_map<int3, unsigned, int3_hashfunction> index3_to_index_hash;
+		// a closed triangle mesh has about one vertex per two triangles, i.e.
+		// per six corners, more with seams. The welder grows if needed
+		welder.Clear((dc.tris.size() * 3 + dc.quads.size() * 4) / 6);
 
 		// material
 		//
@@ -382,75 +771,32 @@ void OBJLoader::Load(
 
 		// weld vertices from triangles
 		//
+		wdc.tris.reserve(dc.tris.size());
 		for (auto &tri : dc.tris)
 		{
 			Triangle wtri;
-
 			for (int i = 0; i < 3; i++)
-			{
-				int3 i3 = { tri.vi[0 + i], tri.vi[3 + i], tri.vi[6 + i] };
-
-				auto s = index3_to_index_hash.find(i3);
-				if (s == index3_to_index_hash.end())
-				{
-					// index-combo does not exist, create it
-					Vertex v;
-					v.Pos = file_vertices[i3.x];
-					if (i3.y > -1) v.Normal = file_normals[i3.y];
-					if (i3.z > -1) v.TexCoord = file_texcoords[i3.z];
-
-					wtri.vi[i] = (unsigned)vertices.size();
-					index3_to_index_hash[i3] = (unsigned)(vertices.size());
-
-					vertices.push_back(v);
-				}
-				else
-				{
-					// use existing index-combo
-					wtri.vi[i] = s->second;
-				}
-			}
+				wtri.vi[i] = weld_corner(tri.vi[0 + i], tri.vi[3 + i], tri.vi[6 + i]);
 			wdc.tris.push_back(wtri);
 		}
 
 #if 1
 		// weld vertices from quads
 		//
+		wdc.quads.reserve(dc.quads.size());
 		for (auto &quad : dc.quads)
 		{
 			Quad wquad;
-
 			for (int i = 0; i < 4; i++)
-			{
-				int3 i3 = { quad.vi[0 + i], quad.vi[3 + i], quad.vi[6 + i] };
-
-				auto s = index3_to_index_hash.find(i3);
-				if (s == index3_to_index_hash.end())
-				{
-					// index-combo does not exist, create it
-					Vertex v;
-					v.Pos = file_vertices[i3.x];
-					if (i3.y > -1) v.Normal = file_normals[i3.y];
-					if (i3.z > -1) v.TexCoord = file_texcoords[i3.z];
-
-					wquad.vi[i] = (unsigned)vertices.size();
-					index3_to_index_hash[i3] = (unsigned)(vertices.size());
-
-					vertices.push_back(v);
-				}
-				else
-				{
-					// use existing index-combo
-					wquad.vi[i] = s->second;
-				}
-			}
+				wquad.vi[i] = weld_corner(quad.vi[0 + i], quad.vi[4 + i], quad.vi[8 + i]);
 			wdc.quads.push_back(wquad);
 		}
 #endif
 
 		drawcalls.push_back(wdc);
 	}
-	printf("Done\n");
+	weld_secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - weld_start).count();
+	printf("Done (%.3f s)\n", weld_secs);
 
 	// Produce and print some stats
 	//
@@ -42,12 +42,37 @@ public:
         bool auto_generate_normals = true,
         bool triangulate = true);
 
+    // Upper bound on the number of parsing and normal generation threads,
+    // 0 = all hardware threads
+    unsigned max_threads = 0;
+
+    // Number of chunks the file is split into and parsed in, one thread each,
+    // 0 = one per thread allowed by max_threads and the file size. The loaded
+    // data is the same for any number of chunks
+    unsigned parse_chunks = 0;
+
+    // Auto-generated normals weight face normals by face area rather than by corner angle
+    bool area_weighted_normals = false;
+
+    // Auto-generated normals do not smooth across edges sharper than this angle (degrees),
+    // 180 = smooth everywhere
+    float crease_angle = 180.0f;
+
     bool has_normals = false;
     bool has_texcoords = false;
 
+    // Size of the OBJ file, and seconds spent parsing (including MTL files)
+    // and welding it, in the last Load
+    size_t parsed_bytes = 0;
+    double parse_secs = 0;
+    double weld_secs = 0;
+
     std::vector<Vertex> vertices;
     std::vector<Drawcall> drawcalls;
     std::vector<Material> materials;
+
+    // Paths of the MTL files that were read
+    std::vector<std::string> material_files;
 };
 
 #endif
@@ -0,0 +1,68 @@
+//
+//  Parallel.h
+//
+//  Minimal fork-join helpers on top of std::thread
+//
+
+#pragma once
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+//
+// Number of threads to use for n items, such that every thread
+// gets at least min_items_per_thread. max_threads = 0 means no limit
+// other than the hardware concurrency
+//
+inline unsigned parallel_thread_count(
+	size_t n,
+	size_t min_items_per_thread,
+	unsigned max_threads = 0)
+{
+	unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+	if (max_threads) hw = std::min(hw, max_threads);
+
+	size_t by_work = min_items_per_thread ? n / min_items_per_thread : n;
+	return (unsigned)std::max<size_t>(1, std::min<size_t>(hw, by_work));
+}
+
+//
+// Run fn(i) for i in [0, count), each on its own thread
+// The calling thread runs fn(0) and joins the others
+//
+template<class F>
+void parallel_tasks(unsigned count, F&& fn)
+{
+	if (count == 0) return;
+
+	std::vector<std::thread> workers;
+	workers.reserve(count - 1);
+	for (unsigned i = 1; i < count; i++)
+		workers.emplace_back([&fn, i]() { fn(i); });
+
+	fn(0u);
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+//
+// Split [0, n) into num_threads contiguous ranges and run
+// fn(thread_index, begin, end) for each range in parallel
+//
+template<class F>
+void parallel_ranges(size_t n, unsigned num_threads, F&& fn)
+{
+	num_threads = (unsigned)std::max<size_t>(1, std::min<size_t>(num_threads, n));
+	parallel_tasks(num_threads, [&](unsigned t)
+		{
+			size_t begin = n * t / num_threads;
+			size_t end = n * (t + 1) / num_threads;
+			fn(t, begin, end);
+		});
+}
+
+#endif
@@ -0,0 +1,92 @@
+//
+//  RenderQueue.cpp
+//
+
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+// Queues smaller than this are sorted faster by comparison
+static const size_t RadixSortMinSize = 1024;
+
+uint64_t RenderQueue::MakeKey(
+	unsigned pass,
+	unsigned shader,
+	unsigned texture_set,
+	unsigned material,
+	float depth,
+	bool back_to_front)
+{
+	// The bits of non-negative floats order like the floats, so the
+	// top bits of the float are a monotonic quantization of the depth
+	uint32_t depth_bits = 0;
+	if (depth > 0)
+		std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+	uint64_t depth_key = depth_bits >> (32 - DepthBits);
+	if (back_to_front)
+		depth_key = ~depth_key & ((1u << DepthBits) - 1);
+
+	return (uint64_t)(pass & ((1u << PassBits) - 1)) << PassShift |
+		(uint64_t)(shader & ((1u << ShaderBits) - 1)) << ShaderShift |
+		(uint64_t)(texture_set & ((1u << TextureSetBits) - 1)) << TextureSetShift |
+		(uint64_t)(material & ((1u << MaterialBits) - 1)) << MaterialShift |
+		depth_key << DepthShift;
+}
+
+unsigned RenderQueue::KeyChanges(uint64_t previous, uint64_t key)
+{
+	const uint64_t diff = previous ^ key;
+	unsigned changes = 0;
+	if (Field(diff, PassShift, PassBits)) changes |= PassChanged;
+	if (Field(diff, ShaderShift, ShaderBits)) changes |= ShaderChanged;
+	if (Field(diff, TextureSetShift, TextureSetBits)) changes |= TextureSetChanged;
+	if (Field(diff, MaterialShift, MaterialBits)) changes |= MaterialChanged;
+	return changes;
+}
+
+void RenderQueue::Sort()
+{
+	const size_t n = packets.size();
+	sort_passes = 0;
+	if (n < 2)
+		return;
+
+	if (n < RadixSortMinSize)
+	{
+		std::stable_sort(packets.begin(), packets.end(),
+			[](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+		return;
+	}
+
+	// Histograms of all 8 key bytes in one pass
+	static const unsigned Digits = sizeof(uint64_t);
+	uint32_t counts[Digits * 256] = {};
+	for (const DrawPacket& packet : packets)
+	{
+		for (unsigned d = 0; d < Digits; d++)
+			counts[d * 256 + ((packet.key >> (d * 8)) & 0xff)]++;
+	}
+
+	// One stable counting pass per byte, least significant first. Bytes
+	// that are the same in all keys, such as unused ids, are skipped
+	sorted.resize(n);
+	for (unsigned d = 0; d < Digits; d++)
+	{
+		uint32_t* count = &counts[d * 256];
+		if (count[(packets[0].key >> (d * 8)) & 0xff] == n)
+			continue;
+
+		uint32_t offset = 0;
+		for (unsigned b = 0; b < 256; b++)
+		{
+			const uint32_t c = count[b];
+			count[b] = offset;
+			offset += c;
+		}
+
+		for (const DrawPacket& packet : packets)
+			sorted[count[(packet.key >> (d * 8)) & 0xff]++] = packet;
+		packets.swap(sorted);
+		sort_passes++;
+	}
+}
@@ -0,0 +1,137 @@
+//
+//  RenderQueue.h
+//
+//  Draw packets sorted by state, independent of the graphics API
+//
+
+#pragma once
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//
+// One draw: its sort key, and which drawcall of which object to draw.
+// object and drawcall are indices into the caller's own data
+//
+struct DrawPacket
+{
+	uint64_t key;
+	unsigned object;
+	unsigned drawcall;
+};
+
+//
+// Render queue
+//
+// Draws are pushed in any order with a 64-bit key holding, from the most
+// significant bits down, the pass, shader, texture set, material and depth
+// of the draw. Sorting the keys groups draws that share state, so that
+// state is set once per group when the sorted draws are submitted, and
+// orders draws with the same state front to back (back to front for
+// translucent passes, see MakeKey). Keys are sorted with an LSD radix sort.
+//
+class RenderQueue
+{
+public:
+	// Sort key fields, most significant first
+	static const unsigned PassBits = 2;
+	static const unsigned ShaderBits = 6;
+	static const unsigned TextureSetBits = 16;
+	static const unsigned MaterialBits = 16;
+	static const unsigned DepthBits = 24;
+
+	static const unsigned DepthShift = 0;
+	static const unsigned MaterialShift = DepthShift + DepthBits;
+	static const unsigned TextureSetShift = MaterialShift + MaterialBits;
+	static const unsigned ShaderShift = TextureSetShift + TextureSetBits;
+	static const unsigned PassShift = ShaderShift + ShaderBits;
+
+	//
+	// Fields that differ between a packet and the one before it, see Submit
+	//
+	enum Changes
+	{
+		PassChanged = 1,
+		ShaderChanged = 2,
+		TextureSetChanged = 4,
+		MaterialChanged = 8,
+		AllChanged = PassChanged | ShaderChanged | TextureSetChanged | MaterialChanged
+	};
+
+	//
+	// Sort key of a draw. pass, shader, texture_set and material are
+	// ids that wrap around at their field sizes. depth is the view depth,
+	// clamped to >= 0, which orders draws front to back, or back to front
+	// if back_to_front is set
+	//
+	static uint64_t MakeKey(
+		unsigned pass,
+		unsigned shader,
+		unsigned texture_set,
+		unsigned material,
+		float depth,
+		bool back_to_front = false);
+
+	static unsigned KeyPass(uint64_t key) { return Field(key, PassShift, PassBits); }
+	static unsigned KeyShader(uint64_t key) { return Field(key, ShaderShift, ShaderBits); }
+	static unsigned KeyTextureSet(uint64_t key) { return Field(key, TextureSetShift, TextureSetBits); }
+	static unsigned KeyMaterial(uint64_t key) { return Field(key, MaterialShift, MaterialBits); }
+
+	//
+	// Changes between the keys of two consecutive draws
+	//
+	static unsigned KeyChanges(uint64_t previous, uint64_t key);
+
+	void Push(uint64_t key, unsigned object, unsigned drawcall)
+	{
+		packets.push_back({ key, object, drawcall });
+	}
+
+	//
+	// Sort the packets by key, stable
+	//
+	void Sort();
+
+	//
+	// Counting passes of the last Sort, one per key byte that is not the same
+	// in all keys. 0 if the queue was sorted by comparison
+	//
+	unsigned SortPasses() const { return sort_passes; }
+
+	//
+	// Call draw(packet, changes) for each packet in order, where changes
+	// are the Changes from the previous packet (AllChanged for the first)
+	//
+	template<class F>
+	void Submit(F&& draw) const
+	{
+		uint64_t previous = 0;
+		for (size_t i = 0; i < packets.size(); i++)
+		{
+			const DrawPacket& packet = packets[i];
+			draw(packet, i ? KeyChanges(previous, packet.key) : (unsigned)AllChanged);
+			previous = packet.key;
+		}
+	}
+
+	const std::vector<DrawPacket>& Packets() const { return packets; }
+
+	size_t Size() const { return packets.size(); }
+
+	void Clear() { packets.clear(); }
+
+private:
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> sorted;	// radix sort buffer
+	unsigned sort_passes = 0;
+
+	static unsigned Field(uint64_t key, unsigned shift, unsigned bits)
+	{
+		return (unsigned)(key >> shift) & ((1u << bits) - 1);
+	}
+};
+
+#endif
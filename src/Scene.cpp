@@ -1,5 +1,6 @@
 
 #include "Scene.h"
+#include "vec\transform.h"
 #include <cmath>
 #include <chrono>
 
@@ -9,10 +10,12 @@ vec4f light = vec4f{ 0, 50, 0, 0 };
 Scene::Scene(
 	ID3D11Device* dxdevice,
 	ID3D11DeviceContext* dxdevice_context,
+	StateCache* state_cache,
 	int window_width,
 	int window_height) :
 	dxdevice(dxdevice),
 	dxdevice_context(dxdevice_context),
+	state_cache(state_cache),
 	window_width(window_width),
 	window_height(window_height)
 { }
@@ -28,16 +31,38 @@ void Scene::WindowResize(
 OurTestScene::OurTestScene(
 	ID3D11Device* dxdevice,
 	ID3D11DeviceContext* dxdevice_context,
+	StateCache* state_cache,
 	int window_width,
 	int window_height) :
-	Scene(dxdevice, dxdevice_context, window_width, window_height)
+	Scene(dxdevice, dxdevice_context, state_cache, window_width, window_height)
 { 
 	InitTransformationBuffer();
+	// Per-object constants in a ring, if constant buffers can be bound
+	// with offsets (through the Direct3D 11.1 context) and mapped without
+	// overwrite
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (state_cache->GetContext1() &&
+		SUCCEEDED(dxdevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer)
+		InitObjectRing(256);
+	InitInstancingBuffer();
 	// + init other CBuffers
 	InitLightAndCameraBuffer();
-	InitMaterialBuffer();
 	InitSamplerAniso();
 
+	// Vertex shader of instanced draws, for the vertex layout of Main
+#ifdef VERTEX_FORMAT_PACKED
+	const std::vector<D3D11_INPUT_ELEMENT_DESC> instanced_layout = InstancedLayout(PackedVertexLayout, ARRAYSIZE(PackedVertexLayout));
+	const char* instanced_shader_path = "shaders/vertex_shader_instanced_packed.hlsl";
+#else
+	const std::vector<D3D11_INPUT_ELEMENT_DESC> instanced_layout = InstancedLayout(VertexLayout, ARRAYSIZE(VertexLayout));
+	const char* instanced_shader_path = "shaders/vertex_shader_instanced.hlsl";
+#endif
+	if (FAILED(create_shader(dxdevice, instanced_shader_path, "VS_main", SHADER_VERTEX, instanced_layout.data(), (uint32_t)instanced_layout.size(), &instanced_vertex_shader)))
+	{
+		__debugbreak();
+	}
+
 	D3D11_SAMPLER_DESC samplerdesc =
 	{
 		D3D11_FILTER_MIN_MAG_MIP_POINT,
@@ -98,17 +123,44 @@ void OurTestScene::Init()
 	mirror.cube_filenames[5] = "assets/cubemaps/Skybox/Skybox-negz.png";
 
 	// Create objects
-	quad = new QuadModel(dxdevice, dxdevice_context);
-	quad->SetMaterial(blue);
-	cube = new Cube(dxdevice, dxdevice_context);	
-	cube->SetMaterial(blue);
-	cube1 = new Cube(dxdevice, dxdevice_context);
-	cube1->SetMaterial(red);
-	cube2 = new Cube(dxdevice, dxdevice_context);
-	cube2->cubeBool = true;
-	cube2->SetMaterial(mirror);
-	sponza = new OBJModel("assets/crytek-sponza/sponza.obj", dxdevice, dxdevice_context);
-	spaceship = new OBJModel("assets/hand/hand.obj", dxdevice, dxdevice_context);
+	std::cout << "Loading cube textures..." << std::endl;
+	cube_materials = { blue, red, mirror };
+	Model::LoadMaterial(dxdevice, cube_materials[0], false);
+	Model::LoadMaterial(dxdevice, cube_materials[1], false);
+	Model::LoadMaterial(dxdevice, cube_materials[2], true);
+	quad = new QuadModel(dxdevice, dxdevice_context, &meshes);
+	quad->ShareMaterial(&cube_materials[0]);	// Wood, as the first cube
+	cube = new Cube(dxdevice, dxdevice_context, &meshes);
+	sponza = new OBJModel("assets/crytek-sponza/sponza.obj", dxdevice, dxdevice_context, &meshes);
+	spaceship = new OBJModel("assets/hand/hand.obj", dxdevice, dxdevice_context, &meshes);
+
+	// Model-to-world transformations, T*R*S per node and parent * child down
+	// the hierarchy. Rotations and the orbit of cube1 are animated in Update
+	node_quad = transforms.AddNode(TransformHierarchy::NoParent,
+		{ 0, 0, 0 }, quatf(), { 1.5f, 1.5f, 1.5f });			// Scale uniformly to 150%
+	node_cube_pivot = transforms.AddNode(TransformHierarchy::NoParent,
+		{ 5, 0, -20 }, quatf(), { 2, 2, 2 });
+	node_cube = transforms.AddNode(node_cube_pivot);
+	node_cube1 = transforms.AddNode(node_cube_pivot,
+		{ 1.5f, 0, 0 }, quatf(), { 0.5f, 0.5f, 0.5f });
+	node_cube2 = transforms.AddNode(TransformHierarchy::NoParent,
+		{ 0, 0, 0 }, quatf(), { 700, 700, 700 });
+	node_sponza = transforms.AddNode(TransformHierarchy::NoParent,
+		{ 0, -5, 0 },											// Move down 5 units
+		quatf::rotation(fPI / 2, vec3f(0, 1, 0)));				// Rotate pi/2 radians (90 degrees) around y
+	node_spaceship = transforms.AddNode(TransformHierarchy::NoParent,
+		{ -7, 0, 0 }, quatf(), { 10, 10, 10 });
+
+	// The cubes, as instances of the cube mesh. Their transformations are
+	// copied from their nodes each frame
+	cube_instances = new ModelInstances(cube);
+	for (const Material& mtl : cube_materials)
+		cube_instances->AddMaterial(&mtl);
+	cube_instances->AddInstance(transforms.GetWorldMatrix(node_cube), 0);
+	cube_instances->AddInstance(transforms.GetWorldMatrix(node_cube1), 1);
+	cube_instances->AddInstance(transforms.GetWorldMatrix(node_cube2), 2);
+
+	meshes.PrintReport();
 }
 
 //
@@ -156,49 +208,47 @@ void OurTestScene::Update(
 		camera->moveRight(camera_vel, dt);
 
 
-	// Now set/update object transformations
-	// This can be done using any sequence of transformation matrices,
-	// but the T*R*S order is most common; i.e. scale, then rotate, and then translate.
-	// If no transformation is desired, an identity matrix can be obtained 
-	// via e.g. Mquad = linalg::mat4f_identity; 
-
-	// Quad model-to-world transformation
-	Mquad = mat4f::translation(0, 0, 0) *			// No translation
-		mat4f::rotation(-angle, 0.0f, 1.0f, 0.0f) *	// Rotate continuously around the y-axis
-		mat4f::scaling(1.5, 1.5, 1.5);				// Scale uniformly to 150%
-
-	Mcube = mat4f::translation(5, 0, -20) *
-		mat4f::rotation(-angle, 0.0f, 1.0f, 0.0f) *
-		mat4f::scaling(2, 2, 2);
-	
-//	m4f MCube_T = mat4f::translation(Mcube.m14, Mcube.m24, Mcube.m34);
-	Mcube1 = Mcube.translation(5, 0, -20) * Mcube.scaling(2, 2, 2) * mat4f::translation(std::cos(angle) * 1.5, std::sin(angle) * 1.5, 0) *
-		mat4f::rotation(0.0f, 0.0f, 0.0f) *
-		mat4f::scaling(0.5, 0.5, 0.5);
+	// Now update the animated object transformations. Only these nodes,
+	// and the nodes below them, get their world matrices recomputed
+	const quatf spin = quatf::rotation(-angle, vec3f(0, 1, 0));	// Rotate continuously around the y-axis
+	transforms.SetRotation(node_quad, spin);
+	transforms.SetRotation(node_cube, spin);
+	transforms.SetTranslation(node_cube1, { std::cos(angle) * 1.5f, std::sin(angle) * 1.5f, 0 });
+	transforms.SetRotation(node_spaceship, spin);
 
-	Mcube2 =mat4f::translation(0 ,0 ,0) *
-		mat4f::rotation(0.0f, 0.0f, 0.0f) *
-		mat4f::scaling(700, 700, 700);
-
-
-	// Sponza model-to-world transformation
-	Msponza = mat4f::translation(0, -5, 0) *		 // Move down 5 units
-		mat4f::rotation(fPI / 2, 0.0f, 1.0f, 0.0f) * // Rotate pi/2 radians (90 degrees) around y
-		mat4f::scaling(1.0f);						 // The scene is quite large so scale it down to 5%
-
-	Mspaceship = mat4f::translation(-7, 0, 0) *
-		mat4f::rotation(-angle, 0.0f, 1.0f, 0.0f) *
-		mat4f::scaling(10.0f, 10.0f, 10.0f);
+	transform_updates += transforms.Update();
 
 	// Increment the rotation angle.
 	angle += angle_vel * dt;
 
 	// Print fps
 	fps_cooldown -= dt;
+	fps_frames++;
 	if (fps_cooldown < 0.0)
 	{
 		std::cout << "fps " << (int)(1.0f / dt) << std::endl;
 //		printf("fps %i\n", (int)(1.0f / dt));
+		// Camera matrix rebuilds per frame, 0 while the camera is still
+		printf("camera rebuilds/frame %.2f\n", (float)camera->get_RebuildCount() / fps_frames);
+		printf("transform updates/frame %.2f\n", (float)transform_updates / fps_frames);
+#ifdef FRUSTUM_CULLING
+		printf("culled objects %u/%u, drawcalls %u/%u, instances %u/%u\n",
+			cull_stats.objects_culled, cull_stats.objects_tested,
+			cull_stats.ranges_culled, cull_stats.ranges_tested,
+			cull_stats.instances_culled, cull_stats.instances_tested);
+#endif
+		printf("draws %u, buffer binds %u, texture binds %u, material binds %u, transformation updates %u (%u maps)\n",
+			submit_stats.draws, submit_stats.buffer_binds, submit_stats.texture_binds,
+			submit_stats.material_binds, submit_stats.transformation_updates, submit_stats.transformation_maps);
+		printf("instanced draws %u (%u instances)\n", submit_stats.instanced_draws, submit_stats.instances);
+		printf("material upload bytes saved %u\n", submit_stats.material_bytes_saved);
+		// Binding calls of the last frame, and how many the state cache passed on
+		const StateCacheStats& state_stats = state_cache->GetStats();
+		printf("binding calls %u, filtered %u, issued %u\n",
+			state_stats.requested, state_stats.filtered, state_stats.issued);
+		camera->ResetRebuildCount();
+		fps_frames = 0;
+		transform_updates = 0;
 		fps_cooldown = 2.0;
 	}
 	
@@ -219,63 +269,328 @@ void OurTestScene::Update(
 //
 void OurTestScene::Render()
 {
-	// Bind transformation_buffer to slot b0 of the VS
-	dxdevice_context->VSSetConstantBuffers(0, 1, &transformation_buffer);
-	dxdevice_context->PSSetConstantBuffers(0, 1, &lightandcamera_buffer);
-	dxdevice_context->PSSetConstantBuffers(1, 1, &mtl_buffer);
-	dxdevice_context->PSSetSamplers(0, 1, &sampler);
-	dxdevice_context->PSSetSamplers(1, 1, &samplerCube);
-	dxdevice_context->PSSetSamplers(2, 1, &samplerSpec);
+	// Bind transformation_buffer to slot b0 of the VS, unless objects
+	// bind their ranges of object_ring_buffer there
+	// (through the state cache, these are passed on only when changed)
+	if (!object_ring_buffer)
+		state_cache->VSSetConstantBuffers(0, 1, &transformation_buffer);
+	state_cache->PSSetConstantBuffers(0, 1, &lightandcamera_buffer);
+	state_cache->PSSetSamplers(0, 1, &sampler);
+	state_cache->PSSetSamplers(1, 1, &samplerCube);
+	state_cache->PSSetSamplers(2, 1, &samplerSpec);
 
 	// Obtain the matrices needed for rendering from the camera
 	Mview = camera->get_WorldToViewMatrix();
 	Mproj = camera->get_ProjectionMatrix();
 	
-	auto phongFunction = [this](vec4f Ka, vec4f Kd, vec4f Ks, float shininess) {UpdateMaterialBuffer(Ka, Kd, Ks, shininess); };
-
-	// Load matrices + the Quad's transformation to the device and render it
-	UpdateTransformationBuffer(Mquad, Mview, Mproj);
-	quad->Render(phongFunction);
-
-	UpdateTransformationBuffer(Mcube, Mview, Mproj);
-	cube->Render(phongFunction);
+	cull_stats = CullStats();
 
-	UpdateTransformationBuffer(Mcube1, Mview, Mproj);
-	cube1->Render(phongFunction);
+	// Queue the models with their transformations
+	QueueModel(quad, transforms.GetWorldMatrix(node_quad));
 
-	UpdateTransformationBuffer(Mcube2, Mview, Mproj);
-	cube2->Render(phongFunction);
+	cube_instances->SetTransform(0, transforms.GetWorldMatrix(node_cube));
+	cube_instances->SetTransform(1, transforms.GetWorldMatrix(node_cube1));
+	cube_instances->SetTransform(2, transforms.GetWorldMatrix(node_cube2));
+	QueueInstances(cube_instances);
 	
-	UpdateTransformationBuffer(Mspaceship, Mview, Mproj);
-	spaceship->Render(phongFunction);
+	QueueModel(spaceship, transforms.GetWorldMatrix(node_spaceship));
 
-	// Load matrices + Sponza's transformation to the device and render it
-	UpdateTransformationBuffer(Msponza, Mview, Mproj);
-	sponza->Render(phongFunction);
+	QueueModel(sponza, transforms.GetWorldMatrix(node_sponza));
 
+	// The mirror cube's cube map is the environment of all draws
+	state_cache->PSSetShaderResources(3, 1, &cube_materials[2].cube_texture.texture_SRV);
+
+	// Per-frame constants, before the draws that read them
 	UpdateLightAndCameraBuffer(light, camera->position.xyz0());
 
-	/*UpdateMaterialBuffer(materials[0].Ka.xyz1, materials[0].Kd, materials[0].Ks, 32);*/
+	// Load the matrices of each model to the device and render it
+	RenderQueuedModels();
 	
 }
 
+void OurTestScene::QueueModel(
+	Model* model,
+	const mat4f& ModelToWorldMatrix)
+{
+#ifdef FRUSTUM_CULLING
+	// Test the model space bounds against the frustum in model space
+	vec4f planes[FrustumPlaneCount];
+	transform_planes(ModelToWorldMatrix, camera->get_FrustumPlanes(), planes, FrustumPlaneCount);
+	if (!model->Cull(planes, cull_stats))
+		return;
+#endif
+
+	queued_models.push_back(model);
+	queued_model_to_world.push_back(ModelToWorldMatrix);
+}
+
+void OurTestScene::QueueInstances(ModelInstances* instances)
+{
+#ifdef FRUSTUM_CULLING
+	// Each instance is tested in world space
+	const vec4f* planes = camera->get_FrustumPlanes();
+#else
+	const vec4f* planes = nullptr;
+#endif
+
+	if (instances->Gather(planes, cull_stats))
+		queued_instances.push_back(instances);
+}
+
+unsigned OurTestScene::MaterialId(const Material* mtl)
+{
+	if (!mtl)
+		return 0;
+	auto it = material_ids.find(mtl);
+	if (it == material_ids.end())
+		it = material_ids.insert({ mtl, (unsigned)material_ids.size() + 1 }).first;
+	return it->second;
+}
+
+unsigned OurTestScene::TextureSetId(const Material* mtl)
+{
+	if (!mtl)
+		return 0;
+	const std::array<ID3D11ShaderResourceView*, 4> srvs =
+	{
+		mtl->diffuse_texture.texture_SRV,
+		mtl->normal_texture.texture_SRV,
+		mtl->specular_texture.texture_SRV,
+		mtl->cube_texture.texture_SRV
+	};
+	auto it = texture_set_ids.find(srvs);
+	if (it == texture_set_ids.end())
+		it = texture_set_ids.insert({ srvs, (unsigned)texture_set_ids.size() + 1 }).first;
+	return it->second;
+}
+
+void OurTestScene::RenderQueuedModels()
+{
+	// Model-to-clip and normal matrices once per object, instead of
+	// concatenating the matrices per vertex in the vertex shader
+	const size_t nbr_models = queued_models.size();
+	queued_model_to_clip.resize(nbr_models);
+	queued_normal.resize(nbr_models);
+	transform_matrices(camera->get_ViewProjectionMatrix(), queued_model_to_world.data(), queued_model_to_clip.data(), nbr_models);
+	normal_matrices(queued_model_to_world.data(), queued_normal.data(), nbr_models);
+
+	submit_stats = SubmitStats();
+
+	// All per-object matrices with one map, if the ring is used
+	size_t ring_offset = 0;
+	if (object_ring_buffer && nbr_models)
+	{
+		ring_offset = WriteObjectRing();
+		submit_stats.transformation_maps++;
+	}
+
+	// All visible instances with one map, and the world-to-clip matrix
+	// they share
+	if (!queued_instances.empty())
+	{
+		WriteInstances();
+		UpdateInstancingBuffer(camera->get_ViewProjectionMatrix());
+	}
+
+	// A draw packet per visible drawcall, with its depth taken as the
+	// distance from the near plane to the center of its bounds
+	const vec4f& near_plane = camera->get_FrustumPlanes()[4];
+	for (size_t i = 0; i < nbr_models; i++)
+	{
+		const Model* model = queued_models[i];
+		for (unsigned d = 0; d < model->DrawcallCount(); d++)
+		{
+			if (!model->DrawcallVisible(d))
+				continue;
+
+			const Material* mtl = model->DrawcallMaterial(d);
+			const aabb3f& box = model->DrawcallBounds(d);
+			const vec4f center = queued_model_to_world[i] * ((box.min + box.max) * 0.5f).xyz1();
+
+			render_queue.Push(
+				RenderQueue::MakeKey(0, DefaultShader, TextureSetId(mtl), MaterialId(mtl), dot(near_plane, center)),
+				(unsigned)i,
+				d);
+		}
+	}
+
+	// A draw packet per drawcall of each batch. Instances of a batch are
+	// spread out, so these are not ordered by depth
+	for (size_t b = 0; b < queued_batches.size(); b++)
+	{
+		const QueuedBatch& batch = queued_batches[b];
+		const Model* model = batch.instances->GetModel();
+		for (unsigned d = 0; d < model->DrawcallCount(); d++)
+		{
+			const Material* mtl = batch.instances->DrawcallMaterial(batch.material, d);
+
+			render_queue.Push(
+				RenderQueue::MakeKey(0, InstancedShader, TextureSetId(mtl), MaterialId(mtl), 0),
+				(unsigned)b,
+				d);
+		}
+	}
+	render_queue.Sort();
+
+	// Input layouts and vertex shaders by sort key shader id. The default
+	// ones are those Main bound, the instanced one is hot reloaded as Main's are
+	bind_shader(dxdevice, nullptr, instanced_vertex_shader);
+	ID3D11InputLayout* input_layouts[2] = { state_cache->GetInputLayout() };
+	ID3D11VertexShader* vertex_shaders[2] = { state_cache->GetVertexShader() };
+	get_shader_objects(instanced_vertex_shader, &vertex_shaders[InstancedShader], &input_layouts[InstancedShader], nullptr);
+
+	// Submit the draws in key order, setting only the state that differs
+	// from the previous draw
+	const Model* bound_model = nullptr;
+	unsigned bound_object = ~0u;
+	render_queue.Submit([&](const DrawPacket& packet, unsigned changes)
+	{
+		const unsigned shader = RenderQueue::KeyShader(packet.key);
+		const bool instanced = shader == InstancedShader;
+		const QueuedBatch* batch = instanced ? &queued_batches[packet.object] : nullptr;
+		const Model* model = instanced ? batch->instances->GetModel() : queued_models[packet.object];
+		const Material* mtl = instanced ? batch->instances->DrawcallMaterial(batch->material, packet.drawcall) : model->DrawcallMaterial(packet.drawcall);
+
+		if (changes & RenderQueue::ShaderChanged)
+		{
+			state_cache->IASetInputLayout(input_layouts[shader]);
+			state_cache->VSSetShader(vertex_shaders[shader]);
+			if (instanced)
+			{
+				// Instances read their matrices from slot 1, and the
+				// world-to-clip matrix from b0
+				const UINT stride = sizeof(InstanceData), offset = 0;
+				state_cache->IASetVertexBuffers(1, 1, &instance_buffer, &stride, &offset);
+				state_cache->VSSetConstantBuffers(0, 1, &instancing_buffer);
+			}
+			else if (!object_ring_buffer)
+				state_cache->VSSetConstantBuffers(0, 1, &transformation_buffer);
+			bound_object = ~0u;
+		}
+
+		if (!instanced && packet.object != bound_object)
+		{
+			if (object_ring_buffer)
+			{
+				// Bind the object's range of the ring, in 16-byte constants
+				const UINT first_constant = (UINT)((ring_offset + packet.object * ObjectRingStride) / 16);
+				const UINT nbr_constants = (UINT)(ObjectRingStride / 16);
+				state_cache->VSSetConstantBuffers1(0, 1, &object_ring_buffer, &first_constant, &nbr_constants);
+			}
+			else
+			{
+				UpdateTransformationBuffer(queued_model_to_world[packet.object], queued_model_to_clip[packet.object], queued_normal[packet.object]);
+				submit_stats.transformation_maps++;
+			}
+			bound_object = packet.object;
+			submit_stats.transformation_updates++;
+		}
+
+		if (model != bound_model)
+		{
+			model->BindBuffers(*state_cache);
+			bound_model = model;
+			submit_stats.buffer_binds++;
+		}
+
+		if (mtl)
+		{
+			if (changes & RenderQueue::TextureSetChanged)
+			{
+				Model::BindTextures(*state_cache, *mtl);
+				submit_stats.texture_binds++;
+			}
+			if (changes & RenderQueue::MaterialChanged)
+			{
+				Model::BindMaterialBuffer(*state_cache, *mtl);
+				submit_stats.material_binds++;
+			}
+			// Each draw used to map and rewrite a shared material buffer
+			submit_stats.material_bytes_saved += sizeof(MaterialBuffer_t);
+		}
+
+		if (instanced)
+		{
+			model->DrawInstanced(*state_cache, packet.drawcall, batch->nbr_instances, batch->first_instance);
+			submit_stats.instanced_draws++;
+			submit_stats.instances += batch->nbr_instances;
+		}
+		else
+			model->Draw(*state_cache, packet.drawcall);
+		submit_stats.draws++;
+	});
+
+	render_queue.Clear();
+	queued_models.clear();
+	queued_model_to_world.clear();
+	queued_instances.clear();
+	queued_batches.clear();
+}
+
+void OurTestScene::InitInstanceBuffer(size_t nbr_instances)
+{
+	SAFE_RELEASE(instance_buffer);
+
+	HRESULT hr;
+	D3D11_BUFFER_DESC instance_desc = { 0 };
+	instance_desc.Usage = D3D11_USAGE_DYNAMIC;
+	instance_desc.ByteWidth = (UINT)(nbr_instances * sizeof(InstanceData));
+	instance_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	instance_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	ASSERT(hr = dxdevice->CreateBuffer(&instance_desc, nullptr, &instance_buffer));
+	SETNAME(instance_buffer, "InstanceBuffer");
+
+	instance_capacity = nbr_instances;
+}
+
+void OurTestScene::WriteInstances()
+{
+	size_t nbr_instances = 0;
+	for (const ModelInstances* instances : queued_instances)
+		nbr_instances += instances->VisibleCount();
+
+	// Grow the buffer to twice the need, so that it is not recreated
+	// while the visible count creeps up
+	if (nbr_instances > instance_capacity)
+		InitInstanceBuffer(nbr_instances * 2);
+
+	D3D11_MAPPED_SUBRESOURCE resource;
+	dxdevice_context->Map(instance_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	InstanceData* data = (InstanceData*)resource.pData;
+	unsigned first = 0;
+	for (const ModelInstances* instances : queued_instances)
+	{
+		instances->WriteVisible(data + first);
+		for (const ModelInstances::Batch& batch : instances->Batches())
+			queued_batches.push_back({ instances, batch.material, first + batch.first, batch.count });
+		first += (unsigned)instances->VisibleCount();
+	}
+	dxdevice_context->Unmap(instance_buffer, 0);
+}
+
 void OurTestScene::Release()
 {
 	SAFE_DELETE(quad);
+	SAFE_DELETE(cube_instances);
 	SAFE_DELETE(cube);
-	SAFE_DELETE(cube1);
-	SAFE_DELETE(cube2);
+	for (Material& mtl : cube_materials)
+		Model::ReleaseMaterial(mtl);
 	SAFE_DELETE(spaceship);
 	SAFE_DELETE(sponza);
 	SAFE_DELETE(camera);
 
 	SAFE_RELEASE(transformation_buffer);
+	SAFE_RELEASE(object_ring_buffer);
+	SAFE_RELEASE(instancing_buffer);
+	SAFE_RELEASE(instance_buffer);
 	// + release other CBuffers
 	SAFE_RELEASE(lightandcamera_buffer);
-	SAFE_RELEASE(mtl_buffer);
 	SAFE_RELEASE(sampler);
 	SAFE_RELEASE(samplerCube);
 	SAFE_RELEASE(samplerSpec);
+
+	delete_shader(instanced_vertex_shader);
+	instanced_vertex_shader = nullptr;
 }
 
 void OurTestScene::WindowResize(
@@ -301,21 +616,90 @@ void OurTestScene::InitTransformationBuffer()
 	ASSERT(hr = dxdevice->CreateBuffer(&MatrixBuffer_desc, nullptr, &transformation_buffer));
 }
 
+void OurTestScene::InitObjectRing(size_t nbr_objects)
+{
+	SAFE_RELEASE(object_ring_buffer);
+
+	HRESULT hr;
+	D3D11_BUFFER_DESC ring_desc = { 0 };
+	ring_desc.Usage = D3D11_USAGE_DYNAMIC;
+	ring_desc.ByteWidth = (UINT)(nbr_objects * ObjectRingStride);
+	ring_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	ring_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	ASSERT(hr = dxdevice->CreateBuffer(&ring_desc, nullptr, &object_ring_buffer));
+	SETNAME(object_ring_buffer, "ObjectRingBuffer");
+
+	object_ring = ConstantRing(ring_desc.ByteWidth);
+}
+
+size_t OurTestScene::WriteObjectRing()
+{
+	const size_t nbr_models = queued_models.size();
+
+	// Grow the ring if this frame does not fit, to twice the need so that
+	// several frames fit before wrapping
+	size_t offset;
+	bool discard;
+	if (!object_ring.Allocate(nbr_models * ObjectRingStride, offset, discard))
+	{
+		InitObjectRing(nbr_models * 2);
+		object_ring.Allocate(nbr_models * ObjectRingStride, offset, discard);
+	}
+
+	// Discard when the ring wraps, else append behind ranges the GPU may
+	// still be reading
+	D3D11_MAPPED_SUBRESOURCE resource;
+	dxdevice_context->Map(object_ring_buffer, 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &resource);
+	char* data = (char*)resource.pData + offset;
+	for (size_t i = 0; i < nbr_models; i++)
+	{
+		TransformationBuffer* matrix_buffer_ = (TransformationBuffer*)(data + i * ObjectRingStride);
+		matrix_buffer_->ModelToWorldMatrix = queued_model_to_world[i];
+		matrix_buffer_->ModelToClipMatrix = queued_model_to_clip[i];
+		matrix_buffer_->NormalMatrix = queued_normal[i];
+	}
+	dxdevice_context->Unmap(object_ring_buffer, 0);
+
+	return offset;
+}
+
 void OurTestScene::UpdateTransformationBuffer(
-	mat4f ModelToWorldMatrix,
-	mat4f WorldToViewMatrix,
-	mat4f ProjectionMatrix)
+	const mat4f& ModelToWorldMatrix,
+	const mat4f& ModelToClipMatrix,
+	const mat4f& NormalMatrix)
 {
 	// Map the resource buffer, obtain a pointer and then write our matrices to it
 	D3D11_MAPPED_SUBRESOURCE resource;
 	dxdevice_context->Map(transformation_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
 	TransformationBuffer* matrix_buffer_ = (TransformationBuffer*)resource.pData;
 	matrix_buffer_->ModelToWorldMatrix = ModelToWorldMatrix;
-	matrix_buffer_->WorldToViewMatrix = WorldToViewMatrix;
-	matrix_buffer_->ProjectionMatrix = ProjectionMatrix;
+	matrix_buffer_->ModelToClipMatrix = ModelToClipMatrix;
+	matrix_buffer_->NormalMatrix = NormalMatrix;
 	dxdevice_context->Unmap(transformation_buffer, 0);
 }
 
+void OurTestScene::InitInstancingBuffer()
+{
+	HRESULT hr;
+	D3D11_BUFFER_DESC InstancingBuffer_desc = { 0 };
+	InstancingBuffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+	InstancingBuffer_desc.ByteWidth = sizeof(InstancingBuffer);
+	InstancingBuffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	InstancingBuffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	InstancingBuffer_desc.MiscFlags = 0;
+	InstancingBuffer_desc.StructureByteStride = 0;
+	ASSERT(hr = dxdevice->CreateBuffer(&InstancingBuffer_desc, nullptr, &instancing_buffer));
+}
+
+void OurTestScene::UpdateInstancingBuffer(const mat4f& WorldToClipMatrix)
+{
+	D3D11_MAPPED_SUBRESOURCE resource;
+	dxdevice_context->Map(instancing_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	InstancingBuffer* instancing_buffer_ = (InstancingBuffer*)resource.pData;
+	instancing_buffer_->WorldToClipMatrix = WorldToClipMatrix;
+	dxdevice_context->Unmap(instancing_buffer, 0);
+}
+
 void OurTestScene::InitLightAndCameraBuffer() 
 {
 	HRESULT hr;
@@ -342,30 +726,6 @@ void OurTestScene::UpdateLightAndCameraBuffer(
 
 }
 
-void OurTestScene::InitMaterialBuffer() 
-{
-	HRESULT hr;
-	D3D11_BUFFER_DESC PhongColorAndShininessBuffer_desc = { 0 };
-	PhongColorAndShininessBuffer_desc.Usage = D3D11_USAGE_DYNAMIC;
-	PhongColorAndShininessBuffer_desc.ByteWidth = sizeof(TransformationBuffer);
-	PhongColorAndShininessBuffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	PhongColorAndShininessBuffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	PhongColorAndShininessBuffer_desc.MiscFlags = 0;
-	PhongColorAndShininessBuffer_desc.StructureByteStride = 0;
-	ASSERT(hr = dxdevice->CreateBuffer(&PhongColorAndShininessBuffer_desc, nullptr, &mtl_buffer));
-}
-
-void OurTestScene::UpdateMaterialBuffer(vec4f Ka, vec4f Kd, vec4f Ks, float shininess)
-{
-	D3D11_MAPPED_SUBRESOURCE resource;
-	dxdevice_context->Map(mtl_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-	PhongColorAndShininessBuffer* phong_buffer = (PhongColorAndShininessBuffer*)resource.pData;
-	phong_buffer->Ka = Ka;
-	phong_buffer->Kd = Kd;
-	phong_buffer->Ks = Ks;
-	phong_buffer->shininess = shininess;	
-	dxdevice_context->Unmap(mtl_buffer, 0);
-}
 
 void OurTestScene::InitSamplerPoint() //No antialiasing
 {
@@ -8,6 +8,19 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Texture.h"
+#include "TransformHierarchy.h"
+#include "RenderQueue.h"
+#include "ConstantRing.h"
+#include "Instancing.h"
+#include "shader.h"
+#include <array>
+#include <map>
+#include <unordered_map>
+
+//
+// Skip models, and drawcalls of models, outside the camera frustum
+//
+#define FRUSTUM_CULLING
 
 // New files
 // Material
@@ -21,6 +34,7 @@ class Scene
 protected:
 	ID3D11Device*			dxdevice;
 	ID3D11DeviceContext*	dxdevice_context;
+	StateCache*				state_cache;	// IA, VS and PS bindings of dxdevice_context
 	int						window_width;
 	int						window_height;
 
@@ -29,6 +43,7 @@ public:
 	Scene(
 		ID3D11Device* dxdevice,
 		ID3D11DeviceContext* dxdevice_context,
+		StateCache* state_cache,
 		int window_width,
 		int window_height);
 
@@ -56,13 +71,31 @@ class OurTestScene : public Scene
 
 	// CBuffer for transformation matrices
 	ID3D11Buffer* transformation_buffer = nullptr;
+	// Per-object TransformationBuffers of a frame, bound per object with
+	// constant buffer offsets. nullptr if offsets are not supported, and
+	// transformation_buffer is then mapped per object instead
+	ID3D11Buffer* object_ring_buffer = nullptr;
+	ConstantRing object_ring;
+	// CBuffer for the world-to-clip matrix of instanced draws
+	ID3D11Buffer* instancing_buffer = nullptr;
 	// + other CBuffers
 	ID3D11Buffer* lightandcamera_buffer = nullptr; //Updated per frame
-	ID3D11Buffer* mtl_buffer = nullptr; //Updated per frame and object
 	ID3D11SamplerState* sampler = nullptr; //sampler
 	ID3D11SamplerState* samplerCube = nullptr; //sampler
 	ID3D11SamplerState* samplerSpec = nullptr; //sampler
 
+	// InstanceData of the visible instances of a frame, bound to vertex
+	// buffer slot 1 for instanced draws
+	ID3D11Buffer* instance_buffer = nullptr;
+	size_t instance_capacity = 0;
+
+	// Vertex shader of instanced draws. The other shaders are the ones
+	// bound by Main
+	shader_data* instanced_vertex_shader = nullptr;
+
+	// Sort key shader ids
+	static const unsigned DefaultShader = 0;
+	static const unsigned InstancedShader = 1;
 
 
 
@@ -74,22 +107,22 @@ class OurTestScene : public Scene
 	struct TransformationBuffer
 	{
 		mat4f ModelToWorldMatrix;
-		mat4f WorldToViewMatrix;
-		mat4f ProjectionMatrix;
+		mat4f ModelToClipMatrix;	// Projection * World-to-View * Model-to-World
+		mat4f NormalMatrix;			// Inverse transpose of Model-to-World
 	};
 
-	struct LightandCameraBuffer 
+	// Bytes per TransformationBuffer in object_ring_buffer
+	static const size_t ObjectRingStride = ConstantRing::Align(sizeof(TransformationBuffer));
+
+	struct InstancingBuffer
 	{
-		vec4f lightposition;
-		vec4f cameraposition;
+		mat4f WorldToClipMatrix;	// Projection * World-to-View
 	};
 
-	struct PhongColorAndShininessBuffer 
+	struct LightandCameraBuffer 
 	{
-		vec4f Ka;
-		vec4f Kd;
-		vec4f Ks;
-		float shininess;
+		vec4f lightposition;
+		vec4f cameraposition;
 	};
 
 	//
@@ -97,21 +130,28 @@ class OurTestScene : public Scene
 	//
 	Camera* camera;
 
+	// Meshes shared between the models
+	MeshRegistry meshes;
+
 	QuadModel* quad;
+	// One cube mesh, drawn instanced for cube, cube1 and cube2 with
+	// a material each from cube_materials. quad shares the first
 	Cube* cube;
-	Cube* cube1;
-	Cube* cube2;
+	std::vector<Material> cube_materials;
+	ModelInstances* cube_instances;
 	OBJModel* sponza;
 	OBJModel* spaceship;
 	
 
-	// Model-to-world transformation matrices
-	mat4f Msponza;
-	mat4f Mcube;
-	mat4f Mcube1;
-	mat4f Mcube2;
-	mat4f Mquad;
-	mat4f Mspaceship;
+	// Model-to-world transformations
+	TransformHierarchy transforms;
+	TransformHierarchy::NodeId node_quad;
+	TransformHierarchy::NodeId node_cube_pivot;	// Shared by cube and its satellite cube1
+	TransformHierarchy::NodeId node_cube;
+	TransformHierarchy::NodeId node_cube1;
+	TransformHierarchy::NodeId node_cube2;
+	TransformHierarchy::NodeId node_sponza;
+	TransformHierarchy::NodeId node_spaceship;
 
 	// World-to-view matrix
 	mat4f Mview;
@@ -123,13 +163,108 @@ class OurTestScene : public Scene
 	float angle_vel = fPI / 2;	// ...and its velocity (radians/sec)
 	float camera_vel = 5.0f;	// Camera movement velocity in units/s
 	float fps_cooldown = 0;
+	unsigned fps_frames = 0;	// Frames since the last fps print
+	size_t transform_updates = 0;	// World matrices recomputed since the last fps print
+	CullStats cull_stats;		// Frustum culling counters of the last frame
+
+	//
+	// State changes while submitting the render queue of the last frame
+	//
+	struct SubmitStats
+	{
+		unsigned draws = 0;
+		unsigned buffer_binds = 0;
+		unsigned texture_binds = 0;
+		unsigned material_binds = 0;
+		unsigned material_bytes_saved = 0;	// Material data per-draw uploads would have written
+		unsigned transformation_updates = 0;
+		unsigned transformation_maps = 0;
+		unsigned instanced_draws = 0;	// of draws
+		unsigned instances = 0;			// drawn by instanced_draws
+	} submit_stats;
+
+	// Models to render this frame, with their per-object matrices
+	std::vector<Model*> queued_models;
+	std::vector<mat4f> queued_model_to_world;
+	std::vector<mat4f> queued_model_to_clip;
+	std::vector<mat4f> queued_normal;
+
+	// Instanced models to render this frame, with the visible instances of
+	// each batch at [first_instance, first_instance + nbr_instances) of
+	// instance_buffer
+	struct QueuedBatch
+	{
+		const ModelInstances* instances;
+		unsigned material;
+		unsigned first_instance;
+		unsigned nbr_instances;
+	};
+	std::vector<ModelInstances*> queued_instances;
+	std::vector<QueuedBatch> queued_batches;
+
+	// Draws of the queued models and batches, sorted by state
+	RenderQueue render_queue;
+
+	// Sort key ids of materials and texture sets, 0 for none
+	std::unordered_map<const Material*, unsigned> material_ids;
+	std::map<std::array<ID3D11ShaderResourceView*, 4>, unsigned> texture_set_ids;
+
+	unsigned MaterialId(const Material* mtl);
+	unsigned TextureSetId(const Material* mtl);
 
 	void InitTransformationBuffer();
 
+	//
+	// (Re)create object_ring_buffer with room for nbr_objects objects
+	//
+	void InitObjectRing(size_t nbr_objects);
+
+	//
+	// Write the matrices of all queued models to object_ring_buffer with
+	// one map. Returns the offset of the first, in bytes
+	//
+	size_t WriteObjectRing();
+
 	void UpdateTransformationBuffer(
-		mat4f ModelToWorldMatrix,
-		mat4f WorldToViewMatrix,
-		mat4f ProjectionMatrix);
+		const mat4f& ModelToWorldMatrix,
+		const mat4f& ModelToClipMatrix,
+		const mat4f& NormalMatrix);
+
+	//
+	// Cull model against the camera frustum and, unless it is
+	// entirely outside, queue it for rendering with the given transformation
+	//
+	void QueueModel(
+		Model* model,
+		const mat4f& ModelToWorldMatrix);
+
+	//
+	// Cull the instances against the camera frustum and, unless all are
+	// outside, queue them for rendering
+	//
+	void QueueInstances(ModelInstances* instances);
+
+	//
+	// (Re)create instance_buffer with room for nbr_instances instances
+	//
+	void InitInstanceBuffer(size_t nbr_instances);
+
+	//
+	// Write the visible instances of all queued instanced models to
+	// instance_buffer with one map, and queue their batches
+	//
+	void WriteInstances();
+
+	//
+	// Compute the per-object matrices of all queued models in one batch,
+	// then render their drawcalls, and those of the queued batches,
+	// through render_queue
+	//
+	void RenderQueuedModels();
+
+	void InitInstancingBuffer();
+
+	void UpdateInstancingBuffer(const mat4f& WorldToClipMatrix);
 
 	void InitLightAndCameraBuffer();
 
@@ -138,15 +273,6 @@ class OurTestScene : public Scene
 		vec4f cameraposition
 	);
 
-	void InitMaterialBuffer();
-
-	void UpdateMaterialBuffer(
-		vec4f Ka, 
-		vec4f Kd, 
-		vec4f Ks, 
-		float shininess
-	);
-
 	void InitSamplerPoint();
 	void InitSamplerLinear();
 	void InitSamplerAniso();
@@ -155,6 +281,7 @@ public:
 	OurTestScene(
 		ID3D11Device* dxdevice,
 		ID3D11DeviceContext* dxdevice_context,
+		StateCache* state_cache,
 		int window_width,
 		int window_height);
 
@@ -83,6 +83,17 @@ extern "C" {
 	/// 
 	void bind_shader(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, shader_data* pShader);
 
+	///
+	/// Get the DX11 objects of a shader, to bind them without bind_shader.
+	/// Call bind_shader with a NULL context first to still hot reload the shader.
+	/// 
+	/// @param pShader Pointer to the shader.
+	/// @param ppVertexShader Receives the vertex shader, NULL if pShader is not a vertex shader. Can be NULL.
+	/// @param ppInputLayout Receives the input layout, NULL if pShader is not a vertex shader. Can be NULL.
+	/// @param ppPixelShader Receives the pixel shader, NULL if pShader is not a pixel shader. Can be NULL.
+	/// 
+	void get_shader_objects(const shader_data* pShader, ID3D11VertexShader** ppVertexShader, ID3D11InputLayout** ppInputLayout, ID3D11PixelShader** ppPixelShader);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
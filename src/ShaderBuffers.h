@@ -11,8 +11,17 @@ using namespace linalg;
 struct MatrixBuffer_t
 {
 	mat4f ModelToWorldMatrix;
-	mat4f WorldToViewMatrix;
-	mat4f ProjectionMatrix;
+	mat4f ModelToClipMatrix;	// Projection * World-to-View * Model-to-World
+	mat4f NormalMatrix;			// Inverse transpose of Model-to-World
+};
+
+struct MaterialBuffer_t
+{
+	vec4f Ka;
+	vec4f Kd;
+	vec4f Ks;
+	float shininess;
+	float padding[3];	// Constant buffer sizes are multiples of 16 bytes
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,556 @@
+//
+//  StateCache.h
+//
+//  Redundant state filtering in front of a device context
+//
+
+#pragma once
+#ifndef STATECACHE_H
+#define STATECACHE_H
+
+#include "stdafx.h"
+#include <algorithm>
+
+//
+// Binding call counters
+//
+struct StateCacheStats
+{
+	unsigned requested = 0;	// binding calls made to the cache
+	unsigned filtered = 0;	// of these, calls that changed no binding
+	unsigned issued = 0;	// binding calls made to the context
+	unsigned draws = 0;
+};
+
+//
+// State cache
+//
+// Takes the IA, VS and PS binding calls of a device context, and passes
+// them on only when they change a binding. Slot bindings (vertex buffers,
+// constant buffers, shader resources, samplers) are held until the next
+// draw, and the changed slots of each kind are then bound with as few
+// calls as possible, one per run of slots with known bindings. Only
+// bindings made through the cache are tracked; call Invalidate after
+// binding state on the context directly.
+//
+// Context is ID3D11DeviceContext (see StateCache below), or any type with
+// the same binding and draw methods, such as a mock that counts calls.
+// Constant buffers may be bound in ranges (XSSetConstantBuffers1), which
+// are filtered like whole buffers, through context1, the Direct3D 11.1
+// interface of the same context. Without it, only whole buffers can be
+// bound.
+//
+template<class Context, class Context1 = Context>
+class StateCacheT
+{
+public:
+	// Slots tracked per stage and kind. Calls for higher slots are passed
+	// on unfiltered
+	static const UINT MaxVertexBuffers = 4;
+	static const UINT MaxSlots = 16;
+
+	explicit StateCacheT(Context* context, Context1* context1 = nullptr) :
+		context(context), context1(context1)
+	{
+		Invalidate();
+	}
+
+	Context* GetContext() const { return context; }
+
+	// nullptr if constant buffers cannot be bound in ranges
+	Context1* GetContext1() const { return context1; }
+
+	//
+	// Forget all bindings, so that the next call of each is passed on
+	//
+	void Invalidate()
+	{
+		input_layout_known = topology_known = index_buffer_known = false;
+		vs_known = ps_known = false;
+		vertex_buffers.Invalidate();
+		vs_constant_buffers.Invalidate();
+		vs_resources.Invalidate();
+		vs_samplers.Invalidate();
+		ps_constant_buffers.Invalidate();
+		ps_resources.Invalidate();
+		ps_samplers.Invalidate();
+	}
+
+	const StateCacheStats& GetStats() const { return stats; }
+
+	//
+	// Input layout and vertex shader last set through the cache, nullptr
+	// if not known
+	//
+	ID3D11InputLayout* GetInputLayout() const { return input_layout_known ? input_layout : nullptr; }
+
+	ID3D11VertexShader* GetVertexShader() const { return vs_known ? vs : nullptr; }
+
+	void ResetStats() { stats = StateCacheStats(); }
+
+	//
+	// IA
+	//
+
+	void IASetInputLayout(ID3D11InputLayout* layout)
+	{
+		if (Changed(input_layout_known, input_layout, layout))
+			context->IASetInputLayout(layout);
+	}
+
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY new_topology)
+	{
+		if (Changed(topology_known, topology, new_topology))
+			context->IASetPrimitiveTopology(new_topology);
+	}
+
+	void IASetVertexBuffers(
+		UINT start_slot,
+		UINT count,
+		ID3D11Buffer* const* buffers,
+		const UINT* strides,
+		const UINT* offsets)
+	{
+		stats.requested++;
+		if (start_slot + count > MaxVertexBuffers)
+		{
+			Flush();
+			vertex_buffers.Invalidate();
+			context->IASetVertexBuffers(start_slot, count, buffers, strides, offsets);
+			stats.issued++;
+			return;
+		}
+		bool changed = false;
+		for (UINT i = 0; i < count; i++)
+			changed |= vertex_buffers.Set(start_slot + i, { buffers[i], strides[i], offsets[i] });
+		stats.filtered += !changed;
+	}
+
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+	{
+		const index_buffer_t new_index_buffer = { buffer, format, offset };
+		if (Changed(index_buffer_known, index_buffer, new_index_buffer))
+			context->IASetIndexBuffer(buffer, format, offset);
+	}
+
+	//
+	// VS
+	//
+
+	void VSSetShader(
+		ID3D11VertexShader* shader,
+		ID3D11ClassInstance* const* class_instances = nullptr,
+		UINT nbr_class_instances = 0)
+	{
+		// Class instances are not tracked
+		if (nbr_class_instances)
+			vs_known = false;
+		if (Changed(vs_known, vs, shader))
+			context->VSSetShader(shader, class_instances, nbr_class_instances);
+	}
+
+	void VSSetConstantBuffers(UINT start_slot, UINT count, ID3D11Buffer* const* buffers)
+	{
+		if (!SetConstantBuffers(vs_constant_buffers, start_slot, count, buffers, nullptr, nullptr))
+			context->VSSetConstantBuffers(start_slot, count, buffers);
+	}
+
+	//
+	// Bind ranges of constant buffers, in constants of 16 bytes. Requires
+	// context1
+	//
+	void VSSetConstantBuffers1(
+		UINT start_slot,
+		UINT count,
+		ID3D11Buffer* const* buffers,
+		const UINT* first_constants,
+		const UINT* nbr_constants)
+	{
+		if (!SetConstantBuffers(vs_constant_buffers, start_slot, count, buffers, first_constants, nbr_constants))
+			context1->VSSetConstantBuffers1(start_slot, count, buffers, first_constants, nbr_constants);
+	}
+
+	void VSSetShaderResources(UINT start_slot, UINT count, ID3D11ShaderResourceView* const* views)
+	{
+		if (!SetSlots(vs_resources, start_slot, count, views))
+			context->VSSetShaderResources(start_slot, count, views);
+	}
+
+	void VSSetSamplers(UINT start_slot, UINT count, ID3D11SamplerState* const* samplers)
+	{
+		if (!SetSlots(vs_samplers, start_slot, count, samplers))
+			context->VSSetSamplers(start_slot, count, samplers);
+	}
+
+	//
+	// PS
+	//
+
+	void PSSetShader(
+		ID3D11PixelShader* shader,
+		ID3D11ClassInstance* const* class_instances = nullptr,
+		UINT nbr_class_instances = 0)
+	{
+		// Class instances are not tracked
+		if (nbr_class_instances)
+			ps_known = false;
+		if (Changed(ps_known, ps, shader))
+			context->PSSetShader(shader, class_instances, nbr_class_instances);
+	}
+
+	void PSSetConstantBuffers(UINT start_slot, UINT count, ID3D11Buffer* const* buffers)
+	{
+		if (!SetConstantBuffers(ps_constant_buffers, start_slot, count, buffers, nullptr, nullptr))
+			context->PSSetConstantBuffers(start_slot, count, buffers);
+	}
+
+	//
+	// Bind ranges of constant buffers, in constants of 16 bytes. Requires
+	// context1
+	//
+	void PSSetConstantBuffers1(
+		UINT start_slot,
+		UINT count,
+		ID3D11Buffer* const* buffers,
+		const UINT* first_constants,
+		const UINT* nbr_constants)
+	{
+		if (!SetConstantBuffers(ps_constant_buffers, start_slot, count, buffers, first_constants, nbr_constants))
+			context1->PSSetConstantBuffers1(start_slot, count, buffers, first_constants, nbr_constants);
+	}
+
+	void PSSetShaderResources(UINT start_slot, UINT count, ID3D11ShaderResourceView* const* views)
+	{
+		if (!SetSlots(ps_resources, start_slot, count, views))
+			context->PSSetShaderResources(start_slot, count, views);
+	}
+
+	void PSSetSamplers(UINT start_slot, UINT count, ID3D11SamplerState* const* samplers)
+	{
+		if (!SetSlots(ps_samplers, start_slot, count, samplers))
+			context->PSSetSamplers(start_slot, count, samplers);
+	}
+
+	//
+	// Draws, with the held slot bindings passed on first
+	//
+
+	void DrawIndexed(UINT index_count, UINT start_index, INT base_vertex)
+	{
+		Flush();
+		context->DrawIndexed(index_count, start_index, base_vertex);
+		stats.draws++;
+	}
+
+	void DrawIndexedInstanced(
+		UINT index_count_per_instance,
+		UINT instance_count,
+		UINT start_index,
+		INT base_vertex,
+		UINT start_instance)
+	{
+		Flush();
+		context->DrawIndexedInstanced(index_count_per_instance, instance_count, start_index, base_vertex, start_instance);
+		stats.draws++;
+	}
+
+	void Draw(UINT vertex_count, UINT start_vertex)
+	{
+		Flush();
+		context->Draw(vertex_count, start_vertex);
+		stats.draws++;
+	}
+
+	//
+	// Pass on the held slot bindings
+	//
+	void Flush()
+	{
+		vertex_buffers.Flush([this](UINT begin, UINT end)
+		{
+			ID3D11Buffer* buffers[MaxVertexBuffers];
+			UINT strides[MaxVertexBuffers], offsets[MaxVertexBuffers];
+			for (UINT i = begin; i < end; i++)
+			{
+				buffers[i] = vertex_buffers.bound[i].buffer;
+				strides[i] = vertex_buffers.bound[i].stride;
+				offsets[i] = vertex_buffers.bound[i].offset;
+			}
+			context->IASetVertexBuffers(begin, end - begin, buffers + begin, strides + begin, offsets + begin);
+			stats.issued++;
+		});
+		IssueConstantBuffers(&Context::VSSetConstantBuffers, &Context1::VSSetConstantBuffers1, vs_constant_buffers);
+		Issue(&Context::VSSetShaderResources, vs_resources);
+		Issue(&Context::VSSetSamplers, vs_samplers);
+		IssueConstantBuffers(&Context::PSSetConstantBuffers, &Context1::PSSetConstantBuffers1, ps_constant_buffers);
+		Issue(&Context::PSSetShaderResources, ps_resources);
+		Issue(&Context::PSSetSamplers, ps_samplers);
+	}
+
+private:
+	struct vertex_buffer_t
+	{
+		ID3D11Buffer* buffer;
+		UINT stride;
+		UINT offset;
+
+		bool operator !=(const vertex_buffer_t& b) const
+		{
+			return buffer != b.buffer || stride != b.stride || offset != b.offset;
+		}
+	};
+
+	// A constant buffer, or a range of it if nbr_constants > 0
+	struct constant_buffer_t
+	{
+		ID3D11Buffer* buffer;
+		UINT first_constant;
+		UINT nbr_constants;
+
+		bool operator !=(const constant_buffer_t& b) const
+		{
+			return buffer != b.buffer || first_constant != b.first_constant || nbr_constants != b.nbr_constants;
+		}
+	};
+
+	struct index_buffer_t
+	{
+		ID3D11Buffer* buffer;
+		DXGI_FORMAT format;
+		UINT offset;
+
+		bool operator !=(const index_buffer_t& b) const
+		{
+			return buffer != b.buffer || format != b.format || offset != b.offset;
+		}
+	};
+
+	//
+	// Bindings of N slots: as last passed on (bound), and as set since
+	// (pending), with the range of slots set since
+	//
+	template<class T, UINT N>
+	struct slots_t
+	{
+		T bound[N];
+		T pending[N];
+		bool known[N];	// bound is the binding of the context
+		bool set[N];	// pending was set since the last Flush
+		UINT dirty_begin;
+		UINT dirty_end;
+
+		void Invalidate()
+		{
+			for (UINT i = 0; i < N; i++)
+				known[i] = set[i] = false;
+			dirty_begin = N;
+			dirty_end = 0;
+		}
+
+		// Returns whether the binding of slot changes
+		bool Set(UINT slot, const T& value)
+		{
+			pending[slot] = value;
+			set[slot] = true;
+			dirty_begin = std::min(dirty_begin, slot);
+			dirty_end = std::max(dirty_end, slot + 1);
+			return !known[slot] || value != bound[slot];
+		}
+
+		bool Changed(UINT slot) const
+		{
+			return set[slot] && (!known[slot] || pending[slot] != bound[slot]);
+		}
+
+		//
+		// Call issue(begin, end) for each run [begin, end) of slots that
+		// changed, after updating bound. Slots in between that did not
+		// change join a run if their binding is known, so that one call
+		// covers them all
+		//
+		template<class F>
+		void Flush(F&& issue)
+		{
+			UINT slot = dirty_begin;
+			while (slot < dirty_end)
+			{
+				if (!Changed(slot))
+				{
+					slot++;
+					continue;
+				}
+
+				UINT begin = slot, end = slot + 1;
+				for (slot++; slot < dirty_end && (known[slot] || set[slot]); slot++)
+				{
+					if (Changed(slot))
+						end = slot + 1;
+				}
+
+				for (UINT i = begin; i < end; i++)
+				{
+					if (set[i])
+						bound[i] = pending[i];
+					known[i] = true;
+				}
+				issue(begin, end);
+			}
+
+			for (UINT i = dirty_begin; i < dirty_end; i++)
+				set[i] = false;
+			dirty_begin = N;
+			dirty_end = 0;
+		}
+	};
+
+	Context* context;
+	Context1* context1;
+	StateCacheStats stats;
+
+	bool input_layout_known, topology_known, index_buffer_known, vs_known, ps_known;
+	ID3D11InputLayout* input_layout;
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	index_buffer_t index_buffer;
+	ID3D11VertexShader* vs;
+	ID3D11PixelShader* ps;
+
+	slots_t<vertex_buffer_t, MaxVertexBuffers> vertex_buffers;
+	slots_t<constant_buffer_t, MaxSlots> vs_constant_buffers;
+	slots_t<ID3D11ShaderResourceView*, MaxSlots> vs_resources;
+	slots_t<ID3D11SamplerState*, MaxSlots> vs_samplers;
+	slots_t<constant_buffer_t, MaxSlots> ps_constant_buffers;
+	slots_t<ID3D11ShaderResourceView*, MaxSlots> ps_resources;
+	slots_t<ID3D11SamplerState*, MaxSlots> ps_samplers;
+
+	//
+	// Update a single-valued binding. Returns whether it changed, and
+	// so is to be passed on
+	//
+	template<class T>
+	bool Changed(bool& known, T& current, const T& value)
+	{
+		stats.requested++;
+		if (known && !(value != current))
+		{
+			stats.filtered++;
+			return false;
+		}
+		known = true;
+		current = value;
+		stats.issued++;
+		return true;
+	}
+
+	//
+	// Hold slot bindings until the next Flush. Returns false for slots
+	// out of range, which are to be passed on at once instead
+	//
+	template<class T>
+	bool SetSlots(slots_t<T, MaxSlots>& slots, UINT start_slot, UINT count, T const* values)
+	{
+		stats.requested++;
+		if (start_slot + count > MaxSlots)
+		{
+			Flush();
+			slots.Invalidate();
+			stats.issued++;
+			return false;
+		}
+		bool changed = false;
+		for (UINT i = 0; i < count; i++)
+			changed |= slots.Set(start_slot + i, values[i]);
+		stats.filtered += !changed;
+		return true;
+	}
+
+	//
+	// As SetSlots, for constant buffers, in ranges if first_constants
+	// and nbr_constants are given
+	//
+	bool SetConstantBuffers(
+		slots_t<constant_buffer_t, MaxSlots>& slots,
+		UINT start_slot,
+		UINT count,
+		ID3D11Buffer* const* buffers,
+		const UINT* first_constants,
+		const UINT* nbr_constants)
+	{
+		stats.requested++;
+		if (start_slot + count > MaxSlots)
+		{
+			Flush();
+			slots.Invalidate();
+			stats.issued++;
+			return false;
+		}
+		bool changed = false;
+		for (UINT i = 0; i < count; i++)
+		{
+			const constant_buffer_t value =
+			{
+				buffers[i],
+				first_constants ? first_constants[i] : 0,
+				nbr_constants ? nbr_constants[i] : 0
+			};
+			changed |= slots.Set(start_slot + i, value);
+		}
+		stats.filtered += !changed;
+		return true;
+	}
+
+	// C is Context or a base of it, which declares set
+	template<class C, class T>
+	void Issue(
+		void (STDMETHODCALLTYPE C::*set)(UINT, UINT, T const*),
+		slots_t<T, MaxSlots>& slots)
+	{
+		slots.Flush([&](UINT begin, UINT end)
+		{
+			(context->*set)(begin, end - begin, slots.bound + begin);
+			stats.issued++;
+		});
+	}
+
+	//
+	// Issue held constant buffer bindings. A run mixing whole buffers and
+	// ranges is split into calls of either kind, ranges through context1.
+	// C and C1 are Context and Context1, or bases of them
+	//
+	template<class C, class C1>
+	void IssueConstantBuffers(
+		void (STDMETHODCALLTYPE C::*set)(UINT, UINT, ID3D11Buffer* const*),
+		void (STDMETHODCALLTYPE C1::*set_ranges)(UINT, UINT, ID3D11Buffer* const*, const UINT*, const UINT*),
+		slots_t<constant_buffer_t, MaxSlots>& slots)
+	{
+		slots.Flush([&](UINT begin, UINT end)
+		{
+			ID3D11Buffer* buffers[MaxSlots];
+			UINT first_constants[MaxSlots], nbr_constants[MaxSlots];
+			for (UINT i = begin; i < end; i++)
+			{
+				buffers[i] = slots.bound[i].buffer;
+				first_constants[i] = slots.bound[i].first_constant;
+				nbr_constants[i] = slots.bound[i].nbr_constants;
+			}
+
+			while (begin < end)
+			{
+				const bool ranges = nbr_constants[begin] > 0;
+				UINT split = begin + 1;
+				while (split < end && (nbr_constants[split] > 0) == ranges)
+					split++;
+
+				if (ranges)
+					(context1->*set_ranges)(begin, split - begin, buffers + begin, first_constants + begin, nbr_constants + begin);
+				else
+					(context->*set)(begin, split - begin, buffers + begin);
+				stats.issued++;
+				begin = split;
+			}
+		});
+	}
+};
+
+typedef StateCacheT<ID3D11DeviceContext, ID3D11DeviceContext1> StateCache;
+
+#endif
@@ -0,0 +1,230 @@
+//
+//  Tangents.cpp
+//
+//  Per-vertex tangent frames for normal mapping
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "Tangents.h"
+#include "Parallel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TANGENTS_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace linalg;
+
+//
+// Texture-space directions of all triangles, as structure of arrays
+//
+// s is the direction of increasing u and t the direction of increasing v,
+// both unit length. weight[k] is the angle at corner k, or zero for all
+// corners if the triangle is degenerate in position or texture space
+//
+struct face_tangents_t
+{
+	std::vector<float> sx, sy, sz;
+	std::vector<float> tx, ty, tz;
+	std::vector<float> weight[3];
+
+	void resize(size_t n)
+	{
+		for (auto* a : { &sx, &sy, &sz, &tx, &ty, &tz, &weight[0], &weight[1], &weight[2] })
+			a->resize(n);
+	}
+};
+
+static void FaceTangents(
+	const std::vector<Vertex>& vertices,
+	const std::vector<unsigned>& indices,
+	size_t f,
+	face_tangents_t& faces)
+{
+	const Vertex& v0 = vertices[indices[3 * f + 0]];
+	const Vertex& v1 = vertices[indices[3 * f + 1]];
+	const Vertex& v2 = vertices[indices[3 * f + 2]];
+
+	vec3f e1 = v1.Pos - v0.Pos, e2 = v2.Pos - v0.Pos;
+	vec2f d1 = v1.TexCoord - v0.TexCoord, d2 = v2.TexCoord - v0.TexCoord;
+
+	vec3f s = vec3f_zero, t = vec3f_zero;
+	float det = d1.x * d2.y - d2.x * d1.y;
+	if (std::fabs(det) > FLT_MIN)
+	{
+		s = (e1 * d2.y - e2 * d1.y) * (1.0f / det);
+		t = (e2 * d1.x - e1 * d2.x) * (1.0f / det);
+		float s2 = dot(s, s), t2 = dot(t, t);
+		if (s2 > 0.0f && t2 > 0.0f)
+		{
+			s = s * (1.0f / std::sqrt(s2));
+			t = t * (1.0f / std::sqrt(t2));
+		}
+		else
+			s = t = vec3f_zero;
+	}
+
+	faces.sx[f] = s.x; faces.sy[f] = s.y; faces.sz[f] = s.z;
+	faces.tx[f] = t.x; faces.ty[f] = t.y; faces.tz[f] = t.z;
+}
+
+#ifdef TANGENTS_SSE
+
+//
+// FaceTangents for triangles f .. f+3
+//
+static void FaceTangents4(
+	const std::vector<Vertex>& vertices,
+	const std::vector<unsigned>& indices,
+	size_t f,
+	face_tangents_t& faces)
+{
+	const Vertex* v[3][4];
+	for (int j = 0; j < 4; j++)
+		for (int k = 0; k < 3; k++)
+			v[k][j] = &vertices[indices[3 * (f + j) + k]];
+
+#define GATHER(k, member) _mm_setr_ps(v[k][0]->member, v[k][1]->member, v[k][2]->member, v[k][3]->member)
+	__m128 p0x = GATHER(0, Pos.x), p0y = GATHER(0, Pos.y), p0z = GATHER(0, Pos.z);
+	__m128 e1x = _mm_sub_ps(GATHER(1, Pos.x), p0x), e1y = _mm_sub_ps(GATHER(1, Pos.y), p0y), e1z = _mm_sub_ps(GATHER(1, Pos.z), p0z);
+	__m128 e2x = _mm_sub_ps(GATHER(2, Pos.x), p0x), e2y = _mm_sub_ps(GATHER(2, Pos.y), p0y), e2z = _mm_sub_ps(GATHER(2, Pos.z), p0z);
+	__m128 u0 = GATHER(0, TexCoord.x), v0 = GATHER(0, TexCoord.y);
+	__m128 du1 = _mm_sub_ps(GATHER(1, TexCoord.x), u0), dv1 = _mm_sub_ps(GATHER(1, TexCoord.y), v0);
+	__m128 du2 = _mm_sub_ps(GATHER(2, TexCoord.x), u0), dv2 = _mm_sub_ps(GATHER(2, TexCoord.y), v0);
+#undef GATHER
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	__m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+	__m128 valid = _mm_cmpgt_ps(_mm_and_ps(det, abs_mask), _mm_set1_ps(FLT_MIN));
+	__m128 r = _mm_div_ps(one, _mm_or_ps(_mm_and_ps(valid, det), _mm_andnot_ps(valid, one)));
+
+	__m128 sx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1x, dv2), _mm_mul_ps(e2x, dv1)), r);
+	__m128 sy = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1y, dv2), _mm_mul_ps(e2y, dv1)), r);
+	__m128 sz = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1z, dv2), _mm_mul_ps(e2z, dv1)), r);
+	__m128 tx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2x, du1), _mm_mul_ps(e1x, du2)), r);
+	__m128 ty = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2y, du1), _mm_mul_ps(e1y, du2)), r);
+	__m128 tz = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e2z, du1), _mm_mul_ps(e1z, du2)), r);
+
+	__m128 s2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)), _mm_mul_ps(sz, sz));
+	__m128 t2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+	const __m128 zero = _mm_setzero_ps();
+	valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(s2, zero), _mm_cmpgt_ps(t2, zero)));
+
+	// 1/length of valid directions, 0 for the others
+	__m128 s_scale = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(_mm_or_ps(_mm_and_ps(valid, s2), _mm_andnot_ps(valid, one)))));
+	__m128 t_scale = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(_mm_or_ps(_mm_and_ps(valid, t2), _mm_andnot_ps(valid, one)))));
+
+	_mm_storeu_ps(&faces.sx[f], _mm_mul_ps(sx, s_scale));
+	_mm_storeu_ps(&faces.sy[f], _mm_mul_ps(sy, s_scale));
+	_mm_storeu_ps(&faces.sz[f], _mm_mul_ps(sz, s_scale));
+	_mm_storeu_ps(&faces.tx[f], _mm_mul_ps(tx, t_scale));
+	_mm_storeu_ps(&faces.ty[f], _mm_mul_ps(ty, t_scale));
+	_mm_storeu_ps(&faces.tz[f], _mm_mul_ps(tz, t_scale));
+}
+
+#endif
+
+//
+// Some unit vector perpendicular to n
+//
+inline vec3f any_perpendicular(const vec3f& n)
+{
+	vec3f axis = std::fabs(n.x) < 0.9f ? vec3f(1, 0, 0) : vec3f(0, 1, 0);
+	vec3f p = safe_normalize(n % axis);
+	return dot(p, p) > 0.0f ? p : vec3f(1, 0, 0);
+}
+
+void GenerateTangents(
+	std::vector<Vertex>& vertices,
+	const std::vector<unsigned>& indices,
+	unsigned max_threads)
+{
+	const size_t nbr_faces = indices.size() / 3;
+	const unsigned nbr_threads = parallel_thread_count(std::max(nbr_faces, vertices.size()), 1 << 16, max_threads);
+
+	// Pass 1: texture-space directions and corner weights per triangle
+	//
+	face_tangents_t faces;
+	faces.resize(nbr_faces);
+	parallel_ranges(nbr_faces, nbr_threads, [&](unsigned, size_t begin, size_t end)
+		{
+			size_t f = begin;
+#ifdef TANGENTS_SSE
+			for (; f + 4 <= end; f += 4)
+				FaceTangents4(vertices, indices, f, faces);
+#endif
+			for (; f < end; f++)
+				FaceTangents(vertices, indices, f, faces);
+
+			for (f = begin; f < end; f++)
+			{
+				if (faces.sx[f] == 0.0f && faces.sy[f] == 0.0f && faces.sz[f] == 0.0f)
+				{
+					faces.weight[0][f] = faces.weight[1][f] = faces.weight[2][f] = 0.0f;
+					continue;
+				}
+				const vec3f& p0 = vertices[indices[3 * f + 0]].Pos;
+				const vec3f& p1 = vertices[indices[3 * f + 1]].Pos;
+				const vec3f& p2 = vertices[indices[3 * f + 2]].Pos;
+				vec3f e01 = safe_normalize(p1 - p0), e02 = safe_normalize(p2 - p0), e12 = safe_normalize(p2 - p1);
+				faces.weight[0][f] = std::acos(std::max(-1.0f, std::min(1.0f, dot(e01, e02))));
+				faces.weight[1][f] = std::acos(std::max(-1.0f, std::min(1.0f, -dot(e01, e12))));
+				faces.weight[2][f] = std::max(0.0f, 3.141592653f - faces.weight[0][f] - faces.weight[1][f]);
+			}
+		});
+
+	// Vertex-to-corner table: the corners at vertex i are
+	// vertex_corners[vertex_offsets[i]] .. vertex_corners[vertex_offsets[i+1]-1],
+	// corner c being corner c % 3 of triangle c / 3
+	std::vector<unsigned> vertex_offsets(vertices.size() + 1, 0);
+	for (size_t c = 0; c < nbr_faces * 3; c++)
+		vertex_offsets[indices[c] + 1]++;
+	for (size_t i = 0; i < vertices.size(); i++)
+		vertex_offsets[i + 1] += vertex_offsets[i];
+
+	std::vector<unsigned> vertex_corners(vertex_offsets.back());
+	{
+		std::vector<unsigned> fill(vertex_offsets.begin(), vertex_offsets.end() - 1);
+		for (size_t c = 0; c < nbr_faces * 3; c++)
+			vertex_corners[fill[indices[c]]++] = (unsigned)c;
+	}
+
+	// Pass 2: each thread sums and orthonormalizes its own range of vertices
+	//
+	parallel_ranges(vertices.size(), nbr_threads, [&](unsigned, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Vertex& vertex = vertices[i];
+				const vec3f n = safe_normalize(vertex.Normal);
+
+				vec3f tangent = vec3f_zero, bitangent = vec3f_zero;
+				for (unsigned j = vertex_offsets[i]; j < vertex_offsets[i + 1]; j++)
+				{
+					const unsigned f = vertex_corners[j] / 3;
+					const float w = faces.weight[vertex_corners[j] % 3][f];
+					if (w == 0.0f) continue;
+
+					vec3f s = { faces.sx[f], faces.sy[f], faces.sz[f] };
+					vec3f t = { faces.tx[f], faces.ty[f], faces.tz[f] };
+					tangent += safe_normalize(s - n * dot(n, s)) * w;
+					bitangent += safe_normalize(t - n * dot(n, t)) * w;
+				}
+
+				tangent = safe_normalize(tangent - n * dot(n, tangent));
+				if (dot(tangent, tangent) == 0.0f)
+					tangent = any_perpendicular(n);
+
+				vec3f binormal = n % tangent;
+				if (dot(binormal, bitangent) < 0.0f)
+					binormal = -binormal;
+
+				vertex.Tangent = tangent;
+				vertex.Binormal = binormal;
+			}
+		});
+}
@@ -0,0 +1,36 @@
+//
+//  Tangents.h
+//
+//  Per-vertex tangent frames for normal mapping
+//
+
+#pragma once
+#ifndef TANGENTS_H
+#define TANGENTS_H
+
+#include <vector>
+#include "Drawcall.h"
+
+//
+// Generate Tangent and Binormal of indexed triangles from positions,
+// normals and texture coordinates
+//
+// Each triangle contributes its texture-space tangent and bitangent to its
+// three vertices, projected onto the tangent plane of the vertex normal and
+// weighted by corner angle. Per vertex, the sums are then orthonormalized
+// against the normal, and Binormal is set to cross(Normal, Tangent), flipped
+// to match the handedness of the mapping.
+//
+// Vertices are not split by handedness: a vertex shared by triangles with
+// mirrored texture coordinates averages opposing tangents, so mirrored UV
+// seams should have their vertices split in the mesh.
+//
+// Triangles with degenerate texture coordinates do not contribute. Vertices
+// left without a contribution get an arbitrary frame around their normal.
+//
+void GenerateTangents(
+	std::vector<Vertex>& vertices,
+	const std::vector<unsigned>& indices,
+	unsigned max_threads = 0);
+
+#endif
@@ -0,0 +1,185 @@
+//
+//  TransformHierarchy.cpp
+//
+//  Scene graph transforms, with cached world matrices
+//
+
+#include <cassert>
+#include <algorithm>
+#include "TransformHierarchy.h"
+#include "Parallel.h"
+
+const TransformHierarchy::NodeId TransformHierarchy::NoParent;
+
+// Smallest number of nodes worth a thread of its own
+static const size_t MinNodesPerThread = 1 << 13;
+
+// Share of dirty nodes (1/n) above which visiting every node in order beats
+// walking the subtrees in scattered order
+static const size_t DirtyShareForLevels = 16;
+
+//
+// T * R * S, with the scale applied to the columns of the rotation
+//
+static inline mat4f LocalMatrix(
+	const vec3f& t,
+	const quatf& r,
+	const vec3f& s)
+{
+	const mat3f R = r.to_mat3();
+	return mat4f(R.m11 * s.x, R.m12 * s.y, R.m13 * s.z, t.x,
+				 R.m21 * s.x, R.m22 * s.y, R.m23 * s.z, t.y,
+				 R.m31 * s.x, R.m32 * s.y, R.m33 * s.z, t.z,
+				 0,           0,           0,           1);
+}
+
+TransformHierarchy::NodeId TransformHierarchy::AddNode(
+	NodeId parent,
+	const vec3f& translation,
+	const quatf& rotation,
+	const vec3f& scale)
+{
+	assert(parent == NoParent || parent < Size());
+	const NodeId node = (NodeId)Size();
+	const unsigned node_depth = parent == NoParent ? 0 : depth[parent] + 1;
+
+	this->parent.push_back(parent);
+	first_child.push_back(NoParent);
+	next_sibling.push_back(NoParent);
+	if (parent != NoParent)
+	{
+		next_sibling[node] = first_child[parent];
+		first_child[parent] = node;
+	}
+
+	this->translation.push_back(translation);
+	this->rotation.push_back(rotation);
+	this->scale.push_back(scale);
+	world.push_back(mat4f_identity);
+	dirty.push_back(0);
+	updated_at.push_back(~0u);
+	depth.push_back(node_depth);
+
+	if (levels.size() <= node_depth)
+		levels.resize(node_depth + 1);
+	levels[node_depth].push_back(node);
+
+	MarkDirty(node);
+	return node;
+}
+
+void TransformHierarchy::MarkDirty(NodeId node)
+{
+	if (!dirty[node])
+	{
+		dirty[node] = 1;
+		dirty_nodes.push_back(node);
+	}
+}
+
+void TransformHierarchy::SetTranslation(NodeId node, const vec3f& translation)
+{
+	this->translation[node] = translation;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetRotation(NodeId node, const quatf& rotation)
+{
+	this->rotation[node] = rotation;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetScale(NodeId node, const vec3f& scale)
+{
+	this->scale[node] = scale;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::ComputeWorld(NodeId node)
+{
+	const NodeId p = parent[node];
+	const mat4f local = LocalMatrix(translation[node], rotation[node], scale[node]);
+	world[node] = p == NoParent ? local : world[p] * local;
+	updated_at[node] = update_count;
+}
+
+size_t TransformHierarchy::UpdateSubtrees()
+{
+	// Ancestors have lower ids than their descendants, so in id order a
+	// dirty node below another dirty node is reached by the walk from the
+	// upper one before its own turn, and is then skipped
+	std::sort(dirty_nodes.begin(), dirty_nodes.end());
+
+	size_t nbr_updated = 0;
+	std::vector<NodeId> stack;
+	for (NodeId root : dirty_nodes)
+	{
+		if (updated_at[root] == update_count)
+			continue;
+
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			const NodeId node = stack.back();
+			stack.pop_back();
+
+			ComputeWorld(node);
+			nbr_updated++;
+
+			for (NodeId child = first_child[node]; child != NoParent; child = next_sibling[child])
+				stack.push_back(child);
+		}
+	}
+	return nbr_updated;
+}
+
+size_t TransformHierarchy::UpdateLevels(unsigned max_threads)
+{
+	auto update_node = [this](NodeId node) -> size_t
+	{
+		const NodeId p = parent[node];
+		if (!dirty[node] && (p == NoParent || updated_at[p] != update_count))
+			return 0;
+		ComputeWorld(node);
+		return 1;
+	};
+
+	size_t nbr_updated = 0;
+	for (const auto& level : levels)
+	{
+		const unsigned nbr_threads = parallel_thread_count(level.size(), MinNodesPerThread, max_threads);
+		if (nbr_threads <= 1)
+		{
+			for (NodeId node : level)
+				nbr_updated += update_node(node);
+			continue;
+		}
+
+		std::vector<size_t> thread_updated(nbr_threads, 0);
+		parallel_ranges(level.size(), nbr_threads, [&](unsigned t, size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+					thread_updated[t] += update_node(level[i]);
+			});
+		for (size_t count : thread_updated)
+			nbr_updated += count;
+	}
+	return nbr_updated;
+}
+
+size_t TransformHierarchy::Update(unsigned max_threads)
+{
+	// A new update count also clears WorldChanged for all nodes
+	update_count++;
+	if (dirty_nodes.empty())
+		return 0;
+
+	const bool many_dirty = dirty_nodes.size() * DirtyShareForLevels >= Size();
+	const size_t nbr_updated = many_dirty ? UpdateLevels(max_threads) : UpdateSubtrees();
+
+	for (NodeId node : dirty_nodes)
+		dirty[node] = 0;
+	dirty_nodes.clear();
+
+	return nbr_updated;
+}
@@ -0,0 +1,111 @@
+//
+//  TransformHierarchy.h
+//
+//  Scene graph transforms, with cached world matrices
+//
+
+#pragma once
+#ifndef TRANSFORMHIERARCHY_H
+#define TRANSFORMHIERARCHY_H
+
+#include <vector>
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/quat.h"
+
+using namespace linalg;
+
+//
+// Transform hierarchy
+//
+// Nodes hold a local translation, rotation and scale (applied as T*R*S) and
+// a cached world matrix, world = parent world * local. Node data is stored
+// as parallel arrays indexed by node id. A parent is always added before its
+// children, so id order is a topological order, and one pass over the arrays
+// in order updates every world matrix after its parent's.
+//
+// Setting a local transform marks the node dirty. Update recomputes the
+// world matrices of dirty nodes and their descendants only, by walking the
+// subtrees below the dirty nodes; a clean hierarchy costs nothing. When many
+// nodes are dirty, all nodes are instead visited one depth level at a time,
+// with each level split over threads if it is large enough to gain from
+// it, since the nodes of a level only depend on the level above.
+//
+class TransformHierarchy
+{
+public:
+	typedef unsigned NodeId;
+	static const NodeId NoParent = ~0u;
+
+	//
+	// Add a node below parent (NoParent for a root), which must already exist
+	//
+	NodeId AddNode(
+		NodeId parent = NoParent,
+		const vec3f& translation = { 0, 0, 0 },
+		const quatf& rotation = quatf(),
+		const vec3f& scale = { 1, 1, 1 });
+
+	void SetTranslation(NodeId node, const vec3f& translation);
+	void SetRotation(NodeId node, const quatf& rotation);
+	void SetScale(NodeId node, const vec3f& scale);
+
+	const vec3f& GetTranslation(NodeId node) const { return translation[node]; }
+	const quatf& GetRotation(NodeId node) const { return rotation[node]; }
+	const vec3f& GetScale(NodeId node) const { return scale[node]; }
+	NodeId GetParent(NodeId node) const { return parent[node]; }
+
+	//
+	// World matrix as of the last Update
+	//
+	const mat4f& GetWorldMatrix(NodeId node) const { return world[node]; }
+
+	//
+	// Whether the world matrix of node changed in the last Update
+	//
+	bool WorldChanged(NodeId node) const { return updated_at[node] == update_count; }
+
+	//
+	// Recompute the world matrices of dirty nodes and their descendants.
+	// max_threads = 0 means the hardware concurrency (see Parallel.h).
+	// Returns the number of recomputed nodes
+	//
+	size_t Update(unsigned max_threads = 0);
+
+	size_t Size() const { return parent.size(); }
+
+private:
+	// Per node, indexed by id
+	std::vector<NodeId> parent;
+	std::vector<NodeId> first_child;
+	std::vector<NodeId> next_sibling;
+	std::vector<vec3f> translation;
+	std::vector<quatf> rotation;
+	std::vector<vec3f> scale;
+	std::vector<mat4f> world;
+	std::vector<unsigned char> dirty;	// local transform set since the last Update
+	std::vector<unsigned> updated_at;	// update_count of the last Update that recomputed the world matrix
+	std::vector<unsigned> depth;
+
+	// Nodes set since the last Update, each once
+	std::vector<NodeId> dirty_nodes;
+
+	// Node ids per depth level, for parallel updates
+	std::vector<std::vector<NodeId>> levels;
+
+	// Number of Update calls
+	unsigned update_count = 0;
+
+	void MarkDirty(NodeId node);
+
+	// world = parent world * local
+	void ComputeWorld(NodeId node);
+
+	// Walk the subtrees below the dirty nodes
+	size_t UpdateSubtrees();
+
+	// Visit every node, level by level, each level in parallel
+	size_t UpdateLevels(unsigned max_threads);
+};
+
+#endif
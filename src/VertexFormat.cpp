@@ -0,0 +1,217 @@
+//
+//  VertexFormat.cpp
+//
+//  Compact GPU vertex layout and its CPU encoder/decoder
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "VertexFormat.h"
+#include "Parallel.h"
+
+using namespace linalg;
+
+const D3D11_INPUT_ELEMENT_DESC VertexLayout[5] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEX", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 48, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+const D3D11_INPUT_ELEMENT_DESC PackedVertexLayout[4] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEX", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+uint16_t FloatToHalf(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, 4);
+
+	const uint32_t sign = (x >> 16) & 0x8000;
+	const uint32_t abs = x & 0x7fffffff;
+
+	// NaN stays NaN, overflow and Inf become Inf
+	if (abs > 0x7f800000)
+		return (uint16_t)(sign | 0x7e00);
+	if (abs >= 0x477ff000)
+		return (uint16_t)(sign | 0x7c00);
+
+	// Normal range, round mantissa to nearest even
+	if (abs >= 0x38800000)
+	{
+		uint32_t h = (abs - 0x38000000) >> 13;
+		uint32_t rest = abs & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+			h++;
+		return (uint16_t)(sign | h);
+	}
+
+	// Subnormal range, shift the mantissa with implicit bit into place
+	if (abs < 0x33000000)
+		return (uint16_t)sign;
+	const uint32_t exponent = abs >> 23;
+	const uint32_t mantissa = (abs & 0x7fffff) | 0x800000;
+	const uint32_t shift = 126 - exponent;
+	uint32_t h = mantissa >> shift;
+	const uint32_t rest = mantissa & ((1u << shift) - 1);
+	const uint32_t half = 1u << (shift - 1);
+	if (rest > half || (rest == half && (h & 1)))
+		h++;
+	return (uint16_t)(sign | h);
+}
+
+float HalfToFloat(uint16_t h)
+{
+	const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	const uint32_t exponent = (h >> 10) & 0x1f;
+	const uint32_t mantissa = h & 0x3ff;
+
+	uint32_t x;
+	if (exponent == 0x1f)
+		x = sign | 0x7f800000 | (mantissa << 13);
+	else if (exponent)
+		x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else
+	{
+		float f = std::ldexp((float)mantissa, -24);
+		return sign ? -f : f;
+	}
+
+	float f;
+	memcpy(&f, &x, 4);
+	return f;
+}
+
+vec2f OctEncode(const vec3f& n)
+{
+	const float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	if (l1 == 0.0f)
+		return { 0.0f, 0.0f };
+
+	vec2f e = { n.x / l1, n.y / l1 };
+	if (n.z < 0.0f)
+	{
+		// fold the lower hemisphere over the diagonals
+		vec2f folded = {
+			(1.0f - std::fabs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::fabs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f) };
+		e = folded;
+	}
+	return e;
+}
+
+vec3f OctDecode(const vec2f& e)
+{
+	vec3f n = { e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y) };
+	const float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+static inline uint16_t QuantizeUnorm16(float x)
+{
+	return (uint16_t)(std::min(std::max(x, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+static inline int16_t QuantizeSnorm16(float x)
+{
+	return (int16_t)std::floor(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f + 0.5f);
+}
+
+static inline float DequantizeSnorm16(int16_t x)
+{
+	return std::max(x / 32767.0f, -1.0f);
+}
+
+VertexQuantization ComputeVertexQuantization(
+	const Vertex* vertices,
+	size_t nbr_vertices)
+{
+	vec3f lo = { FLT_MAX, FLT_MAX, FLT_MAX };
+	vec3f hi = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i < nbr_vertices; i++)
+	{
+		const vec3f& p = vertices[i].Pos;
+		lo = { std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z) };
+		hi = { std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z) };
+	}
+	if (!nbr_vertices)
+		lo = hi = vec3f_zero;
+
+	VertexQuantization quantization;
+	quantization.PositionScale = (hi - lo).xyz0();
+	quantization.PositionOffset = lo.xyz1();
+	return quantization;
+}
+
+PackedVertex PackVertex(
+	const Vertex& vertex,
+	const VertexQuantization& quantization)
+{
+	PackedVertex packed;
+
+	const float* scale = &quantization.PositionScale.x;
+	const float* offset = &quantization.PositionOffset.x;
+	const float* pos = &vertex.Pos.x;
+	for (int i = 0; i < 3; i++)
+		packed.Pos[i] = scale[i] > 0.0f ? QuantizeUnorm16((pos[i] - offset[i]) / scale[i]) : 0;
+
+	// Binormal sign relative to the frame rebuilt by the shader
+	const bool flipped = dot(vertex.Normal % vertex.Tangent, vertex.Binormal) < 0.0f;
+	packed.Pos[3] = flipped ? 0 : 65535;
+
+	vec2f n = OctEncode(vertex.Normal), t = OctEncode(vertex.Tangent);
+	packed.Normal[0] = QuantizeSnorm16(n.x);
+	packed.Normal[1] = QuantizeSnorm16(n.y);
+	packed.Tangent[0] = QuantizeSnorm16(t.x);
+	packed.Tangent[1] = QuantizeSnorm16(t.y);
+
+	packed.TexCoord[0] = FloatToHalf(vertex.TexCoord.x);
+	packed.TexCoord[1] = FloatToHalf(vertex.TexCoord.y);
+	return packed;
+}
+
+Vertex UnpackVertex(
+	const PackedVertex& packed,
+	const VertexQuantization& quantization)
+{
+	Vertex vertex;
+
+	const float* scale = &quantization.PositionScale.x;
+	const float* offset = &quantization.PositionOffset.x;
+	float* pos = &vertex.Pos.x;
+	for (int i = 0; i < 3; i++)
+		pos[i] = offset[i] + packed.Pos[i] / 65535.0f * scale[i];
+
+	vertex.Normal = OctDecode({ DequantizeSnorm16(packed.Normal[0]), DequantizeSnorm16(packed.Normal[1]) });
+	vertex.Tangent = OctDecode({ DequantizeSnorm16(packed.Tangent[0]), DequantizeSnorm16(packed.Tangent[1]) });
+	vertex.Binormal = (vertex.Normal % vertex.Tangent) * (packed.Pos[3] ? 1.0f : -1.0f);
+
+	vertex.TexCoord = { HalfToFloat(packed.TexCoord[0]), HalfToFloat(packed.TexCoord[1]) };
+	return vertex;
+}
+
+void PackVertices(
+	const Vertex* vertices,
+	size_t nbr_vertices,
+	std::vector<PackedVertex>& packed,
+	VertexQuantization& quantization)
+{
+	quantization = ComputeVertexQuantization(vertices, nbr_vertices);
+
+	packed.resize(nbr_vertices);
+	parallel_ranges(nbr_vertices, parallel_thread_count(nbr_vertices, 1 << 16), [&](unsigned, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				packed[i] = PackVertex(vertices[i], quantization);
+		});
+}
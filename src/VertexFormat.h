@@ -0,0 +1,95 @@
+//
+//  VertexFormat.h
+//
+//  Compact GPU vertex layout and its CPU encoder/decoder
+//
+
+#pragma once
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <cstdint>
+#include <vector>
+#include "Drawcall.h"
+
+// Upload vertices as PackedVertex (20 bytes) instead of Vertex (56 bytes).
+// Switches the input layout in Main.cpp to PackedVertexLayout and the vertex
+// shaders to shaders/vertex_shader_packed.hlsl (and _instanced_packed.hlsl).
+// Positions are always quantized in the packed format, there is no layout with
+// float positions and packed attributes; leave this undefined for full precision
+#define VERTEX_FORMAT_PACKED
+
+//
+// Packed vertex
+//
+// Pos		R16G16B16A16_UNORM	xyz relative to the AABB of the mesh, see VertexQuantization.
+//								w is the binormal sign, 1 for +cross(Normal, Tangent), 0 for -
+// Normal	R16G16_SNORM		octahedral unit vector
+// Tangent	R16G16_SNORM		octahedral unit vector
+// TexCoord	R16G16_FLOAT
+//
+struct PackedVertex
+{
+	uint16_t Pos[4];
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	uint16_t TexCoord[2];
+};
+
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must match PackedVertexLayout");
+
+//
+// Input layouts of Vertex and PackedVertex, in vertex buffer slot 0
+//
+extern const D3D11_INPUT_ELEMENT_DESC VertexLayout[5];
+extern const D3D11_INPUT_ELEMENT_DESC PackedVertexLayout[4];
+
+//
+// Dequantization of packed positions, Pos = PositionOffset + PackedPos * PositionScale
+// Doubles as the shader constant buffer (register b1 of the packed vertex shader)
+//
+struct VertexQuantization
+{
+	vec4f PositionScale;
+	vec4f PositionOffset;
+};
+
+//
+// Scalar encoders/decoders
+//
+uint16_t FloatToHalf(float f);
+float HalfToFloat(uint16_t h);
+
+// Unit vector to/from the [-1,1]^2 octahedral square
+vec2f OctEncode(const vec3f& n);
+vec3f OctDecode(const vec2f& e);
+
+//
+// Quantization covering the AABB of the vertices
+//
+VertexQuantization ComputeVertexQuantization(
+	const Vertex* vertices,
+	size_t nbr_vertices);
+
+PackedVertex PackVertex(
+	const Vertex& vertex,
+	const VertexQuantization& quantization);
+
+//
+// Inverse of PackVertex. Binormal is rebuilt from Normal, Tangent and the sign,
+// as the packed vertex shader does
+//
+Vertex UnpackVertex(
+	const PackedVertex& packed,
+	const VertexQuantization& quantization);
+
+//
+// Pack a vertex array, computing its quantization
+//
+void PackVertices(
+	const Vertex* vertices,
+	size_t nbr_vertices,
+	std::vector<PackedVertex>& packed,
+	VertexQuantization& quantization);
+
+#endif
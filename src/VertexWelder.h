@@ -0,0 +1,133 @@
+//
+//  VertexWelder.h
+//
+//  Map from OBJ index triplets to welded vertex indices
+//
+
+#pragma once
+#ifndef VERTEXWELDER_H
+#define VERTEXWELDER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "vec/vec.h"
+
+using linalg::int3;
+
+//
+// Open-addressing map from (position, normal, texcoord) index triplets
+// to welded vertex indices
+//
+// Each key is first tried in a home slot given by its position index, and
+// otherwise by linear probing from a hash of the whole key. The power-of-two
+// table is kept at most half full. The slot array is allocated once and reused
+// for all drawcalls; clearing it only touches the part sized for the current
+// drawcall
+//
+struct vertex_welder_t
+{
+	struct slot_t
+	{
+		int3 key;
+		unsigned index;
+	};
+
+	static const unsigned Empty = ~0u;
+
+	std::vector<slot_t> slots;
+	size_t capacity = 0;
+	size_t mask = 0;
+	size_t count = 0;
+
+	static size_t hash(const int3& key)
+	{
+		uint64_t h = (uint32_t)key.x;
+		h = h * 0x9e3779b97f4a7c15ull + (uint32_t)key.y;
+		h = h * 0x9e3779b97f4a7c15ull + (uint32_t)key.z;
+		h ^= h >> 32; h *= 0xd6e8feb86659fd93ull;
+		h ^= h >> 32;
+		return (size_t)h;
+	}
+
+	//
+	// Empty the map, sized for about expected_count unique keys
+	//
+	void Clear(size_t expected_count)
+	{
+		capacity = 16;
+		while (capacity < expected_count * 2)
+			capacity *= 2;
+		if (slots.size() < capacity)
+			slots.resize(capacity);
+
+		std::fill(slots.begin(), slots.begin() + capacity, slot_t{ { 0, 0, 0 }, Empty });
+		mask = capacity - 1;
+		count = 0;
+	}
+
+	//
+	// Look up key. If it is new, map it to new_index and return true.
+	// index receives the index the key is mapped to either way
+	//
+	bool Insert(const int3& key, unsigned new_index, unsigned& index)
+	{
+		if ((count + 1) * 2 > capacity)
+			Grow();
+
+		// home slot, spaced by position so that meshes with coherent
+		// indices look up nearby slots
+		slot_t& home = slots[((size_t)key.x * 2) & mask];
+		if (home.index == Empty)
+		{
+			home = { key, new_index };
+			count++;
+			index = new_index;
+			return true;
+		}
+		if (home.key.x == key.x && home.key.y == key.y && home.key.z == key.z)
+		{
+			index = home.index;
+			return false;
+		}
+
+		// taken, e.g. by another attribute combo of the same position:
+		// probe from a hash of all three indices, so that positions on
+		// many seams do not pile up in one cluster
+		for (size_t i = hash(key) & mask;; i = (i + 1) & mask)
+		{
+			slot_t& slot = slots[i];
+			if (slot.index == Empty)
+			{
+				slot = { key, new_index };
+				count++;
+				index = new_index;
+				return true;
+			}
+			if (slot.key.x == key.x && slot.key.y == key.y && slot.key.z == key.z)
+			{
+				index = slot.index;
+				return false;
+			}
+		}
+	}
+
+	void Grow()
+	{
+		std::vector<slot_t> old(slots.begin(), slots.begin() + capacity);
+
+		capacity *= 2;
+		if (slots.size() < capacity)
+			slots.resize(capacity);
+		std::fill(slots.begin(), slots.begin() + capacity, slot_t{ { 0, 0, 0 }, Empty });
+		mask = capacity - 1;
+
+		unsigned index;
+		count = 0;
+		for (const slot_t& slot : old)
+			if (slot.index != Empty)
+				Insert(slot.key, slot.index, index);
+	}
+};
+
+#endif
@@ -9,6 +9,7 @@
 #ifndef parseutil_h
 #define parseutil_h
 
+#include <cmath>
 #include <string>
 #include <vector>
 
@@ -73,4 +74,108 @@ static bool find_filename_from_suffixes(const std::string &str, const std::vecto
 	return false;
 }
 
+//
+// In-place tokenizing of a [p, end) character range
+// The parse_* functions advance p past what they consume and never allocate
+//
+inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skip_blanks(const char* p, const char* end)
+{
+    while (p < end && is_blank(*p)) p++;
+    return p;
+}
+
+inline const char* skip_token(const char* p, const char* end)
+{
+    while (p < end && !is_blank(*p) && *p != '\n') p++;
+    return p;
+}
+
+//
+// match a keyword followed by a blank, e.g. "usemtl", and skip past both
+//
+inline bool parse_keyword(const char*& p, const char* end, const char* keyword)
+{
+    const char* q = p;
+    while (*keyword)
+    {
+        if (q == end || *q != *keyword) return false;
+        q++; keyword++;
+    }
+    if (q < end && !is_blank(*q)) return false;
+    p = skip_blanks(q, end);
+    return true;
+}
+
+inline bool parse_int(const char*& p, const char* end, int& res)
+{
+    const char* q = skip_blanks(p, end);
+    bool neg = false;
+    if (q < end && (*q == '-' || *q == '+')) neg = (*q++ == '-');
+    if (q == end || (unsigned)(*q - '0') > 9) return false;
+
+    int i = 0;
+    while (q < end && (unsigned)(*q - '0') <= 9)
+        i = i * 10 + (*q++ - '0');
+
+    res = neg ? -i : i;
+    p = q;
+    return true;
+}
+
+//
+// decimal float with optional fraction and exponent, e.g. -1.25e-3
+// digits beyond the 19th are dropped, which is far below float precision
+//
+inline bool parse_float(const char*& p, const char* end, float& res)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char* q = skip_blanks(p, end);
+    bool neg = false;
+    if (q < end && (*q == '-' || *q == '+')) neg = (*q++ == '-');
+
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+    for (; q < end && (unsigned)(*q - '0') <= 9; q++, any = true)
+    {
+        if (digits < 19) { mantissa = mantissa * 10 + (*q - '0'); if (mantissa) digits++; }
+        else exponent++;
+    }
+    if (q < end && *q == '.')
+    {
+        for (q++; q < end && (unsigned)(*q - '0') <= 9; q++, any = true)
+            if (digits < 19) { mantissa = mantissa * 10 + (*q - '0'); if (mantissa) digits++; exponent--; }
+    }
+    if (!any) return false;
+
+    if (q + 1 < end && (*q == 'e' || *q == 'E') && !is_blank(q[1]))
+    {
+        const char* e = q + 1;
+        int exp10;
+        if (parse_int(e, end, exp10))
+        {
+            exponent += exp10;
+            q = e;
+        }
+    }
+
+    double d = (double)mantissa;
+    if (exponent < 0)
+        d = exponent >= -22 ? d / pow10[-exponent] : d * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        d = exponent <= 22 ? d * pow10[exponent] : d * std::pow(10.0, exponent);
+
+    res = (float)(neg ? -d : d);
+    p = q;
+    return true;
+}
+
 #endif /* parseutil_h */
@@ -300,6 +300,19 @@ void bind_shader(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, sha
 	}
 }
 
+void get_shader_objects(const shader_data* pShader, ID3D11VertexShader** ppVertexShader, ID3D11InputLayout** ppInputLayout, ID3D11PixelShader** ppPixelShader)
+{
+	const BOOL vertex = pShader != NULL && pShader->type == SHADER_VERTEX;
+	const BOOL pixel = pShader != NULL && pShader->type == SHADER_PIXEL;
+
+	if (ppVertexShader)
+		*ppVertexShader = vertex ? pShader->vetex_shader : NULL;
+	if (ppInputLayout)
+		*ppInputLayout = vertex ? pShader->input_layout : NULL;
+	if (ppPixelShader)
+		*ppPixelShader = pixel ? pShader->pixel_shader : NULL;
+}
+
 #ifdef _MSC_VER
 #pragma warning( pop ) 
 #endif
\ No newline at end of file
@@ -1,8 +1,11 @@
 #ifndef _STDAFX__H
 #define _STDAFX__H
 
+// Keep windows.h from defining min and max macros, which break std::min/max
+#define NOMINMAX
 #include <windows.h>
 #include <D3D11.h>
+#include <d3d11_1.h>
 #include <d3dCompiler.h>
 #include <dinput.h>
 
@@ -0,0 +1,132 @@
+//
+//	frustum.cpp
+//
+//  Batch visibility tests of bounding volumes against frustum planes
+//
+
+#include "frustum.h"
+
+namespace linalg
+{
+	void transform_planes(const mat4f& M, const vec4f* in, vec4f* out, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			const vec4f P = in[i];
+			out[i] = vec4f(dot(M.col[0], P), dot(M.col[1], P), dot(M.col[2], P), dot(M.col[3], P));
+		}
+	}
+
+#ifdef LINALG_SSE
+	//
+	// The 6 planes transposed into two groups of 4, with the last two
+	// padded by (0, 0, 0, 1) which nothing is outside of. Each volume is
+	// tested against 4 planes per instruction
+	//
+	struct planes_sse_t
+	{
+		__m128 nx[2], ny[2], nz[2], d[2];
+		__m128 anx[2], any[2], anz[2];	// |normal|, for box extents
+
+		planes_sse_t(const vec4f* planes)
+		{
+			const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+			const vec4f pad(0, 0, 0, 1);
+			for (int k = 0; k < 2; k++)
+			{
+				__m128 p0 = _mm_loadu_ps(&planes[k * 4].x);
+				__m128 p1 = _mm_loadu_ps(&planes[k * 4 + 1].x);
+				__m128 p2 = _mm_loadu_ps(k ? &pad.x : &planes[2].x);
+				__m128 p3 = _mm_loadu_ps(k ? &pad.x : &planes[3].x);
+				_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+				nx[k] = p0; ny[k] = p1; nz[k] = p2; d[k] = p3;
+				anx[k] = _mm_and_ps(p0, abs_mask);
+				any[k] = _mm_and_ps(p1, abs_mask);
+				anz[k] = _mm_and_ps(p2, abs_mask);
+			}
+		}
+	};
+#endif
+
+	size_t cull_aabbs(const vec4f* frustum_planes, const aabb3f* boxes, bool* visible, size_t n)
+	{
+		size_t nbr_visible = 0;
+#ifdef LINALG_SSE
+		const planes_sse_t P(frustum_planes);
+		for (size_t i = 0; i < n; i++)
+		{
+			// Center and extent, a box is outside a plane when
+			// dot(n, c) + d < -dot(|n|, e)
+			const aabb3f& box = boxes[i];
+			const __m128 cx = _mm_set1_ps((box.min.x + box.max.x) * 0.5f), ex = _mm_set1_ps((box.max.x - box.min.x) * 0.5f);
+			const __m128 cy = _mm_set1_ps((box.min.y + box.max.y) * 0.5f), ey = _mm_set1_ps((box.max.y - box.min.y) * 0.5f);
+			const __m128 cz = _mm_set1_ps((box.min.z + box.max.z) * 0.5f), ez = _mm_set1_ps((box.max.z - box.min.z) * 0.5f);
+
+			__m128 outside = _mm_setzero_ps();
+			for (int k = 0; k < 2; k++)
+			{
+				const __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(P.nx[k], cx), _mm_mul_ps(P.ny[k], cy)), _mm_add_ps(_mm_mul_ps(P.nz[k], cz), P.d[k]));
+				const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(P.anx[k], ex), _mm_mul_ps(P.any[k], ey)), _mm_mul_ps(P.anz[k], ez));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+			}
+			visible[i] = _mm_movemask_ps(outside) == 0;
+			nbr_visible += visible[i];
+		}
+#else
+		for (size_t i = 0; i < n; i++)
+		{
+			const vec3f c = (boxes[i].min + boxes[i].max) * 0.5f;
+			const vec3f e = (boxes[i].max - boxes[i].min) * 0.5f;
+			bool inside = true;
+			for (int k = 0; k < FrustumPlaneCount && inside; k++)
+			{
+				const vec4f& p = frustum_planes[k];
+				const float dist = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+				const float radius = std::abs(p.x) * e.x + std::abs(p.y) * e.y + std::abs(p.z) * e.z;
+				inside = dist + radius >= 0;
+			}
+			visible[i] = inside;
+			nbr_visible += inside;
+		}
+#endif
+		return nbr_visible;
+	}
+
+	size_t cull_spheres(const vec4f* frustum_planes, const vec4f* spheres, bool* visible, size_t n)
+	{
+		size_t nbr_visible = 0;
+#ifdef LINALG_SSE
+		const planes_sse_t P(frustum_planes);
+		for (size_t i = 0; i < n; i++)
+		{
+			// Outside when dot(n, c) + d < -r
+			const __m128 s = _mm_loadu_ps(&spheres[i].x);
+			const __m128 cx = LINALG_SWIZZLE(s, 0, 0, 0, 0), cy = LINALG_SWIZZLE(s, 1, 1, 1, 1);
+			const __m128 cz = LINALG_SWIZZLE(s, 2, 2, 2, 2), r = LINALG_SWIZZLE(s, 3, 3, 3, 3);
+
+			__m128 outside = _mm_setzero_ps();
+			for (int k = 0; k < 2; k++)
+			{
+				const __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(P.nx[k], cx), _mm_mul_ps(P.ny[k], cy)), _mm_add_ps(_mm_mul_ps(P.nz[k], cz), P.d[k]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, r), _mm_setzero_ps()));
+			}
+			visible[i] = _mm_movemask_ps(outside) == 0;
+			nbr_visible += visible[i];
+		}
+#else
+		for (size_t i = 0; i < n; i++)
+		{
+			const vec4f& s = spheres[i];
+			bool inside = true;
+			for (int k = 0; k < FrustumPlaneCount && inside; k++)
+			{
+				const vec4f& p = frustum_planes[k];
+				inside = p.x * s.x + p.y * s.y + p.z * s.z + p.w + s.w >= 0;
+			}
+			visible[i] = inside;
+			nbr_visible += inside;
+		}
+#endif
+		return nbr_visible;
+	}
+}
@@ -0,0 +1,60 @@
+//
+//	frustum.h
+//
+//  Batch visibility tests of bounding volumes against frustum planes
+//
+
+#pragma once
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <cstddef>
+#include "vec.h"
+#include "mat.h"
+#include "transform.h"
+
+namespace linalg
+{
+	//
+	// Planes P are (normal, d), with a point p on the inside when
+	// dot(P.xyz(), p) + P.w >= 0. They do not need to be normalized.
+	// A frustum is 6 such planes, see Camera::get_FrustumPlanes
+	//
+
+	static const int FrustumPlaneCount = 6;
+
+	//
+	// Planes in the space M transforms from, out[i] = transpose(M) * in[i].
+	// Testing model space bounds against the transformed planes equals
+	// testing the transformed bounds against the planes, without
+	// transforming every box. in and out may be the same array
+	//
+	void transform_planes(
+		const mat4f& M,
+		const vec4f* in,
+		vec4f* out,
+		size_t n);
+
+	//
+	// visible[i] = false if box i is entirely outside one of the frustum
+	// planes. Conservative: boxes outside the frustum but crossing every
+	// plane are kept. Returns the number of visible boxes
+	//
+	size_t cull_aabbs(
+		const vec4f* frustum_planes,
+		const aabb3f* boxes,
+		bool* visible,
+		size_t n);
+
+	//
+	// As cull_aabbs, for spheres (center.xyz, radius). The radii are in the
+	// units of the normals, i.e. the planes should be normalized
+	//
+	size_t cull_spheres(
+		const vec4f* frustum_planes,
+		const vec4f* spheres,
+		bool* visible,
+		size_t n);
+}
+
+#endif /* FRUSTUM_H */
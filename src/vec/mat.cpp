@@ -46,6 +46,9 @@ namespace linalg
     {
         return col[0]*v.x + col[1]*v.y + col[2]*v.z + col[3]*v.w;
     }
+#ifndef LINALG_SSE
     // explicit template specialisation for <float>
+    // (with LINALG_SSE, the <float> version is the inline one in mat.h)
     template vec4<float> mat4<float>::operator *(const vec4<float> &v) const;
+#endif
 }
\ No newline at end of file
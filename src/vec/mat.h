@@ -294,7 +294,7 @@ namespace linalg
 	//
 	// 4D column-major matrix
 	//
-    template<class T> class mat4
+    template<class T> class LINALG_ALIGN mat4
     {
     public:
         union
@@ -558,7 +558,7 @@ namespace linalg
 			const T sing = sin(pitch);
 			const T cosg = cos(pitch);
 
-			return mat4<T>(	cosa*cosb, cosa*sinb*sing - sina*cosg, cosa*sinb*cosg - sina*sing, 0,
+			return mat4<T>(	cosa*cosb, cosa*sinb*sing - sina*cosg, cosa*sinb*cosg + sina*sing, 0,
 							sina*cosb, sina*sinb*sing + cosa*cosg, sina*sinb*cosg - cosa*sing, 0,
 							-sinb, cosb*sing, cosb*cosg, 0,
 							0, 0, 0, 1);
@@ -659,6 +659,253 @@ namespace linalg
 		return n;
     }
     
+    //
+    // Inverse of an affine matrix, | A t |^-1 = | A^-1 -A^-1*t |
+    //                              | 0 1 |      | 0     1      |
+    // i.e. the bottom row is assumed to be (0, 0, 0, 1).
+    // A^-1 is the transposed cofactor matrix of A, which for columns
+    // a0, a1, a2 has rows a1 x a2, a2 x a0 and a0 x a1, over det(A)
+    //
+    template<class T>
+    inline mat4<T> inverse_affine(const mat4<T>& m)
+    {
+        const vec3<T> a0 = m.col[0].xyz(), a1 = m.col[1].xyz(), a2 = m.col[2].xyz();
+        const vec3<T> r0 = a1 % a2, r1 = a2 % a0, r2 = a0 % a1;
+        const T det = dot(a0, r0);
+        assert(std::abs(det) > 1e-8);
+        const T idet = (T)1.0 / det;
+        
+        mat4<T> M(r0.x * idet, r0.y * idet, r0.z * idet, 0,
+                  r1.x * idet, r1.y * idet, r1.z * idet, 0,
+                  r2.x * idet, r2.y * idet, r2.z * idet, 0,
+                  0,           0,           0,           1);
+        const vec4<T> t = m.col[3];
+        M.col[3] = vec4<T>(-(M.m11 * t.x + M.m12 * t.y + M.m13 * t.z),
+                           -(M.m21 * t.x + M.m22 * t.y + M.m23 * t.z),
+                           -(M.m31 * t.x + M.m32 * t.y + M.m33 * t.z), 1);
+        return M;
+    }
+    
+    //
+    // Inverse of a rigid matrix (rotation and translation only),
+    // | R t |^-1 = | R^T -R^T*t |
+    // | 0 1 |      | 0    1     |
+    //
+    template<class T>
+    inline mat4<T> inverse_rigid(const mat4<T>& m)
+    {
+        mat4<T> M(m.m11, m.m21, m.m31, 0,
+                  m.m12, m.m22, m.m32, 0,
+                  m.m13, m.m23, m.m33, 0,
+                  0,     0,     0,     1);
+        const vec4<T> t = m.col[3];
+        M.col[3] = vec4<T>(-(M.m11 * t.x + M.m12 * t.y + M.m13 * t.z),
+                           -(M.m21 * t.x + M.m22 * t.y + M.m23 * t.z),
+                           -(M.m31 * t.x + M.m32 * t.y + M.m33 * t.z), 1);
+        return M;
+    }
+    
+#ifdef LINALG_SSE
+    //
+    // SSE specializations for mat4<float>
+    //
+    namespace sse
+    {
+        //
+        // 2x2 matrices (a11, a12, a21, a22) in one register
+        //
+        
+        // A * B
+        inline __m128 mat2_mul(__m128 a, __m128 b)
+        {
+            return _mm_add_ps(_mm_mul_ps(a, LINALG_SWIZZLE(b, 0, 3, 0, 3)),
+                              _mm_mul_ps(LINALG_SWIZZLE(a, 1, 0, 3, 2), LINALG_SWIZZLE(b, 2, 1, 2, 1)));
+        }
+        
+        // adjugate(A) * B
+        inline __m128 mat2_adj_mul(__m128 a, __m128 b)
+        {
+            return _mm_sub_ps(_mm_mul_ps(LINALG_SWIZZLE(a, 3, 3, 0, 0), b),
+                              _mm_mul_ps(LINALG_SWIZZLE(a, 1, 1, 2, 2), LINALG_SWIZZLE(b, 2, 3, 0, 1)));
+        }
+        
+        // A * adjugate(B)
+        inline __m128 mat2_mul_adj(__m128 a, __m128 b)
+        {
+            return _mm_sub_ps(_mm_mul_ps(a, LINALG_SWIZZLE(b, 3, 0, 3, 0)),
+                              _mm_mul_ps(LINALG_SWIZZLE(a, 1, 0, 3, 2), LINALG_SWIZZLE(b, 2, 1, 2, 1)));
+        }
+        
+        //
+        // Inverse by 2x2 blocks, | A B |
+        //                         | C D |
+        // using det = |A||D| + |B||C| - tr((A#B)(D#C)), # being the adjugate.
+        // Operates on the transpose (columns as rows), which inverts to the
+        // transpose of the inverse, i.e. the columns of the inverse.
+        // Writes the inverse to out if it is not null, and returns the determinant
+        //
+        inline float mat4_inverse(const mat4<float>& m, mat4<float>* out)
+        {
+            const __m128 r0 = _mm_loadu_ps(m.col[0].vec), r1 = _mm_loadu_ps(m.col[1].vec);
+            const __m128 r2 = _mm_loadu_ps(m.col[2].vec), r3 = _mm_loadu_ps(m.col[3].vec);
+            
+            const __m128 A = _mm_movelh_ps(r0, r1), B = _mm_movehl_ps(r1, r0);
+            const __m128 C = _mm_movelh_ps(r2, r3), D = _mm_movehl_ps(r3, r2);
+            
+            // (|A|, |B|, |C|, |D|)
+            const __m128 det_sub = _mm_sub_ps(
+                _mm_mul_ps(LINALG_SHUFFLE(r0, r2, 0, 2, 0, 2), LINALG_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+                _mm_mul_ps(LINALG_SHUFFLE(r0, r2, 1, 3, 1, 3), LINALG_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+            const __m128 det_A = LINALG_SWIZZLE(det_sub, 0, 0, 0, 0);
+            const __m128 det_B = LINALG_SWIZZLE(det_sub, 1, 1, 1, 1);
+            const __m128 det_C = LINALG_SWIZZLE(det_sub, 2, 2, 2, 2);
+            const __m128 det_D = LINALG_SWIZZLE(det_sub, 3, 3, 3, 3);
+            
+            const __m128 D_C = mat2_adj_mul(D, C);
+            const __m128 A_B = mat2_adj_mul(A, B);
+            
+            const float det =
+                _mm_cvtss_f32(_mm_add_ss(_mm_mul_ss(det_A, det_D), _mm_mul_ss(det_B, det_C))) -
+                sse_hsum(_mm_mul_ps(A_B, LINALG_SWIZZLE(D_C, 0, 2, 1, 3)));
+            if (!out)
+                return det;
+            
+            // Adjugate blocks of the inverse, | X Y |
+            //                                 | Z W |
+            __m128 X = _mm_sub_ps(_mm_mul_ps(det_D, A), mat2_mul(B, D_C));
+            __m128 W = _mm_sub_ps(_mm_mul_ps(det_A, D), mat2_mul(C, A_B));
+            __m128 Y = _mm_sub_ps(_mm_mul_ps(det_B, C), mat2_mul_adj(D, A_B));
+            __m128 Z = _mm_sub_ps(_mm_mul_ps(det_C, B), mat2_mul_adj(A, D_C));
+            
+            const __m128 idet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), _mm_set1_ps(det));
+            X = _mm_mul_ps(X, idet);
+            Y = _mm_mul_ps(Y, idet);
+            Z = _mm_mul_ps(Z, idet);
+            W = _mm_mul_ps(W, idet);
+            
+            // Take the adjugates and transpose back in one shuffle
+            _mm_storeu_ps(out->col[0].vec, LINALG_SHUFFLE(X, Y, 3, 1, 3, 1));
+            _mm_storeu_ps(out->col[1].vec, LINALG_SHUFFLE(X, Y, 2, 0, 2, 0));
+            _mm_storeu_ps(out->col[2].vec, LINALG_SHUFFLE(Z, W, 3, 1, 3, 1));
+            _mm_storeu_ps(out->col[3].vec, LINALG_SHUFFLE(Z, W, 2, 0, 2, 0));
+            return det;
+        }
+    }
+    
+    template<>
+    inline vec4<float> mat4<float>::operator *(const vec4<float> &v) const
+    {
+        __m128 r = _mm_mul_ps(_mm_loadu_ps(col[0].vec), _mm_set1_ps(v.x));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[1].vec), _mm_set1_ps(v.y)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[2].vec), _mm_set1_ps(v.z)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[3].vec), _mm_set1_ps(v.w)));
+        
+        vec4<float> u;
+        _mm_storeu_ps(u.vec, r);
+        return u;
+    }
+    
+    template<>
+    inline mat4<float> mat4<float>::operator *(const mat4<float>& m) const
+    {
+        const __m128 c0 = _mm_loadu_ps(col[0].vec), c1 = _mm_loadu_ps(col[1].vec);
+        const __m128 c2 = _mm_loadu_ps(col[2].vec), c3 = _mm_loadu_ps(col[3].vec);
+        
+        mat4<float> M;
+        for (int i = 0; i < 4; i++)
+        {
+            const __m128 v = _mm_loadu_ps(m.col[i].vec);
+            __m128 r = _mm_mul_ps(c0, LINALG_SWIZZLE(v, 0, 0, 0, 0));
+            r = _mm_add_ps(r, _mm_mul_ps(c1, LINALG_SWIZZLE(v, 1, 1, 1, 1)));
+            r = _mm_add_ps(r, _mm_mul_ps(c2, LINALG_SWIZZLE(v, 2, 2, 2, 2)));
+            r = _mm_add_ps(r, _mm_mul_ps(c3, LINALG_SWIZZLE(v, 3, 3, 3, 3)));
+            _mm_storeu_ps(M.col[i].vec, r);
+        }
+        return M;
+    }
+    
+    template<>
+    inline float mat4<float>::determinant() const
+    {
+        return sse::mat4_inverse(*this, nullptr);
+    }
+    
+    template<>
+    inline mat4<float> mat4<float>::inverse() const
+    {
+        mat4<float> M;
+        float det = sse::mat4_inverse(*this, &M);
+        assert(std::abs(det) > 1e-8);
+        (void)det;
+        return M;
+    }
+    
+    namespace sse
+    {
+        // a x b, with w = 0 if the w of a and b are equal
+        inline __m128 cross(__m128 a, __m128 b)
+        {
+            return _mm_sub_ps(_mm_mul_ps(LINALG_SWIZZLE(a, 1, 2, 0, 3), LINALG_SWIZZLE(b, 2, 0, 1, 3)),
+                              _mm_mul_ps(LINALG_SWIZZLE(a, 2, 0, 1, 3), LINALG_SWIZZLE(b, 1, 2, 0, 3)));
+        }
+        
+        //
+        // Affine matrix with rows r0, r1, r2 (w = 0) in its upper 3x3
+        // and translation -(upper 3x3) * t
+        //
+        inline mat4<float> affine_from_rows(__m128 r0, __m128 r1, __m128 r2, __m128 t)
+        {
+            __m128 r3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            
+            __m128 p = _mm_mul_ps(r0, LINALG_SWIZZLE(t, 0, 0, 0, 0));
+            p = _mm_add_ps(p, _mm_mul_ps(r1, LINALG_SWIZZLE(t, 1, 1, 1, 1)));
+            p = _mm_add_ps(p, _mm_mul_ps(r2, LINALG_SWIZZLE(t, 2, 2, 2, 2)));
+            // (0, 0, 0, 1) - p, with p.w = 0
+            p = _mm_sub_ps(r3, p);
+            
+            mat4<float> M;
+            _mm_storeu_ps(M.col[0].vec, r0);
+            _mm_storeu_ps(M.col[1].vec, r1);
+            _mm_storeu_ps(M.col[2].vec, r2);
+            _mm_storeu_ps(M.col[3].vec, p);
+            return M;
+        }
+        
+        // Clears the w lane
+        inline __m128 xyz0(__m128 v)
+        {
+            return _mm_and_ps(v, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+        }
+    }
+    
+    template<>
+    inline mat4<float> inverse_affine(const mat4<float>& m)
+    {
+        const __m128 a0 = sse::xyz0(_mm_loadu_ps(m.col[0].vec));
+        const __m128 a1 = sse::xyz0(_mm_loadu_ps(m.col[1].vec));
+        const __m128 a2 = sse::xyz0(_mm_loadu_ps(m.col[2].vec));
+        
+        const __m128 r0 = sse::cross(a1, a2), r1 = sse::cross(a2, a0), r2 = sse::cross(a0, a1);
+        const float det = sse_hsum(_mm_mul_ps(a0, r0));
+        assert(std::abs(det) > 1e-8);
+        const __m128 idet = _mm_set1_ps(1.0f / det);
+        
+        return sse::affine_from_rows(_mm_mul_ps(r0, idet), _mm_mul_ps(r1, idet), _mm_mul_ps(r2, idet),
+                                     _mm_loadu_ps(m.col[3].vec));
+    }
+    
+    template<>
+    inline mat4<float> inverse_rigid(const mat4<float>& m)
+    {
+        // The rows of R^T are the columns of R
+        return sse::affine_from_rows(sse::xyz0(_mm_loadu_ps(m.col[0].vec)),
+                                     sse::xyz0(_mm_loadu_ps(m.col[1].vec)),
+                                     sse::xyz0(_mm_loadu_ps(m.col[2].vec)),
+                                     _mm_loadu_ps(m.col[3].vec));
+    }
+#endif
+    
     typedef mat2<float> mat2f;
     typedef mat3<float> mat3f;
     typedef mat4<float> mat4f;
@@ -0,0 +1,381 @@
+//
+//	quat.h
+//
+//  Quaternion & dual quaternion lib
+//
+
+#pragma once
+#ifndef QUAT_H
+#define QUAT_H
+
+#include <cstddef>
+#include "math.h"
+#include "vec.h"
+#include "mat.h"
+
+namespace linalg
+{
+    //
+    // Quaternion x*i + y*j + z*k + w
+    //
+    // Unit quaternions represent rotations: q = (sin(theta/2)*u, cos(theta/2))
+    // rotates theta around the unit axis u, like mat4::rotation(theta, u).
+    // Products compose like matrices, (a*b).rotate(v) = a.rotate(b.rotate(v))
+    //
+    template<class T> class LINALG_ALIGN quat
+    {
+    public:
+        union
+        {
+            T vec[4];
+            struct { T x, y, z, w; };
+        };
+
+        //
+        // constructor: identity rotation
+        //
+        quat()
+        {
+            x = y = z = 0;
+            w = 1;
+        }
+
+        quat(const T& x, const T& y, const T& z, const T& w)
+        {
+            this->x = x;
+            this->y = y;
+            this->z = z;
+            this->w = w;
+        }
+
+        quat(const vec3<T>& v, const T& w)
+        {
+            this->x = v.x;
+            this->y = v.y;
+            this->z = v.z;
+            this->w = w;
+        }
+
+        vec3<T> xyz() const
+        {
+            return vec3<T>(x, y, z);
+        }
+
+        //
+        // Rotation theta around vector u=(x,y,z)
+        // notes: u should be normalized
+        //
+        static quat<T> rotation(const T& theta, const vec3<T>& u)
+        {
+            T s = sin(theta * (T)0.5);
+            return quat<T>(u * s, cos(theta * (T)0.5));
+        }
+
+        //
+        // Rotation from Euler angles, R = R_z(roll) * R_y(yaw) * R_x(pitch),
+        // the same as mat4::rotation(roll, yaw, pitch)
+        //
+        static quat<T> rotation(const T& roll, const T& yaw, const T& pitch)
+        {
+            const T sr = sin(roll * (T)0.5), cr = cos(roll * (T)0.5);
+            const T sy = sin(yaw * (T)0.5), cy = cos(yaw * (T)0.5);
+            const T sp = sin(pitch * (T)0.5), cp = cos(pitch * (T)0.5);
+
+            return quat<T>(cr*cy*sp - sr*sy*cp,
+                           cr*sy*cp + sr*cy*sp,
+                           sr*cy*cp - cr*sy*sp,
+                           cr*cy*cp + sr*sy*sp);
+        }
+
+        //
+        // From a rotation matrix (Shepperd's method, branching on the
+        // largest of w, x, y, z for precision)
+        //
+        static quat<T> from_matrix(const mat3<T>& m)
+        {
+            quat<T> q;
+            const T trace = m.m11 + m.m22 + m.m33;
+            if (trace > 0)
+            {
+                T s = sqrt(trace + 1) * 2;
+                q = quat<T>((m.m32 - m.m23) / s, (m.m13 - m.m31) / s, (m.m21 - m.m12) / s, s / 4);
+            }
+            else if (m.m11 > m.m22 && m.m11 > m.m33)
+            {
+                T s = sqrt(1 + m.m11 - m.m22 - m.m33) * 2;
+                q = quat<T>(s / 4, (m.m12 + m.m21) / s, (m.m13 + m.m31) / s, (m.m32 - m.m23) / s);
+            }
+            else if (m.m22 > m.m33)
+            {
+                T s = sqrt(1 + m.m22 - m.m11 - m.m33) * 2;
+                q = quat<T>((m.m12 + m.m21) / s, s / 4, (m.m23 + m.m32) / s, (m.m13 - m.m31) / s);
+            }
+            else
+            {
+                T s = sqrt(1 + m.m33 - m.m11 - m.m22) * 2;
+                q = quat<T>((m.m13 + m.m31) / s, (m.m23 + m.m32) / s, s / 4, (m.m21 - m.m12) / s);
+            }
+            return q;
+        }
+
+        static quat<T> from_matrix(const mat4<T>& m)
+        {
+            return from_matrix(m.get_3x3());
+        }
+
+        mat3<T> to_mat3() const
+        {
+            const T xx = x*x, yy = y*y, zz = z*z;
+            const T xy = x*y, xz = x*z, yz = y*z;
+            const T wx = w*x, wy = w*y, wz = w*z;
+
+            return mat3<T>(1 - 2*(yy + zz), 2*(xy - wz),     2*(xz + wy),
+                           2*(xy + wz),     1 - 2*(xx + zz), 2*(yz - wx),
+                           2*(xz - wy),     2*(yz + wx),     1 - 2*(xx + yy));
+        }
+
+        mat4<T> to_mat4() const
+        {
+            return mat4<T>(to_mat3());
+        }
+
+        quat<T> conjugate() const
+        {
+            return quat<T>(-x, -y, -z, w);
+        }
+
+        //
+        // normalization, divide-by-zero safe
+        //
+        quat<T>& normalize()
+        {
+            T norm_squared = x*x + y*y + z*z + w*w;
+            if (norm_squared < 1e-16)
+                *this = quat<T>();
+            else
+                *this = *this * (T)(1.0 / sqrt(norm_squared));
+            return *this;
+        }
+
+        //
+        // Rotate v by a unit quaternion, v' = v + 2w(q x v) + 2q x (q x v)
+        //
+        vec3<T> rotate(const vec3<T>& v) const
+        {
+            const vec3<T> q = xyz();
+            const vec3<T> t = (q % v) * (T)2;
+            return v + t * w + q % t;
+        }
+
+        vec3<T> operator *(const vec3<T>& v) const
+        {
+            return rotate(v);
+        }
+
+        //
+        // Hamilton product
+        //
+        quat<T> operator *(const quat<T>& q) const
+        {
+            return quat<T>(w*q.x + x*q.w + y*q.z - z*q.y,
+                           w*q.y - x*q.z + y*q.w + z*q.x,
+                           w*q.z + x*q.y - y*q.x + z*q.w,
+                           w*q.w - x*q.x - y*q.y - z*q.z);
+        }
+
+        quat<T> operator *(const T& s) const
+        {
+            return quat<T>(x*s, y*s, z*s, w*s);
+        }
+
+        quat<T> operator +(const quat<T>& q) const
+        {
+            return quat<T>(x + q.x, y + q.y, z + q.z, w + q.w);
+        }
+
+        quat<T> operator -(const quat<T>& q) const
+        {
+            return quat<T>(x - q.x, y - q.y, z - q.z, w - q.w);
+        }
+
+        quat<T> operator -() const
+        {
+            return quat<T>(-x, -y, -z, -w);
+        }
+    };
+
+    template<class T>
+    inline T dot(const quat<T>& a, const quat<T>& b)
+    {
+        return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+    }
+
+    //
+    // Normalized linear interpolation along the shortest arc.
+    // Constant speed only approximately, but cheap and commutative
+    //
+    template<class T>
+    inline quat<T> nlerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        const T s = dot(a, b) < 0 ? -t : t;
+        return (a * (1 - t) + b * s).normalize();
+    }
+
+    //
+    // Spherical linear interpolation along the shortest arc, at constant speed
+    //
+    template<class T>
+    inline quat<T> slerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        T d = dot(a, b);
+        const T sign = d < 0 ? (T)-1 : (T)1;
+        d *= sign;
+
+        // Nearly parallel, sin(theta) -> 0
+        if (d > (T)0.9995)
+            return nlerp(a, b, t);
+
+        const T theta = acos(d);
+        const T isin = 1 / sin(theta);
+        return a * (sin((1 - t) * theta) * isin) + b * (sign * sin(t * theta) * isin);
+    }
+
+    template<class T>
+    inline std::ostream& operator << (std::ostream &out, const quat<T> &q)
+    {
+        return out << "(" << q.x << ", " << q.y << ", " << q.z << ", " << q.w << ")";
+    }
+
+    //
+    // Dual quaternion real + eps*dual, eps^2 = 0
+    //
+    // Unit dual quaternions represent rigid transforms: rotation r followed by
+    // translation t is (r, 0.5*(t, 0)*r), 8 floats against the 12 of a 3x4
+    // matrix. Products compose like matrices
+    //
+    template<class T> class dualquat
+    {
+    public:
+        quat<T> real;
+        quat<T> dual;
+
+        //
+        // constructor: identity transform
+        //
+        dualquat() : real(), dual(0, 0, 0, 0) { }
+
+        dualquat(const quat<T>& real, const quat<T>& dual) : real(real), dual(dual) { }
+
+        //
+        // Rotation r (unit) followed by translation t
+        //
+        dualquat(const quat<T>& r, const vec3<T>& t) : real(r), dual(quat<T>(t, 0) * r * (T)0.5) { }
+
+        //
+        // From a rigid matrix (rotation and translation only)
+        //
+        static dualquat<T> from_matrix(const mat4<T>& m)
+        {
+            return dualquat<T>(quat<T>::from_matrix(m), m.col[3].xyz());
+        }
+
+        vec3<T> translation() const
+        {
+            return (dual * real.conjugate()).xyz() * (T)2;
+        }
+
+        mat4<T> to_mat4() const
+        {
+            mat4<T> M = real.to_mat4();
+            M.col[3] = vec4<T>(translation(), 1);
+            return M;
+        }
+
+        vec3<T> transform_point(const vec3<T>& p) const
+        {
+            return real.rotate(p) + translation();
+        }
+
+        vec3<T> transform_direction(const vec3<T>& d) const
+        {
+            return real.rotate(d);
+        }
+
+        //
+        // Inverse of a unit dual quaternion
+        //
+        dualquat<T> conjugate() const
+        {
+            return dualquat<T>(real.conjugate(), dual.conjugate());
+        }
+
+        //
+        // normalization to a unit dual quaternion, divide-by-zero safe
+        //
+        dualquat<T>& normalize()
+        {
+            T norm_squared = dot(real, real);
+            if (norm_squared < 1e-16)
+                return *this = dualquat<T>();
+
+            T inorm = (T)(1.0 / sqrt(norm_squared));
+            real = real * inorm;
+            dual = dual * inorm;
+            // make dual orthogonal to real
+            dual = dual - real * dot(real, dual);
+            return *this;
+        }
+
+        dualquat<T> operator *(const dualquat<T>& q) const
+        {
+            return dualquat<T>(real * q.real, real * q.dual + dual * q.real);
+        }
+
+        dualquat<T> operator *(const T& s) const
+        {
+            return dualquat<T>(real * s, dual * s);
+        }
+
+        dualquat<T> operator +(const dualquat<T>& q) const
+        {
+            return dualquat<T>(real + q.real, dual + q.dual);
+        }
+    };
+
+    //
+    // Dual quaternion linear blending (Kavan et al.) of two rigid transforms,
+    // along the shortest arc
+    //
+    template<class T>
+    inline dualquat<T> nlerp(const dualquat<T>& a, const dualquat<T>& b, const T& t)
+    {
+        const T s = dot(a.real, b.real) < 0 ? -t : t;
+        return (a * (1 - t) + b * s).normalize();
+    }
+
+    typedef quat<float> quatf;
+    typedef dualquat<float> dualquatf;
+
+    const quatf quatf_identity = quatf();
+
+    //
+    // Batched interpolation, out[i] = nlerp/slerp(a[i], b[i], t).
+    // out may be a or b. slerp evaluates the interpolation weights with a
+    // polynomial (Eberly) instead of acos and sin, to float precision
+    //
+    void nlerp(
+        const quatf* a,
+        const quatf* b,
+        float t,
+        quatf* out,
+        size_t n);
+
+    void slerp(
+        const quatf* a,
+        const quatf* b,
+        float t,
+        quatf* out,
+        size_t n);
+}
+
+#endif /* QUAT_H */
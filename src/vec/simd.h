@@ -0,0 +1,50 @@
+//
+//	simd.h
+//
+//  SSE configuration of the vector & matrix lib
+//
+
+#pragma once
+#ifndef SIMD_H
+#define SIMD_H
+
+//
+// LINALG_SSE selects the SSE specializations of vec4<float> and mat4<float>
+// (see the ends of vec.h and mat.h). Define LINALG_NO_SIMD to use the
+// generic templates on all platforms
+//
+#if !defined(LINALG_NO_SIMD) && (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+#define LINALG_SSE
+#include <emmintrin.h>
+#endif
+
+//
+// vec4 and mat4 are 16-byte aligned, so that their columns sit in single SSE
+// registers and never straddle cache lines. Loads are unaligned all the same,
+// since heap allocations are only 8-byte aligned on some platforms.
+// 32-bit MSVC cannot pass over-aligned types by value (C2719), so there
+// the alignment is left natural
+//
+#if defined(_MSC_VER) && !defined(_M_X64)
+#define LINALG_ALIGN
+#else
+#define LINALG_ALIGN alignas(16)
+#endif
+
+#ifdef LINALG_SSE
+namespace linalg
+{
+	// _MM_SHUFFLE with the components in natural order
+	#define LINALG_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+	#define LINALG_SWIZZLE(a, x, y, z, w) LINALG_SHUFFLE(a, a, x, y, z, w)
+
+	inline float sse_hsum(__m128 v)
+	{
+		v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+		return _mm_cvtss_f32(v);
+	}
+}
+#endif
+
+#endif /* SIMD_H */
@@ -0,0 +1,275 @@
+//
+//	transform.cpp
+//
+//  Batch transforms of points, directions and bounding boxes by a mat4f
+//
+
+#include "transform.h"
+#include "../Parallel.h"
+
+namespace linalg
+{
+	// Smallest batch worth a thread of its own
+	static const size_t MinItemsPerThread = 1 << 15;
+
+	//
+	// Run fn(begin, end) over [0, n), split over up to max_threads threads
+	//
+	template<class F>
+	static void for_ranges(size_t n, unsigned max_threads, F&& fn)
+	{
+		const unsigned nbr_threads = max_threads == 1 ? 1 : parallel_thread_count(n, MinItemsPerThread, max_threads);
+		if (nbr_threads <= 1)
+			fn((size_t)0, n);
+		else
+			parallel_ranges(n, nbr_threads, [&](unsigned, size_t begin, size_t end) { fn(begin, end); });
+	}
+
+	//
+	// out = M * (x, y, z, w) for a single element
+	//
+	template<int W>
+	static inline vec3f transform3(const mat4f& M, const vec3f& v)
+	{
+		return vec3f(
+			M.m11 * v.x + M.m12 * v.y + M.m13 * v.z + M.m14 * W,
+			M.m21 * v.x + M.m22 * v.y + M.m23 * v.z + M.m24 * W,
+			M.m31 * v.x + M.m32 * v.y + M.m33 * v.z + M.m34 * W);
+	}
+
+	template<int W>
+	static void transform_aos(const mat4f& M, const vec3f* in, vec3f* out, size_t begin, size_t end)
+	{
+		size_t i = begin;
+#ifdef LINALG_SSE
+		// 4 elements (12 floats) at a time, transposed to x4, y4, z4 and back
+		const __m128 m11 = _mm_set1_ps(M.m11), m12 = _mm_set1_ps(M.m12), m13 = _mm_set1_ps(M.m13), m14 = _mm_set1_ps(M.m14 * W);
+		const __m128 m21 = _mm_set1_ps(M.m21), m22 = _mm_set1_ps(M.m22), m23 = _mm_set1_ps(M.m23), m24 = _mm_set1_ps(M.m24 * W);
+		const __m128 m31 = _mm_set1_ps(M.m31), m32 = _mm_set1_ps(M.m32), m33 = _mm_set1_ps(M.m33), m34 = _mm_set1_ps(M.m34 * W);
+
+		for (; i + 4 <= end; i += 4)
+		{
+			const float* src = &in[i].x;
+			const __m128 a0 = _mm_loadu_ps(src), a1 = _mm_loadu_ps(src + 4), a2 = _mm_loadu_ps(src + 8);
+
+			// (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3) to x, y, z
+			const __m128 x = LINALG_SHUFFLE(a0, LINALG_SHUFFLE(a1, a2, 2, 2, 1, 1), 0, 3, 0, 2);
+			const __m128 y = LINALG_SHUFFLE(LINALG_SHUFFLE(a0, a1, 1, 1, 0, 0), LINALG_SHUFFLE(a1, a2, 3, 3, 2, 2), 0, 2, 0, 2);
+			const __m128 z = LINALG_SHUFFLE(LINALG_SHUFFLE(a0, a1, 2, 2, 1, 1), LINALG_SWIZZLE(a2, 0, 0, 3, 3), 0, 2, 0, 2);
+
+			const __m128 X = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m11, x), _mm_mul_ps(m12, y)), _mm_add_ps(_mm_mul_ps(m13, z), m14));
+			const __m128 Y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m21, x), _mm_mul_ps(m22, y)), _mm_add_ps(_mm_mul_ps(m23, z), m24));
+			const __m128 Z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m31, x), _mm_mul_ps(m32, y)), _mm_add_ps(_mm_mul_ps(m33, z), m34));
+
+			float* dst = &out[i].x;
+			_mm_storeu_ps(dst, LINALG_SHUFFLE(LINALG_SHUFFLE(X, Y, 0, 0, 0, 0), LINALG_SHUFFLE(Z, X, 0, 0, 1, 1), 0, 2, 0, 2));
+			_mm_storeu_ps(dst + 4, LINALG_SHUFFLE(LINALG_SHUFFLE(Y, Z, 1, 1, 1, 1), LINALG_SHUFFLE(X, Y, 2, 2, 2, 2), 0, 2, 0, 2));
+			_mm_storeu_ps(dst + 8, LINALG_SHUFFLE(LINALG_SHUFFLE(Z, X, 2, 2, 3, 3), LINALG_SHUFFLE(Y, Z, 3, 3, 3, 3), 0, 2, 0, 2));
+		}
+#endif
+		for (; i < end; i++)
+			out[i] = transform3<W>(M, in[i]);
+	}
+
+	template<int W>
+	static void transform_soa(
+		const mat4f& M,
+		const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z,
+		size_t begin, size_t end)
+	{
+		size_t i = begin;
+#ifdef LINALG_SSE
+		const __m128 m11 = _mm_set1_ps(M.m11), m12 = _mm_set1_ps(M.m12), m13 = _mm_set1_ps(M.m13), m14 = _mm_set1_ps(M.m14 * W);
+		const __m128 m21 = _mm_set1_ps(M.m21), m22 = _mm_set1_ps(M.m22), m23 = _mm_set1_ps(M.m23), m24 = _mm_set1_ps(M.m24 * W);
+		const __m128 m31 = _mm_set1_ps(M.m31), m32 = _mm_set1_ps(M.m32), m33 = _mm_set1_ps(M.m33), m34 = _mm_set1_ps(M.m34 * W);
+
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+			_mm_storeu_ps(out_x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m11, vx), _mm_mul_ps(m12, vy)), _mm_add_ps(_mm_mul_ps(m13, vz), m14)));
+			_mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m21, vx), _mm_mul_ps(m22, vy)), _mm_add_ps(_mm_mul_ps(m23, vz), m24)));
+			_mm_storeu_ps(out_z + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m31, vx), _mm_mul_ps(m32, vy)), _mm_add_ps(_mm_mul_ps(m33, vz), m34)));
+		}
+#endif
+		for (; i < end; i++)
+		{
+			vec3f v = transform3<W>(M, vec3f(x[i], y[i], z[i]));
+			out_x[i] = v.x; out_y[i] = v.y; out_z[i] = v.z;
+		}
+	}
+
+	void transform_points(const mat4f& M, const vec3f* in, vec3f* out, size_t n, unsigned max_threads)
+	{
+		for_ranges(n, max_threads, [&](size_t begin, size_t end) { transform_aos<1>(M, in, out, begin, end); });
+	}
+
+	void transform_directions(const mat4f& M, const vec3f* in, vec3f* out, size_t n, unsigned max_threads)
+	{
+		for_ranges(n, max_threads, [&](size_t begin, size_t end) { transform_aos<0>(M, in, out, begin, end); });
+	}
+
+	void transform_vec4(const mat4f& M, const vec4f* in, vec4f* out, size_t n, unsigned max_threads)
+	{
+		for_ranges(n, max_threads, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+					out[i] = M * in[i];
+			});
+	}
+
+	void transform_points(
+		const mat4f& M,
+		const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z,
+		size_t n,
+		unsigned max_threads)
+	{
+		for_ranges(n, max_threads, [&](size_t begin, size_t end)
+			{
+				transform_soa<1>(M, x, y, z, out_x, out_y, out_z, begin, end);
+			});
+	}
+
+	void transform_directions(
+		const mat4f& M,
+		const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z,
+		size_t n,
+		unsigned max_threads)
+	{
+		for_ranges(n, max_threads, [&](size_t begin, size_t end)
+			{
+				transform_soa<0>(M, x, y, z, out_x, out_y, out_z, begin, end);
+			});
+	}
+
+	aabb3f transform_aabb(const mat4f& M, const aabb3f& box)
+	{
+		const vec3f center = (box.min + box.max) * 0.5f;
+		const vec3f extent = (box.max - box.min) * 0.5f;
+
+		const vec3f c = transform3<1>(M, center);
+		const vec3f e(
+			std::fabs(M.m11) * extent.x + std::fabs(M.m12) * extent.y + std::fabs(M.m13) * extent.z,
+			std::fabs(M.m21) * extent.x + std::fabs(M.m22) * extent.y + std::fabs(M.m23) * extent.z,
+			std::fabs(M.m31) * extent.x + std::fabs(M.m32) * extent.y + std::fabs(M.m33) * extent.z);
+
+		return { c - e, c + e };
+	}
+
+	void transform_aabbs(const mat4f& M, const aabb3f* in, aabb3f* out, size_t n, unsigned max_threads)
+	{
+		for_ranges(n, max_threads, [&](size_t begin, size_t end)
+			{
+				size_t i = begin;
+#ifdef LINALG_SSE
+				// One box per iteration, with the columns of M and |M| in registers
+				const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+				const __m128 c0 = _mm_loadu_ps(M.col[0].vec), c1 = _mm_loadu_ps(M.col[1].vec);
+				const __m128 c2 = _mm_loadu_ps(M.col[2].vec), c3 = _mm_loadu_ps(M.col[3].vec);
+				const __m128 a0 = _mm_and_ps(c0, abs_mask), a1 = _mm_and_ps(c1, abs_mask), a2 = _mm_and_ps(c2, abs_mask);
+				const __m128 half = _mm_set1_ps(0.5f);
+
+				for (; i < end; i++)
+				{
+					// (min.xyz, max.x) and (min.z, max.xyz), without reading past the box
+					const float* src = &in[i].min.x;
+					const __m128 lo = _mm_loadu_ps(src);
+					const __m128 hi = _mm_loadu_ps(src + 2);
+					const __m128 hi_xyz = LINALG_SWIZZLE(hi, 1, 2, 3, 3);
+
+					const __m128 center = _mm_mul_ps(_mm_add_ps(lo, hi_xyz), half);
+					const __m128 extent = _mm_mul_ps(_mm_sub_ps(hi_xyz, lo), half);
+
+					__m128 c = _mm_add_ps(c3, _mm_mul_ps(c0, LINALG_SWIZZLE(center, 0, 0, 0, 0)));
+					c = _mm_add_ps(c, _mm_mul_ps(c1, LINALG_SWIZZLE(center, 1, 1, 1, 1)));
+					c = _mm_add_ps(c, _mm_mul_ps(c2, LINALG_SWIZZLE(center, 2, 2, 2, 2)));
+					__m128 e = _mm_mul_ps(a0, LINALG_SWIZZLE(extent, 0, 0, 0, 0));
+					e = _mm_add_ps(e, _mm_mul_ps(a1, LINALG_SWIZZLE(extent, 1, 1, 1, 1)));
+					e = _mm_add_ps(e, _mm_mul_ps(a2, LINALG_SWIZZLE(extent, 2, 2, 2, 2)));
+
+					// Store (min.z, max.xyz), then min.xy
+					const __m128 new_lo = _mm_sub_ps(c, e), new_hi = _mm_add_ps(c, e);
+					float* dst = &out[i].min.x;
+					_mm_storeu_ps(dst + 2, LINALG_SHUFFLE(LINALG_SHUFFLE(new_lo, new_hi, 2, 2, 0, 0), new_hi, 0, 2, 1, 2));
+					_mm_storel_pi((__m64*)dst, new_lo);
+				}
+#endif
+				for (; i < end; i++)
+					out[i] = transform_aabb(M, in[i]);
+			});
+	}
+
+	void transform_matrices(const mat4f& M, const mat4f* in, mat4f* out, size_t n, unsigned max_threads)
+	{
+		for_ranges(n, max_threads, [&](size_t begin, size_t end)
+			{
+				size_t i = begin;
+#ifdef LINALG_SSE
+				// Columns of M stay in registers, each column of the product
+				// is M * in[i].col[j]
+				const __m128 c0 = _mm_loadu_ps(M.col[0].vec), c1 = _mm_loadu_ps(M.col[1].vec);
+				const __m128 c2 = _mm_loadu_ps(M.col[2].vec), c3 = _mm_loadu_ps(M.col[3].vec);
+				for (; i < end; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						const __m128 b = _mm_loadu_ps(in[i].col[j].vec);
+						const __m128 r = _mm_add_ps(
+							_mm_add_ps(_mm_mul_ps(c0, LINALG_SWIZZLE(b, 0, 0, 0, 0)), _mm_mul_ps(c1, LINALG_SWIZZLE(b, 1, 1, 1, 1))),
+							_mm_add_ps(_mm_mul_ps(c2, LINALG_SWIZZLE(b, 2, 2, 2, 2)), _mm_mul_ps(c3, LINALG_SWIZZLE(b, 3, 3, 3, 3))));
+						_mm_storeu_ps(out[i].col[j].vec, r);
+					}
+				}
+#endif
+				for (; i < end; i++)
+					out[i] = M * in[i];
+			});
+	}
+
+	mat4f normal_matrix(const mat4f& M)
+	{
+		// The inverse transpose is the cofactor matrix over the determinant,
+		// whose columns are the cross products of the columns of M
+		const vec3f a0 = M.col[0].xyz(), a1 = M.col[1].xyz(), a2 = M.col[2].xyz();
+		const vec3f r0 = a1 % a2, r1 = a2 % a0, r2 = a0 % a1;
+		const float det = dot(a0, r0);
+		assert(std::fabs(det) > 1e-8);
+		const float idet = 1.0f / det;
+
+		return mat4f(r0.x * idet, r1.x * idet, r2.x * idet, 0,
+					 r0.y * idet, r1.y * idet, r2.y * idet, 0,
+					 r0.z * idet, r1.z * idet, r2.z * idet, 0,
+					 0,           0,           0,           1);
+	}
+
+	void normal_matrices(const mat4f* in, mat4f* out, size_t n, unsigned max_threads)
+	{
+		for_ranges(n, max_threads, [&](size_t begin, size_t end)
+			{
+				size_t i = begin;
+#ifdef LINALG_SSE
+				const __m128 w1 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+				for (; i < end; i++)
+				{
+					const __m128 a0 = sse::xyz0(_mm_loadu_ps(in[i].col[0].vec));
+					const __m128 a1 = sse::xyz0(_mm_loadu_ps(in[i].col[1].vec));
+					const __m128 a2 = sse::xyz0(_mm_loadu_ps(in[i].col[2].vec));
+
+					const __m128 r0 = sse::cross(a1, a2), r1 = sse::cross(a2, a0), r2 = sse::cross(a0, a1);
+					const float det = sse_hsum(_mm_mul_ps(a0, r0));
+					assert(std::fabs(det) > 1e-8);
+					const __m128 idet = _mm_set1_ps(1.0f / det);
+
+					_mm_storeu_ps(out[i].col[0].vec, _mm_mul_ps(r0, idet));
+					_mm_storeu_ps(out[i].col[1].vec, _mm_mul_ps(r1, idet));
+					_mm_storeu_ps(out[i].col[2].vec, _mm_mul_ps(r2, idet));
+					_mm_storeu_ps(out[i].col[3].vec, w1);
+				}
+#endif
+				for (; i < end; i++)
+					out[i] = normal_matrix(in[i]);
+			});
+	}
+}
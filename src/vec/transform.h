@@ -0,0 +1,121 @@
+//
+//	transform.h
+//
+//  Batch transforms of points, directions and bounding boxes by a mat4f
+//
+
+#pragma once
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cstddef>
+#include "vec.h"
+#include "mat.h"
+
+namespace linalg
+{
+	//
+	// Axis-aligned bounding box
+	//
+	struct aabb3f
+	{
+		vec3f min;
+		vec3f max;
+	};
+
+	//
+	// All functions transform n elements from in to out, which may be the same
+	// array. Points are transformed with w = 1 and directions with w = 0,
+	// without perspective division, i.e. M is assumed to be affine.
+	//
+	// max_threads is the number of threads to split large batches over, where
+	// 0 means the hardware concurrency (see Parallel.h). Batches too small to
+	// gain from it run on the calling thread.
+	//
+
+	//
+	// Array of structures: x, y, z, x, y, z, ...
+	//
+	void transform_points(
+		const mat4f& M,
+		const vec3f* in,
+		vec3f* out,
+		size_t n,
+		unsigned max_threads = 1);
+
+	void transform_directions(
+		const mat4f& M,
+		const vec3f* in,
+		vec3f* out,
+		size_t n,
+		unsigned max_threads = 1);
+
+	// Full 4D transform, out[i] = M * in[i]
+	void transform_vec4(
+		const mat4f& M,
+		const vec4f* in,
+		vec4f* out,
+		size_t n,
+		unsigned max_threads = 1);
+
+	//
+	// Structure of arrays: x, x, x, ..., y, y, y, ..., z, z, z, ...
+	//
+	void transform_points(
+		const mat4f& M,
+		const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z,
+		size_t n,
+		unsigned max_threads = 1);
+
+	void transform_directions(
+		const mat4f& M,
+		const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z,
+		size_t n,
+		unsigned max_threads = 1);
+
+	//
+	// Matrix products with a common left factor, out[i] = M * in[i], e.g.
+	// model-to-clip matrices from a view-projection matrix and model-to-world
+	// matrices. Unlike the functions above, M need not be affine
+	//
+	void transform_matrices(
+		const mat4f& M,
+		const mat4f* in,
+		mat4f* out,
+		size_t n,
+		unsigned max_threads = 1);
+
+	//
+	// Smallest AABB enclosing the transformed box, by transforming its center
+	// and extent (Arvo): extent' = |M| * extent, with |M| the elementwise
+	// absolute value of the upper-left 3x3
+	//
+	aabb3f transform_aabb(
+		const mat4f& M,
+		const aabb3f& box);
+
+	void transform_aabbs(
+		const mat4f& M,
+		const aabb3f* in,
+		aabb3f* out,
+		size_t n,
+		unsigned max_threads = 1);
+
+	//
+	// Normal matrix, the inverse transpose of the upper 3x3 of M, in the upper
+	// 3x3 of a matrix without translation. Transforms normals (w = 0) to the
+	// space M transforms points to, up to their length
+	//
+	mat4f normal_matrix(
+		const mat4f& M);
+
+	void normal_matrices(
+		const mat4f* in,
+		mat4f* out,
+		size_t n,
+		unsigned max_threads = 1);
+}
+
+#endif /* TRANSFORM_H */
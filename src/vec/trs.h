@@ -0,0 +1,312 @@
+//
+//	trs.h
+//
+//  Structured transform factors: translation, scaling, rotation & affine
+//
+
+#pragma once
+#ifndef TRS_H
+#define TRS_H
+
+#include "math.h"
+#include "vec.h"
+#include "mat.h"
+
+namespace linalg
+{
+    //
+    // Chains like translation * rotation * scaling built from mat4::translation
+    // etc. do full 4x4 products of mostly zero matrices. The factors below keep
+    // their structure, and each product only touches the elements the factors
+    // can change: T * R is a copy, (T * R) * S scales three columns. Products
+    // of factors are affine_t's, which convert to mat4 when assigned:
+    //
+    //  mat4f M = translationf(0, -5, 0) * rotationf(angle, 0, 1, 0) * scalingf(2);
+    //
+    // Everything but the angle constructors of rotation_t (sin & cos) is
+    // constexpr, so chains of constant factors fold at compile time
+    //
+
+    template<class T> class translation_t
+    {
+    public:
+        T x, y, z;
+
+        constexpr translation_t(const T& x, const T& y, const T& z) : x(x), y(y), z(z) { }
+
+        translation_t(const vec3<T>& p) : x(p.x), y(p.y), z(p.z) { }
+    };
+
+    template<class T> class scaling_t
+    {
+    public:
+        T x, y, z;
+
+        constexpr scaling_t(const T& s) : x(s), y(s), z(s) { }
+
+        constexpr scaling_t(const T& x, const T& y, const T& z) : x(x), y(y), z(z) { }
+
+        scaling_t(const vec3<T>& s) : x(s.x), y(s.y), z(s.z) { }
+    };
+
+    //
+    // Rotation, as a row-major 3x3 matrix
+    //
+    template<class T> class rotation_t
+    {
+    public:
+        T m[3][3];
+
+        constexpr rotation_t(const T& m11, const T& m12, const T& m13,
+                             const T& m21, const T& m22, const T& m23,
+                             const T& m31, const T& m32, const T& m33)
+            : m{ { m11, m12, m13 }, { m21, m22, m23 }, { m31, m32, m33 } } { }
+
+        //
+        // Rotation theta around vector u=(x,y,z), as mat4::rotation
+        // notes: u should be normalized
+        //
+        rotation_t(const T& theta, const T& x, const T& y, const T& z)
+            : rotation_t(from_cos_sin(cos(theta), sin(theta), x, y, z)) { }
+
+        rotation_t(const T& theta, const vec3<T>& u)
+            : rotation_t(theta, u.x, u.y, u.z) { }
+
+        //
+        // Rotation around u=(x,y,z) from the cosine and sine of the angle
+        //
+        static constexpr rotation_t<T> from_cos_sin(const T& c, const T& s, const T& x, const T& y, const T& z)
+        {
+            return rotation_t<T>(c + (1 - c)*x*x,     (1 - c)*x*y - s*z, (1 - c)*x*z + s*y,
+                                 (1 - c)*x*y + s*z, c + (1 - c)*y*y,     (1 - c)*y*z - s*x,
+                                 (1 - c)*x*z - s*y, (1 - c)*y*z + s*x, c + (1 - c)*z*z);
+        }
+    };
+
+    //
+    // Affine transform, the upper 3x4 of a mat4 (row-major)
+    //
+    template<class T> class affine_t
+    {
+    public:
+        T m[3][4];
+
+        constexpr affine_t(const T& m11, const T& m12, const T& m13, const T& m14,
+                           const T& m21, const T& m22, const T& m23, const T& m24,
+                           const T& m31, const T& m32, const T& m33, const T& m34)
+            : m{ { m11, m12, m13, m14 }, { m21, m22, m23, m24 }, { m31, m32, m33, m34 } } { }
+
+        constexpr affine_t(const translation_t<T>& t)
+            : affine_t(1, 0, 0, t.x,
+                       0, 1, 0, t.y,
+                       0, 0, 1, t.z) { }
+
+        constexpr affine_t(const scaling_t<T>& s)
+            : affine_t(s.x, 0, 0, 0,
+                       0, s.y, 0, 0,
+                       0, 0, s.z, 0) { }
+
+        constexpr affine_t(const rotation_t<T>& r)
+            : affine_t(r.m[0][0], r.m[0][1], r.m[0][2], 0,
+                       r.m[1][0], r.m[1][1], r.m[1][2], 0,
+                       r.m[2][0], r.m[2][1], r.m[2][2], 0) { }
+
+        //
+        // From a mat4, the bottom row is assumed to be (0, 0, 0, 1)
+        //
+        affine_t(const mat4<T>& M)
+            : affine_t(M.m11, M.m12, M.m13, M.m14,
+                       M.m21, M.m22, M.m23, M.m24,
+                       M.m31, M.m32, M.m33, M.m34) { }
+
+        mat4<T> to_mat4() const
+        {
+            return mat4<T>(m[0][0], m[0][1], m[0][2], m[0][3],
+                           m[1][0], m[1][1], m[1][2], m[1][3],
+                           m[2][0], m[2][1], m[2][2], m[2][3],
+                           0,       0,       0,       1);
+        }
+
+        operator mat4<T>() const
+        {
+            return to_mat4();
+        }
+    };
+
+    //
+    // Products that keep their structure
+    //
+
+    template<class T>
+    constexpr translation_t<T> operator *(const translation_t<T>& a, const translation_t<T>& b)
+    {
+        return translation_t<T>(a.x + b.x, a.y + b.y, a.z + b.z);
+    }
+
+    template<class T>
+    constexpr scaling_t<T> operator *(const scaling_t<T>& a, const scaling_t<T>& b)
+    {
+        return scaling_t<T>(a.x * b.x, a.y * b.y, a.z * b.z);
+    }
+
+    template<class T>
+    constexpr rotation_t<T> operator *(const rotation_t<T>& a, const rotation_t<T>& b)
+    {
+        return rotation_t<T>(
+            a.m[0][0]*b.m[0][0] + a.m[0][1]*b.m[1][0] + a.m[0][2]*b.m[2][0],
+            a.m[0][0]*b.m[0][1] + a.m[0][1]*b.m[1][1] + a.m[0][2]*b.m[2][1],
+            a.m[0][0]*b.m[0][2] + a.m[0][1]*b.m[1][2] + a.m[0][2]*b.m[2][2],
+            a.m[1][0]*b.m[0][0] + a.m[1][1]*b.m[1][0] + a.m[1][2]*b.m[2][0],
+            a.m[1][0]*b.m[0][1] + a.m[1][1]*b.m[1][1] + a.m[1][2]*b.m[2][1],
+            a.m[1][0]*b.m[0][2] + a.m[1][1]*b.m[1][2] + a.m[1][2]*b.m[2][2],
+            a.m[2][0]*b.m[0][0] + a.m[2][1]*b.m[1][0] + a.m[2][2]*b.m[2][0],
+            a.m[2][0]*b.m[0][1] + a.m[2][1]*b.m[1][1] + a.m[2][2]*b.m[2][1],
+            a.m[2][0]*b.m[0][2] + a.m[2][1]*b.m[1][2] + a.m[2][2]*b.m[2][2]);
+    }
+
+    //
+    // Affine products, specialized on the structure of either side
+    //
+
+    // A * B, the general case
+    template<class T>
+    constexpr affine_t<T> operator *(const affine_t<T>& a, const affine_t<T>& b)
+    {
+        return affine_t<T>(
+            a.m[0][0]*b.m[0][0] + a.m[0][1]*b.m[1][0] + a.m[0][2]*b.m[2][0],
+            a.m[0][0]*b.m[0][1] + a.m[0][1]*b.m[1][1] + a.m[0][2]*b.m[2][1],
+            a.m[0][0]*b.m[0][2] + a.m[0][1]*b.m[1][2] + a.m[0][2]*b.m[2][2],
+            a.m[0][0]*b.m[0][3] + a.m[0][1]*b.m[1][3] + a.m[0][2]*b.m[2][3] + a.m[0][3],
+            a.m[1][0]*b.m[0][0] + a.m[1][1]*b.m[1][0] + a.m[1][2]*b.m[2][0],
+            a.m[1][0]*b.m[0][1] + a.m[1][1]*b.m[1][1] + a.m[1][2]*b.m[2][1],
+            a.m[1][0]*b.m[0][2] + a.m[1][1]*b.m[1][2] + a.m[1][2]*b.m[2][2],
+            a.m[1][0]*b.m[0][3] + a.m[1][1]*b.m[1][3] + a.m[1][2]*b.m[2][3] + a.m[1][3],
+            a.m[2][0]*b.m[0][0] + a.m[2][1]*b.m[1][0] + a.m[2][2]*b.m[2][0],
+            a.m[2][0]*b.m[0][1] + a.m[2][1]*b.m[1][1] + a.m[2][2]*b.m[2][1],
+            a.m[2][0]*b.m[0][2] + a.m[2][1]*b.m[1][2] + a.m[2][2]*b.m[2][2],
+            a.m[2][0]*b.m[0][3] + a.m[2][1]*b.m[1][3] + a.m[2][2]*b.m[2][3] + a.m[2][3]);
+    }
+
+    // A * S, scales the columns of A
+    template<class T>
+    constexpr affine_t<T> operator *(const affine_t<T>& a, const scaling_t<T>& s)
+    {
+        return affine_t<T>(a.m[0][0]*s.x, a.m[0][1]*s.y, a.m[0][2]*s.z, a.m[0][3],
+                           a.m[1][0]*s.x, a.m[1][1]*s.y, a.m[1][2]*s.z, a.m[1][3],
+                           a.m[2][0]*s.x, a.m[2][1]*s.y, a.m[2][2]*s.z, a.m[2][3]);
+    }
+
+    // S * A, scales the rows of A
+    template<class T>
+    constexpr affine_t<T> operator *(const scaling_t<T>& s, const affine_t<T>& a)
+    {
+        return affine_t<T>(a.m[0][0]*s.x, a.m[0][1]*s.x, a.m[0][2]*s.x, a.m[0][3]*s.x,
+                           a.m[1][0]*s.y, a.m[1][1]*s.y, a.m[1][2]*s.y, a.m[1][3]*s.y,
+                           a.m[2][0]*s.z, a.m[2][1]*s.z, a.m[2][2]*s.z, a.m[2][3]*s.z);
+    }
+
+    // A * T, moves the translation of A by A's 3x3 times t
+    template<class T>
+    constexpr affine_t<T> operator *(const affine_t<T>& a, const translation_t<T>& t)
+    {
+        return affine_t<T>(a.m[0][0], a.m[0][1], a.m[0][2], a.m[0][0]*t.x + a.m[0][1]*t.y + a.m[0][2]*t.z + a.m[0][3],
+                           a.m[1][0], a.m[1][1], a.m[1][2], a.m[1][0]*t.x + a.m[1][1]*t.y + a.m[1][2]*t.z + a.m[1][3],
+                           a.m[2][0], a.m[2][1], a.m[2][2], a.m[2][0]*t.x + a.m[2][1]*t.y + a.m[2][2]*t.z + a.m[2][3]);
+    }
+
+    // T * A, adds t to the translation of A
+    template<class T>
+    constexpr affine_t<T> operator *(const translation_t<T>& t, const affine_t<T>& a)
+    {
+        return affine_t<T>(a.m[0][0], a.m[0][1], a.m[0][2], a.m[0][3] + t.x,
+                           a.m[1][0], a.m[1][1], a.m[1][2], a.m[1][3] + t.y,
+                           a.m[2][0], a.m[2][1], a.m[2][2], a.m[2][3] + t.z);
+    }
+
+    // A * R, rotates the 3x3 of A
+    template<class T>
+    constexpr affine_t<T> operator *(const affine_t<T>& a, const rotation_t<T>& r)
+    {
+        return affine_t<T>(
+            a.m[0][0]*r.m[0][0] + a.m[0][1]*r.m[1][0] + a.m[0][2]*r.m[2][0],
+            a.m[0][0]*r.m[0][1] + a.m[0][1]*r.m[1][1] + a.m[0][2]*r.m[2][1],
+            a.m[0][0]*r.m[0][2] + a.m[0][1]*r.m[1][2] + a.m[0][2]*r.m[2][2],
+            a.m[0][3],
+            a.m[1][0]*r.m[0][0] + a.m[1][1]*r.m[1][0] + a.m[1][2]*r.m[2][0],
+            a.m[1][0]*r.m[0][1] + a.m[1][1]*r.m[1][1] + a.m[1][2]*r.m[2][1],
+            a.m[1][0]*r.m[0][2] + a.m[1][1]*r.m[1][2] + a.m[1][2]*r.m[2][2],
+            a.m[1][3],
+            a.m[2][0]*r.m[0][0] + a.m[2][1]*r.m[1][0] + a.m[2][2]*r.m[2][0],
+            a.m[2][0]*r.m[0][1] + a.m[2][1]*r.m[1][1] + a.m[2][2]*r.m[2][1],
+            a.m[2][0]*r.m[0][2] + a.m[2][1]*r.m[1][2] + a.m[2][2]*r.m[2][2],
+            a.m[2][3]);
+    }
+
+    // R * A
+    template<class T>
+    constexpr affine_t<T> operator *(const rotation_t<T>& r, const affine_t<T>& a)
+    {
+        return affine_t<T>(r) * a;
+    }
+
+    //
+    // Mixed factors, through the specializations above. Converting the left
+    // factor is free, e.g. T * R = T * affine(R) only sets the translation
+    //
+
+    template<class T>
+    constexpr affine_t<T> operator *(const translation_t<T>& t, const rotation_t<T>& r) { return t * affine_t<T>(r); }
+
+    template<class T>
+    constexpr affine_t<T> operator *(const translation_t<T>& t, const scaling_t<T>& s) { return t * affine_t<T>(s); }
+
+    template<class T>
+    constexpr affine_t<T> operator *(const rotation_t<T>& r, const translation_t<T>& t) { return affine_t<T>(r) * t; }
+
+    template<class T>
+    constexpr affine_t<T> operator *(const rotation_t<T>& r, const scaling_t<T>& s) { return affine_t<T>(r) * s; }
+
+    template<class T>
+    constexpr affine_t<T> operator *(const scaling_t<T>& s, const translation_t<T>& t) { return affine_t<T>(s) * t; }
+
+    template<class T>
+    constexpr affine_t<T> operator *(const scaling_t<T>& s, const rotation_t<T>& r) { return s * affine_t<T>(r); }
+
+    //
+    // With general matrices, skipping the known bottom row of the affine side
+    //
+
+    template<class T>
+    inline mat4<T> operator *(const mat4<T>& M, const affine_t<T>& a)
+    {
+        mat4<T> R;
+        for (int j = 0; j < 4; j++)
+        {
+            const vec4<T> c = M.col[0] * a.m[0][j] + M.col[1] * a.m[1][j] + M.col[2] * a.m[2][j];
+            R.col[j] = j < 3 ? c : c + M.col[3];
+        }
+        return R;
+    }
+
+    template<class T>
+    inline mat4<T> operator *(const affine_t<T>& a, const mat4<T>& M)
+    {
+        mat4<T> R;
+        for (int j = 0; j < 4; j++)
+        {
+            const vec4<T>& c = M.col[j];
+            R.col[j] = vec4<T>(a.m[0][0]*c.x + a.m[0][1]*c.y + a.m[0][2]*c.z + a.m[0][3]*c.w,
+                               a.m[1][0]*c.x + a.m[1][1]*c.y + a.m[1][2]*c.z + a.m[1][3]*c.w,
+                               a.m[2][0]*c.x + a.m[2][1]*c.y + a.m[2][2]*c.z + a.m[2][3]*c.w,
+                               c.w);
+        }
+        return R;
+    }
+
+    typedef translation_t<float> translationf;
+    typedef scaling_t<float> scalingf;
+    typedef rotation_t<float> rotationf;
+    typedef affine_t<float> affinef;
+}
+
+#endif /* TRS_H */
@@ -12,6 +12,7 @@
 #include <cmath>
 #include <cstdio>
 #include <ostream>
+#include "simd.h"
 
 namespace linalg
 {
@@ -375,7 +376,7 @@ namespace linalg
     //
     // 4D vector
     //
-    template<class T> class vec4
+    template<class T> class LINALG_ALIGN vec4
     {
     public:
         union
@@ -479,6 +480,17 @@ namespace linalg
             return u * (T)(1.0/sqrt(norm2));
     }
     
+    //
+    // As normalize, but only the zero vector maps to zero, so that
+    // short vectors (e.g. sums over tiny faces) keep their direction
+    //
+    template<class T>
+    inline vec3<T> safe_normalize(const vec3<T>& u)
+    {
+        const T len = sqrt(dot(u, u));
+        return len > 0 ? u * (1 / len) : vec3<T>(0, 0, 0);
+    }
+    
     template<class T>
     inline vec4<T> normalize(const vec4<T>& u)
     {
@@ -496,6 +508,48 @@ namespace linalg
         return out << "(" << v.x << ", " << v.y << ", " << v.z << ", " << v.w << ")";
     }
     
+#ifdef LINALG_SSE
+    //
+    // SSE specializations for vec4<float>
+    //
+    template<>
+    inline vec4<float> vec4<float>::operator +(const vec4<float> &v) const
+    {
+        vec4<float> r;
+        _mm_storeu_ps(r.vec, _mm_add_ps(_mm_loadu_ps(vec), _mm_loadu_ps(v.vec)));
+        return r;
+    }
+    
+    template<>
+    inline vec4<float>& vec4<float>::operator += (const vec4<float>& v)
+    {
+        _mm_storeu_ps(vec, _mm_add_ps(_mm_loadu_ps(vec), _mm_loadu_ps(v.vec)));
+        return *this;
+    }
+    
+    template<>
+    inline vec4<float> vec4<float>::operator -(const vec4<float> &v) const
+    {
+        vec4<float> r;
+        _mm_storeu_ps(r.vec, _mm_sub_ps(_mm_loadu_ps(vec), _mm_loadu_ps(v.vec)));
+        return r;
+    }
+    
+    template<>
+    inline vec4<float> vec4<float>::operator *(const float &s) const
+    {
+        vec4<float> r;
+        _mm_storeu_ps(r.vec, _mm_mul_ps(_mm_loadu_ps(vec), _mm_set1_ps(s)));
+        return r;
+    }
+    
+    template<>
+    inline float dot(const vec4<float>& u, const vec4<float>& v)
+    {
+        return sse_hsum(_mm_mul_ps(_mm_loadu_ps(u.vec), _mm_loadu_ps(v.vec)));
+    }
+#endif
+    
     typedef vec2<float> float2;
     typedef vec3<float> float3;
     typedef vec4<float> float4;
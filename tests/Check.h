@@ -0,0 +1,84 @@
+//
+//  Check.h
+//
+//  Checks and timing for the headless tests and benchmarks
+//
+
+#pragma once
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+//
+// Number of failed checks so far
+//
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			std::printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			CheckFailures()++; \
+		} \
+	} while (0)
+
+// |a - b| <= eps
+#define CHECK_NEAR(a, b, eps) \
+	do { \
+		const double check_a = (a), check_b = (b); \
+		if (!(std::fabs(check_a - check_b) <= (eps))) { \
+			std::printf("%s(%d): CHECK_NEAR(%s, %s, %s) failed: %g vs %g\n", \
+				__FILE__, __LINE__, #a, #b, #eps, check_a, check_b); \
+			CheckFailures()++; \
+		} \
+	} while (0)
+
+//
+// Exit code of a test program, 1 if any check failed
+//
+inline int CheckResult()
+{
+	if (CheckFailures())
+	{
+		std::printf("%d checks failed\n", CheckFailures());
+		return 1;
+	}
+	std::printf("All checks passed\n");
+	return 0;
+}
+
+//
+// Fastest of reps runs of f, in milliseconds
+//
+template<class F>
+double BenchMs(int reps, F&& f)
+{
+	double best = 1e30;
+	for (int i = 0; i < reps; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		f();
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+	return best;
+}
+
+//
+// Keep a benchmark result alive, so that the work is not optimized away
+//
+template<class T>
+void Consume(const T& value)
+{
+	static volatile unsigned char sink;
+	sink = *(const volatile unsigned char*)&value;
+}
+
+#endif
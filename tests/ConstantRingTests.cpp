@@ -0,0 +1,111 @@
+//
+//  ConstantRingTests.cpp
+//
+//  Offsets, alignment and discards of ConstantRing allocations
+//
+
+#include <random>
+#include "Check.h"
+#include "ConstantRing.h"
+
+static void TestAlign()
+{
+	CHECK(ConstantRing::Align(0) == 0);
+	CHECK(ConstantRing::Align(1) == 256);
+	CHECK(ConstantRing::Align(256) == 256);
+	CHECK(ConstantRing::Align(257) == 512);
+	CHECK(ConstantRing(1000).Capacity() == 768);
+	CHECK(ConstantRing(255).Capacity() == 0);
+}
+
+// Ranges follow each other, the first one being a discard
+static void TestAllocate()
+{
+	ConstantRing ring(4096);
+	size_t offset = 1;
+	bool discard = false;
+
+	CHECK(ring.Allocate(192, offset, discard));
+	CHECK(offset == 0 && discard);
+	CHECK(ring.Head() == 256);
+
+	CHECK(ring.Allocate(256, offset, discard));
+	CHECK(offset == 256 && !discard);
+	CHECK(ring.Allocate(300, offset, discard));
+	CHECK(offset == 512 && !discard);
+	CHECK(ring.Head() == 1024);
+
+	// Empty and too large requests fail and leave the ring as it was
+	CHECK(!ring.Allocate(0, offset, discard));
+	CHECK(!ring.Allocate(4097, offset, discard));
+	CHECK(offset == 512 && ring.Head() == 1024);
+
+	// An empty ring allocates nothing
+	ConstantRing empty;
+	CHECK(!empty.Allocate(16, offset, discard));
+}
+
+// A range that does not fit before the end wraps to offset 0 with a
+// discard, and a range ending exactly at the end does not
+static void TestWrap()
+{
+	ConstantRing ring(1024);
+	size_t offset;
+	bool discard;
+
+	CHECK(ring.Allocate(512, offset, discard) && offset == 0 && discard);
+	CHECK(ring.Allocate(512, offset, discard) && offset == 512 && !discard);
+	CHECK(ring.Head() == 1024);
+	CHECK(ring.Allocate(256, offset, discard) && offset == 0 && discard);
+	CHECK(ring.Allocate(512, offset, discard) && offset == 256 && !discard);
+	CHECK(ring.Allocate(512, offset, discard) && offset == 0 && discard);
+
+	// A range of the whole ring discards every time
+	CHECK(ring.Allocate(1024, offset, discard) && offset == 0 && discard);
+	CHECK(ring.Allocate(1000, offset, discard) && offset == 0 && discard);
+}
+
+//
+// Random sizes: ranges are aligned, inside the ring, and between discards
+// never overlap, so none is written while the GPU may read it
+//
+static void TestRandom()
+{
+	ConstantRing ring(64 * 1024);
+	std::mt19937 rng(1);
+	size_t written_end = 0;	// end of the ranges since the last discard
+	unsigned discards = 0, failures = 0;
+	for (int i = 0; i < 100000; i++)
+	{
+		const size_t size = 1 + rng() % 3000;
+		size_t offset;
+		bool discard;
+		if (!ring.Allocate(size, offset, discard))
+		{
+			failures++;
+			continue;
+		}
+		failures += offset % ConstantRing::Alignment != 0;
+		failures += offset + size > ring.Capacity();
+		failures += discard != (offset == 0);
+		if (discard)
+		{
+			discards++;
+			written_end = 0;
+		}
+		failures += offset < written_end;
+		written_end = offset + ConstantRing::Align(size);
+		failures += ring.Head() != written_end;
+	}
+	CHECK(failures == 0);
+	CHECK(discards > 1000);
+}
+
+int main()
+{
+	TestAlign();
+	TestAllocate();
+	TestWrap();
+	TestRandom();
+	return CheckResult();
+}
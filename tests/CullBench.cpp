@@ -0,0 +1,203 @@
+//
+//  CullBench.cpp
+//
+//  Frustum culling of AABBs and spheres with cull_aabbs and cull_spheres,
+//  against a brute-force test of the 8 box corners, in world space and in
+//  model space through transform_planes. Built twice: CullBench with the
+//  SSE specializations and CullBenchScalar with LINALG_NO_SIMD
+//
+
+#include <memory>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/frustum.h"
+
+using namespace linalg;
+
+static const size_t N = 10000;
+static const int Reps = 50;
+
+// Decisions closer than this to a plane may go either way in float
+static const double Tolerance = 1e-3;
+
+static std::mt19937 rng(1);
+
+static float Uniform(float lo, float hi)
+{
+	return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+//
+// Normalized frustum planes of a view-projection matrix, as
+// Camera::get_FrustumPlanes extracts them
+//
+static void FrustumPlanes(const mat4f& M, vec4f* planes)
+{
+	const vec4f r1 = { M.m11, M.m12, M.m13, M.m14 };
+	const vec4f r2 = { M.m21, M.m22, M.m23, M.m24 };
+	const vec4f r3 = { M.m31, M.m32, M.m33, M.m34 };
+	const vec4f r4 = { M.m41, M.m42, M.m43, M.m44 };
+	planes[0] = r4 + r1;
+	planes[1] = r4 - r1;
+	planes[2] = r4 + r2;
+	planes[3] = r4 - r2;
+	planes[4] = r4 + r3;
+	planes[5] = r4 - r3;
+	for (int k = 0; k < FrustumPlaneCount; k++)
+		planes[k] = planes[k] * (1.0f / planes[k].xyz().norm2());
+}
+
+//
+// Signed distance, in double, of the least outside plane from the most
+// inside corner of the box transformed by M: the box is visible if it is
+// >= 0, i.e. no plane has all 8 corners outside
+//
+static double BoxMargin(const vec4f* planes, const mat4f& M, const aabb3f& box)
+{
+	double margin = 1e30;
+	for (int k = 0; k < FrustumPlaneCount; k++)
+	{
+		double farthest = -1e30;
+		for (int c = 0; c < 8; c++)
+		{
+			const vec4f corner = M * vec4f(
+				c & 1 ? box.max.x : box.min.x,
+				c & 2 ? box.max.y : box.min.y,
+				c & 4 ? box.max.z : box.min.z,
+				1);
+			const double dist = (double)planes[k].x * corner.x + (double)planes[k].y * corner.y +
+				(double)planes[k].z * corner.z + planes[k].w;
+			farthest = std::max(farthest, dist);
+		}
+		margin = std::min(margin, farthest);
+	}
+	return margin;
+}
+
+static double SphereMargin(const vec4f* planes, const vec4f& s)
+{
+	double margin = 1e30;
+	for (int k = 0; k < FrustumPlaneCount; k++)
+		margin = std::min(margin, (double)planes[k].x * s.x + (double)planes[k].y * s.y +
+			(double)planes[k].z * s.z + planes[k].w + s.w);
+	return margin;
+}
+
+//
+// Visibility against the brute-force margins. Returns the mismatches,
+// and counts the decisions within Tolerance, which are not compared
+//
+static size_t Mismatches(const std::vector<bool>& visible, const std::vector<double>& margin, size_t& close)
+{
+	size_t mismatches = 0;
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		if (std::fabs(margin[i]) < Tolerance)
+			close++;
+		else
+			mismatches += visible[i] != (margin[i] >= 0);
+	}
+	return mismatches;
+}
+
+static std::vector<bool> ToVector(const bool* visible, size_t n)
+{
+	return std::vector<bool>(visible, visible + n);
+}
+
+int main()
+{
+#ifdef LINALG_SSE
+	std::printf("SSE specializations\n");
+#else
+	std::printf("Generic templates\n");
+#endif
+
+	// A camera at the origin looking down -z, turned, with the volumes
+	// spread around it so that some are in view, some out and some cross
+	// the planes
+	const mat4f view = mat4f::rotation(0, 0.7f, 0.2f).inverse();
+	const mat4f view_projection = mat4f::projection(1.0f, 1.5f, 0.2f, 200.0f) * view;
+	vec4f planes[FrustumPlaneCount];
+	FrustumPlanes(view_projection, planes);
+
+	std::vector<aabb3f> boxes(N);
+	std::vector<vec4f> spheres(N);
+	for (size_t i = 0; i < N; i++)
+	{
+		const vec3f c(Uniform(-150, 150), Uniform(-150, 150), Uniform(-150, 150));
+		const vec3f e(Uniform(0.1f, 10), Uniform(0.1f, 10), Uniform(0.1f, 10));
+		boxes[i] = { c - e, c + e };
+		spheres[i] = vec4f(c, Uniform(0.1f, 10));
+	}
+
+	std::unique_ptr<bool[]> visible(new bool[N]);
+	std::vector<double> margin(N);
+	size_t nbr_visible = 0, close = 0;
+
+	// World space boxes
+	const mat4f identity = mat4f(1.0f);
+	const double boxes_ms = BenchMs(Reps, [&]() { nbr_visible = cull_aabbs(planes, boxes.data(), visible.get(), N); });
+	const double brute_ms = BenchMs(Reps / 10, [&]()
+	{
+		for (size_t i = 0; i < N; i++)
+			margin[i] = BoxMargin(planes, identity, boxes[i]);
+	});
+	CHECK(Mismatches(ToVector(visible.get(), N), margin, close) == 0);
+	CHECK(nbr_visible > N / 20 && nbr_visible < N / 2);
+	std::printf("cull_aabbs       %6zu boxes, %5zu visible %7.3f ms (%5.1f ns) | 8 corners %7.3f ms (%5.1f ns)\n",
+		N, nbr_visible, boxes_ms, boxes_ms * 1e6 / N, brute_ms, brute_ms * 1e6 / N);
+
+	// World space spheres
+	const double spheres_ms = BenchMs(Reps, [&]() { nbr_visible = cull_spheres(planes, spheres.data(), visible.get(), N); });
+	for (size_t i = 0; i < N; i++)
+		margin[i] = SphereMargin(planes, spheres[i]);
+	CHECK(Mismatches(ToVector(visible.get(), N), margin, close) == 0);
+	CHECK(nbr_visible > N / 20 && nbr_visible < N / 2);
+	std::printf("cull_spheres     %6zu spheres, %5zu visible %7.3f ms (%5.1f ns)\n",
+		N, nbr_visible, spheres_ms, spheres_ms * 1e6 / N);
+
+	// Model space boxes, one model-to-world matrix per box with rotation and
+	// non-uniform scaling, against the planes moved to model space. The
+	// brute force transforms the corners to world space instead. Spheres
+	// are not tested this way, since non-uniform scaling does not keep them
+	// spheres
+	std::vector<mat4f> model_to_world(N);
+	for (size_t i = 0; i < N; i++)
+	{
+		vec3f axis;
+		do
+			axis = vec3f(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1));
+		while (axis.norm2() < 0.1f);
+		model_to_world[i] = mat4f::translation(Uniform(-150, 150), Uniform(-150, 150), Uniform(-150, 150)) *
+			mat4f::rotation(Uniform(-fPI, fPI), normalize(axis)) *
+			mat4f::scaling(Uniform(0.2f, 5), Uniform(0.2f, 5), Uniform(0.2f, 5));
+		const vec3f e(Uniform(0.1f, 3), Uniform(0.1f, 3), Uniform(0.1f, 3));
+		boxes[i] = { -e, e };
+	}
+	const double model_ms = BenchMs(Reps, [&]()
+	{
+		nbr_visible = 0;
+		for (size_t i = 0; i < N; i++)
+		{
+			vec4f model_planes[FrustumPlaneCount];
+			transform_planes(model_to_world[i], planes, model_planes, FrustumPlaneCount);
+			nbr_visible += cull_aabbs(model_planes, &boxes[i], &visible[i], 1);
+		}
+	});
+	for (size_t i = 0; i < N; i++)
+		margin[i] = BoxMargin(planes, model_to_world[i], boxes[i]);
+	CHECK(Mismatches(ToVector(visible.get(), N), margin, close) == 0);
+	CHECK(nbr_visible > N / 20 && nbr_visible < N / 2);
+	std::printf("model space      %6zu boxes, %5zu visible %7.3f ms (%5.1f ns)\n",
+		N, nbr_visible, model_ms, model_ms * 1e6 / N);
+
+	// Only a few decisions are too close to call
+	CHECK(close < N / 100);
+	std::printf("%zu of %zu decisions within %g of a plane not compared\n", close, 3 * N, Tolerance);
+
+	return CheckResult();
+}
@@ -0,0 +1,163 @@
+//
+//  IndexBufferTests.cpp
+//
+//  Splitting and rebasing of index ranges by PackIndices
+//
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "IndexBuffer.h"
+
+//
+// Check that packed draws the same vertices as indices by ranges: each range
+// is covered in order by packed ranges of whole triangles with its mtl_index,
+// and index + ofs is the same in both
+//
+static void CheckSameDraws(
+	const std::vector<unsigned>& indices,
+	const std::vector<IndexRange>& ranges,
+	const PackedIndices& packed)
+{
+	CHECK(packed.Count() == indices.size());
+	CHECK(packed.ByteSize() == indices.size() * packed.index_size);
+
+	size_t next = 0;
+	for (const IndexRange& range : ranges)
+	{
+		unsigned covered = range.start;
+		while (covered < range.start + range.size || (!range.size && covered == range.start))
+		{
+			if (next == packed.ranges.size())
+			{
+				CHECK(next < packed.ranges.size());
+				return;
+			}
+			const IndexRange& sub = packed.ranges[next++];
+			CHECK(sub.start == covered);
+			CHECK(sub.size % 3 == 0);
+			CHECK(sub.mtl_index == range.mtl_index);
+			if (!sub.size)
+				break;
+
+			for (unsigned i = sub.start; i < sub.start + sub.size; i++)
+			{
+				const unsigned index = packed.index_size == 2 ? packed.indices16[i] : packed.indices32[i];
+				if (index + sub.ofs != indices[i] + range.ofs)
+				{
+					CHECK(index + sub.ofs == indices[i] + range.ofs);
+					return;
+				}
+			}
+			covered += sub.size;
+		}
+		CHECK(covered == range.start + range.size);
+	}
+	CHECK(next == packed.ranges.size());
+}
+
+// Ranges that fit in 16 bits are kept as they are, base vertex included
+static void TestFits()
+{
+	std::vector<unsigned> indices = { 0, 1, 2, 2, 1, 3, 65535, 0, 1 };
+	std::vector<IndexRange> ranges = { { 0, 6, 100, 0 }, { 6, 3, 0, 1 } };
+
+	PackedIndices packed = PackIndices(indices.data(), indices.size(), ranges);
+	CHECK(packed.index_size == 2);
+	CHECK(packed.ranges.size() == 2);
+	CHECK(packed.ranges[0].ofs == 100 && packed.ranges[1].ofs == 0);
+	CheckSameDraws(indices, ranges, packed);
+}
+
+// A range past vertex 65535 that spans less is rebased to its lowest index
+static void TestRebase()
+{
+	std::vector<unsigned> indices;
+	for (unsigned i = 0; i < 999; i++)
+		indices.push_back(70000 + i);
+	std::vector<IndexRange> ranges = { { 0, 6, 0, 0 }, { 6, 993, 5, 1 } };
+
+	PackedIndices packed = PackIndices(indices.data(), indices.size(), ranges);
+	CHECK(packed.index_size == 2);
+	CHECK(packed.ranges.size() == 2);
+	CHECK(packed.ranges[0].ofs == 70000);
+	CHECK(packed.ranges[1].ofs == 70011);
+	CHECK(packed.indices16[6] == 0);
+	CheckSameDraws(indices, ranges, packed);
+}
+
+// Ranges over more than 65536 vertices are split at triangle boundaries,
+// in mesh order, into subranges that each span at most 65536
+static void TestSplit()
+{
+	std::mt19937 rng(1);
+	std::vector<unsigned> indices;
+	std::vector<IndexRange> ranges;
+
+	// A strip of 300000 vertices, corners shuffled within each triangle
+	for (unsigned i = 0; i + 2 < 300000; i++)
+	{
+		unsigned tri[3] = { i, i + 1, i + 2 };
+		std::shuffle(tri, tri + 3, rng);
+		indices.insert(indices.end(), tri, tri + 3);
+	}
+	ranges.push_back({ 0, (unsigned)indices.size(), 0, 0 });
+
+	// Triangles scattered over 200000 vertices, each spanning up to 1000
+	const unsigned start = (unsigned)indices.size();
+	for (int t = 0; t < 50000; t++)
+	{
+		const unsigned base = rng() % 199000;
+		for (int c = 0; c < 3; c++)
+			indices.push_back(base + rng() % 1000);
+	}
+	ranges.push_back({ start, (unsigned)indices.size() - start, 7, 3 });
+
+	// An empty range, and a small one after the large ones
+	ranges.push_back({ (unsigned)indices.size(), 0, 0, 4 });
+	const unsigned last = (unsigned)indices.size();
+	indices.insert(indices.end(), { 0, 1, 2 });
+	ranges.push_back({ last, 3, 0, 5 });
+
+	PackedIndices packed = PackIndices(indices.data(), indices.size(), ranges);
+	CHECK(packed.index_size == 2);
+	CHECK(packed.ranges.size() > ranges.size() + 4);
+
+	// Split ranges are based at their lowest vertex
+	for (const IndexRange& sub : packed.ranges)
+		if (sub.size)
+			CHECK(*std::min_element(&packed.indices16[sub.start], &packed.indices16[sub.start] + sub.size) == 0);
+	CheckSameDraws(indices, ranges, packed);
+	std::printf("split %zu ranges into %zu\n", ranges.size(), packed.ranges.size());
+}
+
+// Triangles over more than 65536 vertices, or 16 bits not allowed, fall
+// back to 32-bit indices with the ranges as they were
+static void TestFallback()
+{
+	std::vector<unsigned> indices = { 0, 1, 2, 0, 1, 70000 };
+	std::vector<IndexRange> ranges = { { 0, 3, 0, 0 }, { 3, 3, 0, 1 } };
+
+	PackedIndices packed = PackIndices(indices.data(), indices.size(), ranges);
+	CHECK(packed.index_size == 4);
+	CHECK(packed.indices16.empty());
+	CHECK(packed.indices32 == indices);
+	CHECK(packed.ranges.size() == 2);
+	CheckSameDraws(indices, ranges, packed);
+
+	indices[5] = 2;
+	packed = PackIndices(indices.data(), indices.size(), ranges, false);
+	CHECK(packed.index_size == 4);
+	CHECK(packed.Data() == packed.indices32.data());
+	CheckSameDraws(indices, ranges, packed);
+}
+
+int main()
+{
+	TestFits();
+	TestRebase();
+	TestSplit();
+	TestFallback();
+	return CheckResult();
+}
@@ -0,0 +1,142 @@
+//
+//  InstancingBench.cpp
+//
+//  CPU cost per frame of drawing many copies of a model, as objects (cull,
+//  per-object matrices, a packet and constants per object) against
+//  ModelInstances (gather, instance data, a packet per batch)
+//
+
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "Instancing.h"
+#include "RenderQueue.h"
+#include "vec/transform.h"
+
+//
+// A unit cube without device buffers, whose draws do nothing
+//
+class BenchCube : public Model
+{
+public:
+	BenchCube() : Model(nullptr, nullptr)
+	{
+		std::shared_ptr<MeshAsset> cube = std::make_shared<MeshAsset>("cube");
+		cube->bounds = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+		mesh = cube;
+	}
+
+	void Draw(StateCache&, unsigned) const override { }
+
+	void DrawInstanced(StateCache&, unsigned, unsigned, unsigned) const override { }
+};
+
+// The per-object constants of the scene, each at ObjectStride in the ring
+struct ObjectConstants
+{
+	mat4f ModelToWorldMatrix;
+	mat4f ModelToClipMatrix;
+	mat4f NormalMatrix;
+};
+
+static const size_t ObjectStride = 256;
+
+static const unsigned NbrMaterials = 4;
+
+static void Bench(size_t n)
+{
+	BenchCube cube;
+	Material materials[NbrMaterials];
+
+	// Instances in [-80, 80]^3, about a quarter of them inside a frustum of
+	// the box [-50, 50]^3
+	const vec4f planes[6] = { { 1, 0, 0, 50 }, { -1, 0, 0, 50 }, { 0, 1, 0, 50 }, { 0, -1, 0, 50 }, { 0, 0, 1, 50 }, { 0, 0, -1, 50 } };
+	const mat4f world_to_clip = mat4f::projection(1.0f, 1.0f, 0.2f, 500.0f);
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-80, 80);
+	std::vector<mat4f> model_to_world(n);
+	std::vector<unsigned> material(n);
+	ModelInstances instances(&cube);
+	for (const Material& mtl : materials)
+		instances.AddMaterial(&mtl);
+	for (size_t i = 0; i < n; i++)
+	{
+		model_to_world[i] = mat4f::translation(position(rng), position(rng), position(rng));
+		material[i] = (unsigned)(i % NbrMaterials);
+		instances.AddInstance(model_to_world[i], material[i]);
+	}
+
+	std::vector<char> upload(n * ObjectStride);
+	std::vector<mat4f> queued_world, queued_clip, queued_normal;
+	std::vector<unsigned> queued_material;
+	RenderQueue queue;
+	size_t objects_visible = 0, objects_draws = 0, instances_visible = 0, instances_draws = 0;
+
+	const int reps = 10;
+	const double objects_ms = BenchMs(reps, [&]()
+	{
+		// Cull in model space, queue the visible objects, then write the
+		// matrices of each to its own constants
+		CullStats stats;
+		queued_world.clear();
+		queued_material.clear();
+		for (size_t i = 0; i < n; i++)
+		{
+			vec4f model_planes[6];
+			transform_planes(model_to_world[i], planes, model_planes, 6);
+			if (!cube.Cull(model_planes, stats))
+				continue;
+			queued_world.push_back(model_to_world[i]);
+			queued_material.push_back(material[i]);
+		}
+		const size_t visible = queued_world.size();
+		queued_clip.resize(visible);
+		queued_normal.resize(visible);
+		transform_matrices(world_to_clip, queued_world.data(), queued_clip.data(), visible);
+		normal_matrices(queued_world.data(), queued_normal.data(), visible);
+
+		for (size_t i = 0; i < visible; i++)
+			queue.Push(RenderQueue::MakeKey(0, 0, queued_material[i] + 1, queued_material[i] + 1, 1.0f + i), (unsigned)i, 0);
+		queue.Sort();
+		for (size_t i = 0; i < visible; i++)
+		{
+			ObjectConstants* constants = (ObjectConstants*)&upload[i * ObjectStride];
+			constants->ModelToWorldMatrix = queued_world[i];
+			constants->ModelToClipMatrix = queued_clip[i];
+			constants->NormalMatrix = queued_normal[i];
+		}
+		objects_visible = visible;
+		objects_draws = queue.Size();
+		queue.Clear();
+	});
+
+	const double instances_ms = BenchMs(reps, [&]()
+	{
+		// Gather, write the instance data, and queue one packet per batch
+		CullStats stats;
+		instances_visible = instances.Gather(planes, stats);
+		instances.WriteVisible((InstanceData*)upload.data());
+		for (const ModelInstances::Batch& batch : instances.Batches())
+			queue.Push(RenderQueue::MakeKey(0, 1, batch.material + 1, batch.material + 1, 0), batch.first, 0);
+		queue.Sort();
+		instances_draws = queue.Size();
+		queue.Clear();
+	});
+	Consume(upload[0]);
+
+	CHECK(objects_visible == instances_visible);
+	CHECK(instances_draws <= NbrMaterials);
+
+	std::printf("%7zu instances, %6zu visible | objects %8.3f ms, %6zu draws, %6zu KB | instanced %7.3f ms, %zu draws, %5zu KB\n",
+		n, objects_visible,
+		objects_ms, objects_draws, objects_visible * ObjectStride / 1024,
+		instances_ms, instances_draws, instances_visible * sizeof(InstanceData) / 1024);
+}
+
+int main()
+{
+	for (size_t n : { 1000, 10000, 100000 })
+		Bench(n);
+	return CheckResult();
+}
@@ -0,0 +1,114 @@
+//
+//  LinalgBench.cpp
+//
+//  Cost per operation of the hot mat4f and vec4f operations, and per
+//  composed translation * rotation * scaling transform, as mat4 products and
+//  as trs.h factors. Built twice: LinalgBench with the SSE specializations
+//  and LinalgBenchScalar with LINALG_NO_SIMD, the generic templates
+//
+
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/trs.h"
+
+using namespace linalg;
+
+static const int N = 1024;		// operands, small enough to stay in L1/L2
+static const int Reps = 200;
+
+static std::vector<mat4f> matrices(N);
+static std::vector<vec4f> vectors(N);
+
+// TRS factors, the rotation around y
+static std::vector<vec3f> translations(N), scales(N);
+static std::vector<float> angles(N);
+static std::vector<mat4f> rotations4(N);
+static std::vector<rotationf> rotations(N, rotationf(0, 0, 1, 0));
+
+//
+// Best time of f over all operands, in ns per operation
+//
+template<class F>
+static void Bench(const char* name, F&& f)
+{
+	const double ms = BenchMs(Reps, [&]()
+	{
+		for (int i = 0; i < N; i++)
+			f(i);
+	});
+	std::printf("%-24s %6.2f ns\n", name, ms * 1e6 / N);
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> U(-1.0f, 1.0f);
+	for (int i = 0; i < N; i++)
+	{
+		for (int k = 0; k < 16; k++)
+			matrices[i].array[k] = U(rng);
+		for (int k = 0; k < 4; k++)
+			matrices[i].mat[k][k] += 4.0f;
+		vectors[i] = vec4f(U(rng), U(rng), U(rng), U(rng));
+
+		translations[i] = vec3f(U(rng), U(rng), U(rng)) * 100.0f;
+		scales[i] = vec3f(U(rng), U(rng), U(rng)) + vec3f(2, 2, 2);
+		angles[i] = U(rng) * fPI;
+		rotations4[i] = mat4f::rotation(angles[i], 0, 1, 0);
+		rotations[i] = rotationf(angles[i], 0, 1, 0);
+	}
+
+#ifdef LINALG_SSE
+	std::printf("SSE specializations\n");
+#else
+	std::printf("Generic templates\n");
+#endif
+
+	std::vector<vec4f> vout(N);
+	std::vector<mat4f> mout(N);
+	float sum = 0;
+
+	Bench("mat4f * vec4f", [&](int i) { vout[i] = matrices[i] * vectors[i]; });
+	Bench("mat4f * mat4f", [&](int i) { mout[i] = matrices[i] * matrices[(i + 1) % N]; });
+	Bench("mat4f::determinant", [&](int i) { sum += matrices[i].determinant(); });
+	Bench("mat4f::inverse", [&](int i) { mout[i] = matrices[i].inverse(); });
+	Bench("mat4f * mat4f, inverse", [&](int i) { mout[i] = (matrices[i] * matrices[(i + 1) % N]).inverse(); });
+	Bench("vec4f + vec4f * float", [&](int i) { vout[i] = vectors[i] + vectors[(i + 1) % N] * 0.5f; });
+	Bench("dot(vec4f, vec4f)", [&](int i) { sum += dot(vectors[i], vectors[(i + 1) % N]); });
+
+	// Per composed transform, with the rotation from an angle (sin & cos)
+	// and from a precomputed matrix
+	Bench("T * R(angle) * S, mat4", [&](int i)
+	{
+		mout[i] = mat4f::translation(translations[i]) * mat4f::rotation(angles[i], 0, 1, 0) * mat4f::scaling(scales[i]);
+	});
+	Bench("T * R(angle) * S, trs.h", [&](int i)
+	{
+		mout[i] = translationf(translations[i]) * rotationf(angles[i], 0, 1, 0) * scalingf(scales[i]);
+	});
+	Bench("T * R * S, mat4", [&](int i)
+	{
+		mout[i] = mat4f::translation(translations[i]) * rotations4[i] * mat4f::scaling(scales[i]);
+	});
+	Bench("T * R * S, trs.h", [&](int i)
+	{
+		mout[i] = translationf(translations[i]) * rotations[i] * scalingf(scales[i]);
+	});
+
+	// Both chains compose the same transforms
+	for (int i = 0; i < N; i++)
+	{
+		const mat4f a = mat4f::translation(translations[i]) * rotations4[i] * mat4f::scaling(scales[i]);
+		const mat4f b = translationf(translations[i]) * rotations[i] * scalingf(scales[i]);
+		for (int k = 0; k < 16; k++)
+			CHECK_NEAR(a.array[k], b.array[k], 1e-4);
+	}
+
+	Consume(sum);
+	Consume(vout[N / 2]);
+	Consume(mout[N / 2]);
+	return CheckResult();
+}
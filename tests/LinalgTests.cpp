@@ -0,0 +1,570 @@
+//
+//  LinalgTests.cpp
+//
+//  The SSE specializations of mat4<float> and vec4<float> against the
+//  generic templates, instantiated for double as the reference, the
+//  structured inverses against the general one, the Euler angle
+//  rotations against each other, and batch transforms, quaternion
+//  interpolation and conversions against the same in double
+//
+
+#include <cfloat>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/quat.h"
+#include "vec/transform.h"
+
+using namespace linalg;
+
+typedef vec4<double> vec4d;
+typedef mat4<double> mat4d;
+
+static std::mt19937 rng(1);
+
+static float Uniform(float lo, float hi)
+{
+	return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+static mat4d ToDouble(const mat4f& m)
+{
+	mat4d M;
+	for (int i = 0; i < 16; i++)
+		M.array[i] = m.array[i];
+	return M;
+}
+
+static vec4d ToDouble(const vec4f& v)
+{
+	return vec4d(v.x, v.y, v.z, v.w);
+}
+
+// Largest elementwise difference
+static double MaxDiff(const mat4f& m, const mat4d& M)
+{
+	double diff = 0;
+	for (int i = 0; i < 16; i++)
+		diff = std::max(diff, std::fabs(m.array[i] - M.array[i]));
+	return diff;
+}
+
+static double MaxDiff(const mat4d& m, const mat4d& M)
+{
+	double diff = 0;
+	for (int i = 0; i < 16; i++)
+		diff = std::max(diff, std::fabs(m.array[i] - M.array[i]));
+	return diff;
+}
+
+static double MaxDiff(const vec4f& v, const vec4d& V)
+{
+	double diff = 0;
+	for (int i = 0; i < 4; i++)
+		diff = std::max(diff, std::fabs(v.vec[i] - V.vec[i]));
+	return diff;
+}
+
+static double MaxAbs(const mat4d& M)
+{
+	double m = 0;
+	for (int i = 0; i < 16; i++)
+		m = std::max(m, std::fabs(M.array[i]));
+	return m;
+}
+
+static vec4f RandomVec4()
+{
+	return vec4f(Uniform(-10, 10), Uniform(-10, 10), Uniform(-10, 10), Uniform(-10, 10));
+}
+
+static mat4f RandomMat4()
+{
+	mat4f m;
+	for (int i = 0; i < 16; i++)
+		m.array[i] = Uniform(-1, 1);
+	return m;
+}
+
+// Well-conditioned: diagonally dominant, to compare inverses elementwise
+static mat4f RandomInvertible()
+{
+	mat4f m = RandomMat4();
+	for (int i = 0; i < 4; i++)
+		m.mat[i][i] += Uniform(0, 1) < 0.5f ? -4.0f : 4.0f;
+	return m;
+}
+
+static mat4f RandomTRS()
+{
+	vec3f axis(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1));
+	axis.normalize();
+	return mat4f::translation(Uniform(-100, 100), Uniform(-100, 100), Uniform(-100, 100)) *
+		mat4f::rotation(Uniform(-fPI, fPI), axis) *
+		mat4f::scaling(Uniform(0.1f, 10), Uniform(0.1f, 10), Uniform(0.1f, 10));
+}
+
+//
+// vec4<float> +, +=, -, * and dot, elementwise float ops that match exactly
+//
+static void TestVec4()
+{
+	for (int i = 0; i < 10000; i++)
+	{
+		const vec4f u = RandomVec4(), v = RandomVec4();
+		const float s = Uniform(-10, 10);
+
+		const vec4f sum = u + v, diff = u - v, scaled = u * s;
+		vec4f acc = u;
+		acc += v;
+		for (int k = 0; k < 4; k++)
+		{
+			CHECK(sum.vec[k] == u.vec[k] + v.vec[k]);
+			CHECK(acc.vec[k] == sum.vec[k]);
+			CHECK(diff.vec[k] == u.vec[k] - v.vec[k]);
+			CHECK(scaled.vec[k] == u.vec[k] * s);
+		}
+		CHECK_NEAR(dot(u, v), dot(ToDouble(u), ToDouble(v)), 400 * 4 * FLT_EPSILON);
+	}
+}
+
+//
+// mat4<float> * vec4<float> and * mat4<float>, within float rounding of
+// sums of four products
+//
+static void TestProducts()
+{
+	double max_vec = 0, max_mat = 0;
+	for (int i = 0; i < 10000; i++)
+	{
+		const mat4f a = i & 1 ? RandomMat4() : RandomTRS(), b = i & 2 ? RandomMat4() : RandomTRS();
+		const vec4f v = RandomVec4();
+		const mat4d A = ToDouble(a), B = ToDouble(b);
+		const vec4d V = ToDouble(v);
+
+		const mat4d AB = A * B;
+		const vec4d AV = A.col[0] * V.x + A.col[1] * V.y + A.col[2] * V.z + A.col[3] * V.w;
+		const double scale_mat = MaxAbs(A) * MaxAbs(B) * 4;
+		const double scale_vec = MaxAbs(A) * 10 * 4;
+
+		max_mat = std::max(max_mat, MaxDiff(a * b, AB) / scale_mat);
+		max_vec = std::max(max_vec, MaxDiff(a * v, AV) / scale_vec);
+	}
+	CHECK(max_mat < 4 * FLT_EPSILON);
+	CHECK(max_vec < 4 * FLT_EPSILON);
+	std::printf("products: max error %.3g (mat4), %.3g (vec4), relative to the largest terms\n", max_mat, max_vec);
+
+	// Exact for integer-valued matrices
+	mat4f a, b;
+	for (int i = 0; i < 16; i++)
+	{
+		a.array[i] = (float)(i % 5) - 2;
+		b.array[i] = (float)(i * 7 % 11) - 5;
+	}
+	CHECK(MaxDiff(a * b, ToDouble(a) * ToDouble(b)) == 0);
+}
+
+//
+// mat4<float>::inverse and determinant by 2x2 blocks, against the cofactor
+// expansion of the generic template
+//
+static void TestInverse()
+{
+	double max_det = 0, max_inv = 0, max_identity = 0;
+	for (int i = 0; i < 10000; i++)
+	{
+		const mat4f m = i & 1 ? RandomInvertible() : RandomTRS();
+		const mat4d M = ToDouble(m);
+
+		const double det = M.determinant();
+		max_det = std::max(max_det, std::fabs(m.determinant() - det) / std::fabs(det));
+
+		const mat4f inv = m.inverse();
+		const mat4d INV = M.inverse();
+		max_inv = std::max(max_inv, MaxDiff(inv, INV) / MaxAbs(INV));
+		max_identity = std::max(max_identity, MaxDiff(inv * m, mat4d(1.0)) / (MaxAbs(INV) * MaxAbs(M)));
+	}
+	CHECK(max_det < 1e-5);
+	CHECK(max_inv < 1e-4);
+	CHECK(max_identity < 1e-5);
+	std::printf("inverse: max relative error %.3g (determinant), %.3g (inverse), %.3g (inv * m - I)\n",
+		max_det, max_inv, max_identity);
+
+	// Singular
+	mat4f singular = RandomMat4();
+	singular.col[3] = singular.col[0] + singular.col[1];
+	CHECK(std::fabs(singular.determinant()) < 1e-5f);
+}
+
+//
+// Upper 3x4 of M, with the bottom row (0, 0, 0, 1) of an affine matrix
+//
+static mat4d Affine(const mat4d& M)
+{
+	mat4d A = M;
+	A.m41 = A.m42 = A.m43 = 0;
+	A.m44 = 1;
+	return A;
+}
+
+//
+// inverse_affine on TRS and sheared matrices, inverse_rigid on TR matrices,
+// and normal_matrix/normal_matrices against the inverse transpose, all by
+// the general inverse in double
+//
+static void TestStructuredInverses()
+{
+	double max_affine = 0, max_affine_generic = 0, max_rigid = 0, max_normal = 0;
+	const int n = 10001;	// odd, for the scalar tail of the batch
+	std::vector<mat4f> in(n), normal(n), normal_mt(n);
+	for (int i = 0; i < n; i++)
+	{
+		mat4f m = RandomTRS();
+		if (i & 1)
+		{
+			// Shear
+			m.m12 += Uniform(-1, 1);
+			m.m31 += Uniform(-1, 1);
+		}
+		in[i] = m;
+		const mat4d INV = ToDouble(m).inverse();
+
+		max_affine = std::max(max_affine, MaxDiff(inverse_affine(m), INV) / MaxAbs(INV));
+		const mat4d A = inverse_affine(ToDouble(m));
+		for (int k = 0; k < 16; k++)
+			max_affine_generic = std::max(max_affine_generic, std::fabs(A.array[k] - INV.array[k]) / MaxAbs(INV));
+
+		vec3f axis(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1));
+		axis.normalize();
+		const mat4f r = mat4f::translation(Uniform(-100, 100), Uniform(-100, 100), Uniform(-100, 100)) *
+			mat4f::rotation(Uniform(-fPI, fPI), axis);
+		const mat4d RINV = ToDouble(r).inverse();
+		max_rigid = std::max(max_rigid, MaxDiff(inverse_rigid(r), RINV) / MaxAbs(RINV));
+	}
+	CHECK(max_affine < 1e-5);
+	CHECK(max_affine_generic < 1e-12);
+	CHECK(max_rigid < 1e-5);
+
+	// Exact bottom rows
+	const mat4f inv = inverse_affine(in[0]), rinv = inverse_rigid(in[0]);
+	CHECK(inv.m41 == 0 && inv.m42 == 0 && inv.m43 == 0 && inv.m44 == 1);
+	CHECK(rinv.m41 == 0 && rinv.m42 == 0 && rinv.m43 == 0 && rinv.m44 == 1);
+
+	normal_matrices(in.data(), normal.data(), n);
+	normal_matrices(in.data(), normal_mt.data(), n, 0);
+	for (int i = 0; i < n; i++)
+	{
+		// Without the translation, which the transpose moves to the bottom row
+		const mat4d N = Affine(transpose(ToDouble(in[i]).inverse()));
+		max_normal = std::max(max_normal, MaxDiff(normal[i], N) / MaxAbs(N));
+		CHECK(MaxDiff(normal_mt[i], ToDouble(normal[i])) == 0);
+		if (i < 100)
+			CHECK(MaxDiff(normal_matrix(in[i]), N) / MaxAbs(N) < 1e-5);
+	}
+	CHECK(max_normal < 1e-5);
+	std::printf("structured inverses: max relative error %.3g (affine), %.3g (affine, double), %.3g (rigid), %.3g (normal)\n",
+		max_affine, max_affine_generic, max_rigid, max_normal);
+}
+
+//
+// mat4::rotation(roll, yaw, pitch) and quat::rotation(roll, yaw, pitch)
+// against R_z(roll) * R_y(yaw) * R_x(pitch) from axis-angle matrices
+//
+static void TestEulerRotations()
+{
+	double max_mat = 0, max_quat = 0, max_quatf = 0;
+	for (int i = 0; i < 10000; i++)
+	{
+		const float roll = Uniform(-fPI, fPI), yaw = Uniform(-fPI, fPI), pitch = Uniform(-fPI, fPI);
+		const mat4d R = mat4d::rotation(roll, 0, 0, 1) * mat4d::rotation(yaw, 0, 1, 0) * mat4d::rotation(pitch, 1, 0, 0);
+
+		max_mat = std::max(max_mat, MaxDiff(mat4d::rotation(roll, yaw, pitch), R));
+		max_quat = std::max(max_quat, MaxDiff(quat<double>::rotation(roll, yaw, pitch).to_mat4(), R));
+		max_quatf = std::max(max_quatf, MaxDiff(quatf::rotation(roll, yaw, pitch).to_mat4(), R));
+	}
+	CHECK(max_mat < 1e-12);
+	CHECK(max_quat < 1e-12);
+	CHECK(max_quatf < 1e-5);
+	std::printf("euler rotations: max error %.3g (mat4), %.3g (quat), %.3g (quatf)\n", max_mat, max_quat, max_quatf);
+}
+
+// Largest difference of the xyz components, relative to the largest of b
+static double RelativeDiff(const vec3f& a, const vec4d& b)
+{
+	double diff = 0, scale = 1;
+	for (int k = 0; k < 3; k++)
+	{
+		diff = std::max(diff, std::fabs(a.vec[k] - b.vec[k]));
+		scale = std::max(scale, std::fabs(b.vec[k]));
+	}
+	return diff / scale;
+}
+
+static bool Same(const vec3f& a, const vec3f& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+//
+// transform_points and transform_directions, AoS and SoA, against M * (p, 1)
+// and M * (d, 0) in double, and transform_aabbs against the bounds of the 8
+// transformed corners. Counts leave a scalar tail after the SIMD groups,
+// and batches are transformed in place and on 1 and 4 threads, for which
+// the largest is enough to be split on a multicore machine
+//
+static void TestBatchTransforms()
+{
+	double max_points = 0, max_directions = 0, max_soa = 0, max_aabbs = 0;
+	size_t in_place_mismatches = 0;
+	for (size_t n : { 1, 3, 7, 1001, 100003 })
+	{
+		const mat4f M = RandomTRS();
+		const mat4d MD = ToDouble(M);
+		std::vector<vec3f> in(n);
+		std::vector<aabb3f> boxes(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			in[i] = vec3f(Uniform(-10, 10), Uniform(-10, 10), Uniform(-10, 10));
+			const vec3f e(Uniform(0, 5), Uniform(0, 5), Uniform(0, 5));
+			boxes[i] = { in[i] - e, in[i] + e };
+		}
+
+		for (unsigned max_threads : { 1, 4 })
+		{
+			std::vector<vec3f> points(n), directions(n), in_place = in;
+			transform_points(M, in.data(), points.data(), n, max_threads);
+			transform_directions(M, in.data(), directions.data(), n, max_threads);
+			transform_points(M, in_place.data(), in_place.data(), n, max_threads);
+			for (size_t i = 0; i < n; i++)
+			{
+				const vec4d p = MD.col[0] * in[i].x + MD.col[1] * in[i].y + MD.col[2] * in[i].z;
+				max_points = std::max(max_points, RelativeDiff(points[i], p + MD.col[3]));
+				max_directions = std::max(max_directions, RelativeDiff(directions[i], p));
+				in_place_mismatches += !Same(in_place[i], points[i]);
+			}
+
+			// SoA, out of place for points and in place for directions
+			std::vector<float> x(n), y(n), z(n), out_x(n), out_y(n), out_z(n);
+			for (size_t i = 0; i < n; i++)
+			{
+				x[i] = in[i].x;
+				y[i] = in[i].y;
+				z[i] = in[i].z;
+			}
+			transform_points(M, x.data(), y.data(), z.data(), out_x.data(), out_y.data(), out_z.data(), n, max_threads);
+			transform_directions(M, x.data(), y.data(), z.data(), x.data(), y.data(), z.data(), n, max_threads);
+			for (size_t i = 0; i < n; i++)
+			{
+				const vec4d p = MD.col[0] * in[i].x + MD.col[1] * in[i].y + MD.col[2] * in[i].z;
+				max_soa = std::max(max_soa, RelativeDiff(vec3f(out_x[i], out_y[i], out_z[i]), p + MD.col[3]));
+				max_soa = std::max(max_soa, RelativeDiff(vec3f(x[i], y[i], z[i]), p));
+			}
+
+			std::vector<aabb3f> out_boxes(n), in_place_boxes = boxes;
+			transform_aabbs(M, boxes.data(), out_boxes.data(), n, max_threads);
+			transform_aabbs(M, in_place_boxes.data(), in_place_boxes.data(), n, max_threads);
+			for (size_t i = 0; i < n; i++)
+			{
+				vec4d lo(1e30, 1e30, 1e30, 0), hi(-1e30, -1e30, -1e30, 0);
+				for (int c = 0; c < 8; c++)
+				{
+					const vec3f& a = boxes[i].min;
+					const vec3f& b = boxes[i].max;
+					const vec4d corner = MD.col[0] * (c & 1 ? b.x : a.x) + MD.col[1] * (c & 2 ? b.y : a.y) +
+						MD.col[2] * (c & 4 ? b.z : a.z) + MD.col[3];
+					for (int k = 0; k < 3; k++)
+					{
+						lo.vec[k] = std::min(lo.vec[k], corner.vec[k]);
+						hi.vec[k] = std::max(hi.vec[k], corner.vec[k]);
+					}
+				}
+				max_aabbs = std::max(max_aabbs, std::max(RelativeDiff(out_boxes[i].min, lo), RelativeDiff(out_boxes[i].max, hi)));
+				in_place_mismatches += !Same(in_place_boxes[i].min, out_boxes[i].min) || !Same(in_place_boxes[i].max, out_boxes[i].max);
+			}
+		}
+	}
+	CHECK(max_points < 2e-6);
+	CHECK(max_directions < 2e-6);
+	CHECK(max_soa < 2e-6);
+	CHECK(max_aabbs < 1e-5);
+	CHECK(in_place_mismatches == 0);
+	std::printf("batch transforms: max relative error %.3g (points), %.3g (directions), %.3g (SoA), %.3g (AABBs)\n",
+		max_points, max_directions, max_soa, max_aabbs);
+}
+
+typedef quat<double> quatd;
+
+static quatf RandomQuat()
+{
+	quatf q;
+	do
+		q = quatf(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1));
+	while (dot(q, q) < 0.1f);
+	return q.normalize();
+}
+
+static quatd ToDouble(const quatf& q)
+{
+	return quatd(q.x, q.y, q.z, q.w);
+}
+
+static double MaxDiff(const quatf& q, const quatd& Q)
+{
+	double diff = 0;
+	for (int i = 0; i < 4; i++)
+		diff = std::max(diff, std::fabs(q.vec[i] - Q.vec[i]));
+	return diff;
+}
+
+// The same rotation, q or -q
+static double RotationDiff(const quatf& q, const quatd& Q)
+{
+	return std::min(MaxDiff(q, Q), MaxDiff(q, -Q));
+}
+
+// Slerp with acos and sin, in double
+static quatd ReferenceSlerp(const quatd& a, quatd b, double t)
+{
+	double d = dot(a, b);
+	if (d < 0)
+	{
+		b = -b;
+		d = -d;
+	}
+	const double theta = std::acos(std::min(d, 1.0));
+	if (theta < 1e-12)
+		return a;
+	return a * (std::sin((1 - t) * theta) / std::sin(theta)) + b * (std::sin(t * theta) / std::sin(theta));
+}
+
+//
+// Batched slerp against slerp with trigonometry in double, and batched
+// nlerp against nlerp, over a count that leaves a scalar tail, with
+// random, nearby, identical and antipodal pairs, and in place
+//
+static void TestQuatInterpolation()
+{
+	const size_t n = 1003;
+	std::vector<quatf> a(n), b(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		a[i] = RandomQuat();
+		switch (i % 5)
+		{
+		case 0: b[i] = RandomQuat(); break;
+		case 1: b[i] = (a[i] + RandomQuat() * 0.01f).normalize(); break;
+		case 2: b[i] = a[i]; break;
+		case 3: b[i] = -a[i]; break;
+		case 4: b[i] = -(a[i] + RandomQuat() * 0.3f).normalize(); break;
+		}
+	}
+
+	std::vector<quatf> out(n), in_place(n);
+	double max_slerp = 0, max_nlerp = 0, max_in_place = 0, max_norm = 0;
+	for (float t : { 0.0f, 0.1f, 0.37f, 0.5f, 0.9f, 1.0f })
+	{
+		slerp(a.data(), b.data(), t, out.data(), n);
+		in_place = a;
+		slerp(in_place.data(), b.data(), t, in_place.data(), n);
+		for (size_t i = 0; i < n; i++)
+		{
+			max_slerp = std::max(max_slerp, MaxDiff(out[i], ReferenceSlerp(ToDouble(a[i]), ToDouble(b[i]), t)));
+			max_in_place = std::max(max_in_place, MaxDiff(in_place[i], ToDouble(out[i])));
+			max_norm = std::max(max_norm, std::fabs(dot(ToDouble(out[i]), ToDouble(out[i])) - 1));
+		}
+
+		nlerp(a.data(), b.data(), t, out.data(), n);
+		in_place = b;
+		nlerp(a.data(), in_place.data(), t, in_place.data(), n);
+		for (size_t i = 0; i < n; i++)
+		{
+			max_nlerp = std::max(max_nlerp, MaxDiff(out[i], ToDouble(nlerp(a[i], b[i], t))));
+			max_in_place = std::max(max_in_place, MaxDiff(in_place[i], ToDouble(out[i])));
+		}
+	}
+	CHECK(max_slerp < 1e-6);
+	CHECK(max_norm < 2e-6);
+	CHECK(max_nlerp < 4 * FLT_EPSILON);
+	CHECK(max_in_place == 0);
+	std::printf("batched slerp: max error %.3g, |q|^2 - 1 %.3g; batched nlerp: max difference %.3g\n",
+		max_slerp, max_norm, max_nlerp);
+}
+
+//
+// quat -> mat3 -> quat round trips, through each branch of from_matrix: w,
+// x, y or z the largest component, against the quaternion in double. And
+// dual quaternions to and from matrices, against translation * rotation
+//
+static void TestQuatMatrices()
+{
+	int branches[4] = {};
+	double max_round_trip = 0, max_mat = 0;
+	for (int i = 0; i < 10000; i++)
+	{
+		// Component i % 4 of x, y, z, w the largest
+		quatf q = RandomQuat() * 0.5f;
+		q.vec[i % 4] = q.vec[i % 4] < 0 ? -1.0f : 1.0f;
+		q.normalize();
+
+		const mat3f m = q.to_mat3();
+		const int branch = m.m11 + m.m22 + m.m33 > 0 ? 3 : m.m11 > m.m22 && m.m11 > m.m33 ? 0 : m.m22 > m.m33 ? 1 : 2;
+		branches[branch]++;
+		max_round_trip = std::max(max_round_trip, RotationDiff(quatf::from_matrix(m), ToDouble(q)));
+		max_round_trip = std::max(max_round_trip, RotationDiff(quatf::from_matrix(q.to_mat4()), ToDouble(q)));
+
+		// Against the axis-angle matrix, in double
+		const quatd Q = ToDouble(q);
+		const double angle = 2 * std::atan2(std::sqrt(Q.x * Q.x + Q.y * Q.y + Q.z * Q.z), Q.w);
+		const mat4d R = mat4d::rotation(angle, Q.xyz() * (1 / Q.xyz().norm2()));
+		max_mat = std::max(max_mat, MaxDiff(q.to_mat4(), R));
+		max_round_trip = std::max(max_round_trip, RotationDiff(quatf::from_matrix(mat3f(
+			(float)R.m11, (float)R.m12, (float)R.m13,
+			(float)R.m21, (float)R.m22, (float)R.m23,
+			(float)R.m31, (float)R.m32, (float)R.m33)), Q));
+	}
+	for (int count : branches)
+		CHECK(count > 1000);
+	CHECK(max_round_trip < 1e-6);
+	CHECK(max_mat < 1e-6);
+
+	double max_dualquat = 0, max_from_matrix = 0, max_point = 0;
+	for (int i = 0; i < 10000; i++)
+	{
+		const quatf q = RandomQuat();
+		const vec3f t(Uniform(-100, 100), Uniform(-100, 100), Uniform(-100, 100));
+		const mat4d M = mat4d::translation(t.x, t.y, t.z) * ToDouble(q).to_mat4();
+
+		const dualquatf dq(q, t);
+		max_dualquat = std::max(max_dualquat, MaxDiff(dq.to_mat4(), M) / 100);
+		max_from_matrix = std::max(max_from_matrix, MaxDiff(dualquatf::from_matrix(mat4f::translation(t) * q.to_mat4()).to_mat4(), M) / 100);
+
+		const vec3f p(Uniform(-10, 10), Uniform(-10, 10), Uniform(-10, 10));
+		const vec3f tp = dq.transform_point(p);
+		const vec4d MP = M.col[0] * p.x + M.col[1] * p.y + M.col[2] * p.z + M.col[3];
+		max_point = std::max(max_point, MaxDiff(vec4f(tp, 1), MP) / 100);
+	}
+	CHECK(max_dualquat < 1e-6);
+	CHECK(max_from_matrix < 1e-6);
+	CHECK(max_point < 1e-6);
+	std::printf("quat -> mat3 -> quat: max error %.3g (branches w %d, x %d, y %d, z %d), to_mat4 %.3g; "
+		"dualquat to_mat4 %.3g, from_matrix %.3g, points %.3g (relative to |t|)\n",
+		max_round_trip, branches[3], branches[0], branches[1], branches[2], max_mat, max_dualquat, max_from_matrix, max_point);
+}
+
+int main()
+{
+#ifndef LINALG_SSE
+	std::printf("LINALG_SSE is off, testing the generic templates for float\n");
+#endif
+	TestVec4();
+	TestProducts();
+	TestInverse();
+	TestStructuredInverses();
+	TestEulerRotations();
+	TestBatchTransforms();
+	TestQuatInterpolation();
+	TestQuatMatrices();
+	return CheckResult();
+}
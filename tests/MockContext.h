@@ -0,0 +1,247 @@
+//
+//  MockContext.h
+//
+//  A device context stand-in for StateCacheT, which applies binding calls
+//  to plain state and counts them
+//
+
+#pragma once
+#ifndef MOCKCONTEXT_H
+#define MOCKCONTEXT_H
+
+#include <cstdint>
+#include <cstring>
+#include "stdafx.h"
+
+//
+// Distinct fake COM pointers, never dereferenced
+//
+template<class T>
+T* Fake(uintptr_t id)
+{
+	return reinterpret_cast<T*>(id * 16);
+}
+
+//
+// Bindings as the pipeline sees them
+//
+struct MockState
+{
+	static const UINT Slots = 32;	// past StateCacheT::MaxSlots, for unfiltered calls
+
+	struct ConstantBuffer
+	{
+		ID3D11Buffer* buffer;
+		UINT first_constant;
+		UINT nbr_constants;	// 0 for the whole buffer
+
+		bool operator ==(const ConstantBuffer& b) const
+		{
+			return buffer == b.buffer && first_constant == b.first_constant && nbr_constants == b.nbr_constants;
+		}
+	};
+
+	struct Stage
+	{
+		ConstantBuffer constant_buffers[Slots];
+		ID3D11ShaderResourceView* resources[Slots];
+		ID3D11SamplerState* samplers[Slots];
+
+		bool operator ==(const Stage& s) const
+		{
+			for (UINT i = 0; i < Slots; i++)
+				if (!(constant_buffers[i] == s.constant_buffers[i]) || resources[i] != s.resources[i] || samplers[i] != s.samplers[i])
+					return false;
+			return true;
+		}
+	};
+
+	ID3D11InputLayout* input_layout;
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	ID3D11Buffer* vertex_buffers[Slots];
+	UINT strides[Slots];
+	UINT offsets[Slots];
+	ID3D11Buffer* index_buffer;
+	DXGI_FORMAT index_format;
+	UINT index_offset;
+	ID3D11VertexShader* vs;
+	ID3D11PixelShader* ps;
+	Stage vs_stage, ps_stage;
+
+	MockState()
+	{
+		std::memset(this, 0, sizeof(*this));
+	}
+
+	bool operator ==(const MockState& s) const
+	{
+		for (UINT i = 0; i < Slots; i++)
+			if (vertex_buffers[i] != s.vertex_buffers[i] || strides[i] != s.strides[i] || offsets[i] != s.offsets[i])
+				return false;
+		return input_layout == s.input_layout && topology == s.topology &&
+			index_buffer == s.index_buffer && index_format == s.index_format && index_offset == s.index_offset &&
+			vs == s.vs && ps == s.ps && vs_stage == s.vs_stage && ps_stage == s.ps_stage;
+	}
+};
+
+//
+// Calls per method
+//
+struct MockCalls
+{
+	unsigned input_layout = 0, topology = 0, vertex_buffers = 0, index_buffer = 0;
+	unsigned vs = 0, vs_constant_buffers = 0, vs_constant_buffers1 = 0, vs_resources = 0, vs_samplers = 0;
+	unsigned ps = 0, ps_constant_buffers = 0, ps_constant_buffers1 = 0, ps_resources = 0, ps_samplers = 0;
+	unsigned draws = 0;
+
+	unsigned Bindings() const
+	{
+		return input_layout + topology + vertex_buffers + index_buffer +
+			vs + vs_constant_buffers + vs_constant_buffers1 + vs_resources + vs_samplers +
+			ps + ps_constant_buffers + ps_constant_buffers1 + ps_resources + ps_samplers;
+	}
+};
+
+//
+// The binding and draw methods of ID3D11DeviceContext1 that StateCacheT
+// calls. Each draw stores the state it draws with
+//
+class MockContext
+{
+public:
+	MockState state;
+	MockState drawn;	// state at the last draw
+	MockCalls calls;
+
+	void STDMETHODCALLTYPE IASetInputLayout(ID3D11InputLayout* layout)
+	{
+		state.input_layout = layout;
+		calls.input_layout++;
+	}
+
+	void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+	{
+		state.topology = topology;
+		calls.topology++;
+	}
+
+	void STDMETHODCALLTYPE IASetVertexBuffers(UINT start_slot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+	{
+		for (UINT i = 0; i < count; i++)
+		{
+			state.vertex_buffers[start_slot + i] = buffers[i];
+			state.strides[start_slot + i] = strides[i];
+			state.offsets[start_slot + i] = offsets[i];
+		}
+		calls.vertex_buffers++;
+	}
+
+	void STDMETHODCALLTYPE IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+	{
+		state.index_buffer = buffer;
+		state.index_format = format;
+		state.index_offset = offset;
+		calls.index_buffer++;
+	}
+
+	void STDMETHODCALLTYPE VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const*, UINT)
+	{
+		state.vs = shader;
+		calls.vs++;
+	}
+
+	void STDMETHODCALLTYPE VSSetConstantBuffers(UINT start_slot, UINT count, ID3D11Buffer* const* buffers)
+	{
+		SetConstantBuffers(state.vs_stage, start_slot, count, buffers, nullptr, nullptr);
+		calls.vs_constant_buffers++;
+	}
+
+	void STDMETHODCALLTYPE VSSetConstantBuffers1(UINT start_slot, UINT count, ID3D11Buffer* const* buffers, const UINT* first_constants, const UINT* nbr_constants)
+	{
+		SetConstantBuffers(state.vs_stage, start_slot, count, buffers, first_constants, nbr_constants);
+		calls.vs_constant_buffers1++;
+	}
+
+	void STDMETHODCALLTYPE VSSetShaderResources(UINT start_slot, UINT count, ID3D11ShaderResourceView* const* views)
+	{
+		std::memcpy(state.vs_stage.resources + start_slot, views, count * sizeof(*views));
+		calls.vs_resources++;
+	}
+
+	void STDMETHODCALLTYPE VSSetSamplers(UINT start_slot, UINT count, ID3D11SamplerState* const* samplers)
+	{
+		std::memcpy(state.vs_stage.samplers + start_slot, samplers, count * sizeof(*samplers));
+		calls.vs_samplers++;
+	}
+
+	void STDMETHODCALLTYPE PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const*, UINT)
+	{
+		state.ps = shader;
+		calls.ps++;
+	}
+
+	void STDMETHODCALLTYPE PSSetConstantBuffers(UINT start_slot, UINT count, ID3D11Buffer* const* buffers)
+	{
+		SetConstantBuffers(state.ps_stage, start_slot, count, buffers, nullptr, nullptr);
+		calls.ps_constant_buffers++;
+	}
+
+	void STDMETHODCALLTYPE PSSetConstantBuffers1(UINT start_slot, UINT count, ID3D11Buffer* const* buffers, const UINT* first_constants, const UINT* nbr_constants)
+	{
+		SetConstantBuffers(state.ps_stage, start_slot, count, buffers, first_constants, nbr_constants);
+		calls.ps_constant_buffers1++;
+	}
+
+	void STDMETHODCALLTYPE PSSetShaderResources(UINT start_slot, UINT count, ID3D11ShaderResourceView* const* views)
+	{
+		std::memcpy(state.ps_stage.resources + start_slot, views, count * sizeof(*views));
+		calls.ps_resources++;
+	}
+
+	void STDMETHODCALLTYPE PSSetSamplers(UINT start_slot, UINT count, ID3D11SamplerState* const* samplers)
+	{
+		std::memcpy(state.ps_stage.samplers + start_slot, samplers, count * sizeof(*samplers));
+		calls.ps_samplers++;
+	}
+
+	void STDMETHODCALLTYPE DrawIndexed(UINT, UINT, INT)
+	{
+		Drawn();
+	}
+
+	void STDMETHODCALLTYPE DrawIndexedInstanced(UINT, UINT, UINT, INT, UINT)
+	{
+		Drawn();
+	}
+
+	void STDMETHODCALLTYPE Draw(UINT, UINT)
+	{
+		Drawn();
+	}
+
+private:
+	void Drawn()
+	{
+		drawn = state;
+		calls.draws++;
+	}
+
+	static void SetConstantBuffers(
+		MockState::Stage& stage,
+		UINT start_slot,
+		UINT count,
+		ID3D11Buffer* const* buffers,
+		const UINT* first_constants,
+		const UINT* nbr_constants)
+	{
+		for (UINT i = 0; i < count; i++)
+			stage.constant_buffers[start_slot + i] =
+			{
+				buffers[i],
+				first_constants ? first_constants[i] : 0,
+				nbr_constants ? nbr_constants[i] : 0
+			};
+	}
+};
+
+#endif
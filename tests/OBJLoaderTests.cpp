@@ -0,0 +1,186 @@
+//
+//  OBJLoaderTests.cpp
+//
+//  OBJLoader parsing the file in chunks on several threads against parsing
+//  it in one, on a generated OBJ where groups, materials and relative
+//  indices carry over chunk boundaries
+//
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include "Check.h"
+#include "OBJLoader.h"
+
+static const char* ObjFilename = "OBJLoaderTests.obj";
+static const char* MtlFilename = "OBJLoaderTests.mtl";
+
+static const int NbrMaterials = 5;
+
+//
+// Write an OBJ of about 10 MB, over 1 MB per chunk for 8 chunks, and its
+// MTL. Vertices and faces are interleaved in blocks, and the group and
+// material change every few blocks, so that every chunk starts with faces
+// of a drawcall from the previous chunk. One stretch of over a chunk has no
+// g or usemtl at all. Faces mix absolute and relative indices, and
+// triangles, quads and pentagons, with and without texcoords
+//
+static void WriteObj()
+{
+	std::ofstream mtl(MtlFilename);
+	for (int m = 0; m < NbrMaterials; m++)
+		mtl << "newmtl material" << m << "\n"
+			<< "Ka 0.1 0.1 0.1\n"
+			<< "Kd " << m * 0.2f << " 0.5 " << 1 - m * 0.2f << "\n"
+			<< "Ks 1 1 1\n"
+			<< "Ns " << 10 + m << "\n"
+			<< "map_Kd texture" << m << ".png\n\n";
+
+	std::ofstream obj(ObjFilename);
+	std::mt19937 rng(1);
+	auto uniform = [&](int n) { return (int)(rng() % n); };
+
+	obj << "mtllib " << MtlFilename << "\n";
+	obj << "v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nvt 0 0\n";
+	obj << "f 1//1 2//1 3//1\n";	// Before any usemtl
+	int nbr_v = 3, nbr_vn = 1, nbr_vt = 1, group = 0;
+
+	const int nbr_blocks = 2200;
+	for (int b = 0; b < nbr_blocks; b++)
+	{
+		const bool quiet = b >= 1000 && b < 1400;	// No g or usemtl
+		if (!quiet && uniform(3) == 0)
+			obj << "g group" << group++ << "\n";
+		if (!quiet && uniform(2) == 0)
+			obj << "usemtl material" << uniform(NbrMaterials) << "\n";
+
+		for (int i = 0; i < 40; i++)
+		{
+			obj << "v " << uniform(2000) * 0.01f << " " << uniform(2000) * 0.01f << " " << uniform(2000) * 0.01f << "\n";
+			obj << "vn " << uniform(200) * 0.01f - 1 << " " << uniform(200) * 0.01f - 1 << " 0.5\n";
+			obj << "vt " << uniform(100) * 0.01f << " " << uniform(100) * 0.01f << "\n";
+		}
+		nbr_v += 40;
+		nbr_vn += 40;
+		nbr_vt += 40;
+
+		for (int f = 0; f < 60; f++)
+		{
+			// Relative indices into this block, or absolute ones into any
+			// block so far, including previous chunks
+			const bool relative = uniform(2) == 0;
+			const bool texcoords = uniform(4) != 0;
+			const int nbr_corners = 3 + uniform(3);
+			obj << "f";
+			for (int c = 0; c < nbr_corners; c++)
+			{
+				const int v = relative ? -1 - uniform(40) : 1 + uniform(nbr_v);
+				const int vn = relative ? -1 - uniform(40) : 1 + uniform(nbr_vn);
+				const int vt = relative ? -1 - uniform(40) : 1 + uniform(nbr_vt);
+				obj << " " << v << "/";
+				if (texcoords)
+					obj << vt;
+				obj << "/" << vn;
+			}
+			obj << "\n";
+		}
+	}
+}
+
+static bool SameVec(const vec3f& a, const vec3f& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+//
+// Loaded data of a and b is the same, bit for bit
+//
+static void CheckSame(const OBJLoader& a, const OBJLoader& b)
+{
+	CHECK(a.has_normals == b.has_normals && a.has_texcoords == b.has_texcoords);
+
+	CHECK(a.vertices.size() == b.vertices.size());
+	size_t vertex_mismatches = 0;
+	for (size_t i = 0; i < std::min(a.vertices.size(), b.vertices.size()); i++)
+	{
+		const Vertex &va = a.vertices[i], &vb = b.vertices[i];
+		vertex_mismatches += !SameVec(va.Pos, vb.Pos) || !SameVec(va.Normal, vb.Normal) ||
+			!SameVec(va.Tangent, vb.Tangent) || !SameVec(va.Binormal, vb.Binormal) ||
+			va.TexCoord.x != vb.TexCoord.x || va.TexCoord.y != vb.TexCoord.y;
+	}
+	CHECK(vertex_mismatches == 0);
+
+	CHECK(a.drawcalls.size() == b.drawcalls.size());
+	size_t drawcall_mismatches = 0;
+	for (size_t i = 0; i < std::min(a.drawcalls.size(), b.drawcalls.size()); i++)
+	{
+		const Drawcall &da = a.drawcalls[i], &db = b.drawcalls[i];
+		drawcall_mismatches += da.group_name != db.group_name || da.mtl_index != db.mtl_index ||
+			da.tris.size() != db.tris.size() || da.quads.size() != db.quads.size();
+		for (size_t t = 0; t < std::min(da.tris.size(), db.tris.size()); t++)
+			for (int k = 0; k < 3; k++)
+				drawcall_mismatches += da.tris[t].vi[k] != db.tris[t].vi[k];
+		for (size_t q = 0; q < std::min(da.quads.size(), db.quads.size()); q++)
+			for (int k = 0; k < 4; k++)
+				drawcall_mismatches += da.quads[q].vi[k] != db.quads[q].vi[k];
+	}
+	CHECK(drawcall_mismatches == 0);
+
+	CHECK(a.materials.size() == b.materials.size());
+	size_t material_mismatches = 0;
+	for (size_t i = 0; i < std::min(a.materials.size(), b.materials.size()); i++)
+	{
+		const Material &ma = a.materials[i], &mb = b.materials[i];
+		material_mismatches += ma.name != mb.name ||
+			!SameVec(ma.Ka, mb.Ka) || !SameVec(ma.Kd, mb.Kd) || !SameVec(ma.Ks, mb.Ks) ||
+			ma.shininess != mb.shininess ||
+			ma.Kd_texture_filename != mb.Kd_texture_filename ||
+			ma.normal_texture_filename != mb.normal_texture_filename ||
+			ma.specular_texture_filename != mb.specular_texture_filename;
+	}
+	CHECK(material_mismatches == 0);
+}
+
+static void Load(OBJLoader& loader, unsigned max_threads, unsigned parse_chunks, bool triangulate)
+{
+	loader.max_threads = max_threads;
+	loader.parse_chunks = parse_chunks;
+	loader.Load(ObjFilename, true, triangulate);
+}
+
+int main()
+{
+	WriteObj();
+
+	OBJLoader serial;
+	Load(serial, 1, 0, true);
+	CHECK(serial.parsed_bytes > 8 << 20);
+	CHECK(serial.materials.size() == NbrMaterials);
+	CHECK(serial.drawcalls.size() > 500);
+
+	// Up to 8 threads, as many chunks as the hardware allows
+	OBJLoader parallel;
+	Load(parallel, 8, 0, true);
+	CheckSame(serial, parallel);
+
+	// 8 and 13 chunks whatever the hardware, so that boundaries are crossed
+	// on any machine
+	for (unsigned chunks : { 8, 13 })
+	{
+		OBJLoader chunked;
+		Load(chunked, 8, chunks, true);
+		CheckSame(serial, chunked);
+	}
+
+	// Quads kept
+	OBJLoader serial_quads, chunked_quads;
+	Load(serial_quads, 1, 0, false);
+	Load(chunked_quads, 8, 8, false);
+	CHECK(serial_quads.drawcalls.size() == serial.drawcalls.size());
+	CheckSame(serial_quads, chunked_quads);
+
+	std::remove(ObjFilename);
+	std::remove(MtlFilename);
+	return CheckResult();
+}
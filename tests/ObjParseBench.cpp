@@ -0,0 +1,147 @@
+//
+//  ObjParseBench.cpp
+//
+//  OBJ parsing throughput of OBJLoader against the sscanf_s line parser it
+//  replaced, on one file:
+//
+//  ObjParseBench [file.obj]	(default assets/crytek-sponza/sponza.obj)
+//
+//  OBJLoader times include reading the MTL files, the reference skips them
+//
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "OBJLoader.h"
+
+#ifndef _MSC_VER
+#define sscanf_s sscanf
+#endif
+
+using namespace linalg;
+
+//
+// Raw data of the reference parser, as the old OBJLoader::Load collected it
+//
+struct reference_obj_t
+{
+	std::vector<vec3f> vertices, normals;
+	std::vector<vec2f> texcoords;
+	std::vector<int> faces;	// 9 indices per triangle
+	std::vector<std::string> materials;
+	size_t bytes = 0;
+};
+
+//
+// The line loop of OBJLoader::Load before the tokenizer: getline, and a
+// cascade of sscanf_s calls per line until one matches. Quads are triangulated
+//
+static void ReferenceParse(const std::string& filename, reference_obj_t& obj)
+{
+	std::ifstream in(filename.c_str());
+	std::string line;
+	while (getline(in, line))
+	{
+		obj.bytes += line.size() + 1;
+
+		const int MaxChars = 1024;
+		float x, y, z;
+		int a[3], b[3], c[3], d[3];
+		char str[MaxChars];
+
+		auto tri = [&](int a0, int b0, int c0, int an, int bn, int cn, int at, int bt, int ct)
+		{
+			const int face[9] = { a0 - 1, b0 - 1, c0 - 1, an - 1, bn - 1, cn - 1, at - 1, bt - 1, ct - 1 };
+			obj.faces.insert(obj.faces.end(), face, face + 9);
+		};
+
+		if (sscanf_s(line.c_str(), "mtllib %s", str, MaxChars) == 1)
+			obj.materials.push_back(str);
+		else if (sscanf_s(line.c_str(), "usemtl %s", str, MaxChars) == 1)
+			obj.materials.push_back(str);
+		else if (sscanf_s(line.c_str(), "g %s", str, MaxChars) == 1)
+			;
+		else if (sscanf_s(line.c_str(), "v %f %f %f", &x, &y, &z) == 3)
+			obj.vertices.push_back(vec3f(x, y, z));
+		else if (sscanf_s(line.c_str(), "v %f %f", &x, &y) == 2)
+			obj.vertices.push_back(vec3f(x, y, 0.0f));
+		else if (sscanf_s(line.c_str(), "vt %f %f %f", &x, &y, &z) == 3)
+			obj.texcoords.push_back(vec2f(x, y));
+		else if (sscanf_s(line.c_str(), "vt %f %f", &x, &y) == 2)
+			obj.texcoords.push_back(vec2f(x, y));
+		else if (sscanf_s(line.c_str(), "vn %f %f %f", &x, &y, &z) == 3)
+			obj.normals.push_back(vec3f(x, y, z));
+		else if (sscanf_s(line.c_str(), "f %d %d %d %d", &a[0], &b[0], &c[0], &d[0]) == 4)
+		{
+			tri(a[0], b[0], c[0], 0, 0, 0, 0, 0, 0);
+			tri(a[0], c[0], d[0], 0, 0, 0, 0, 0, 0);
+		}
+		else if (sscanf_s(line.c_str(), "f %d %d %d", &a[0], &b[0], &c[0]) == 3)
+			tri(a[0], b[0], c[0], 0, 0, 0, 0, 0, 0);
+		else if (sscanf_s(line.c_str(), "f %d/%d %d/%d %d/%d %d/%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1], &d[0], &d[1]) == 8)
+		{
+			tri(a[0], b[0], c[0], 0, 0, 0, a[1], b[1], c[1]);
+			tri(a[0], c[0], d[0], 0, 0, 0, a[1], c[1], d[1]);
+		}
+		else if (sscanf_s(line.c_str(), "f %d/%d %d/%d %d/%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1]) == 6)
+			tri(a[0], b[0], c[0], 0, 0, 0, a[1], b[1], c[1]);
+		else if (sscanf_s(line.c_str(), "f %d//%d %d//%d %d//%d %d//%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1], &d[0], &d[1]) == 8)
+		{
+			tri(a[0], b[0], c[0], a[1], b[1], c[1], 0, 0, 0);
+			tri(a[0], c[0], d[0], a[1], c[1], d[1], 0, 0, 0);
+		}
+		else if (sscanf_s(line.c_str(), "f %d//%d %d//%d %d//%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1]) == 6)
+			tri(a[0], b[0], c[0], a[1], b[1], c[1], 0, 0, 0);
+		else if (sscanf_s(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", &a[0], &a[1], &a[2], &b[0], &b[1], &b[2], &c[0], &c[1], &c[2], &d[0], &d[1], &d[2]) == 12)
+		{
+			tri(a[0], b[0], c[0], a[2], b[2], c[2], a[1], b[1], c[1]);
+			tri(a[0], c[0], d[0], a[2], c[2], d[2], a[1], c[1], d[1]);
+		}
+		else if (sscanf_s(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &a[0], &a[1], &a[2], &b[0], &b[1], &b[2], &c[0], &c[1], &c[2]) == 9)
+			tri(a[0], b[0], c[0], a[2], b[2], c[2], a[1], b[1], c[1]);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string filename = argc > 1 ? argv[1] : "assets/crytek-sponza/sponza.obj";
+	if (!std::ifstream(filename.c_str()))
+	{
+		std::printf("Cannot open %s\n", filename.c_str());
+		return 1;
+	}
+	const int reps = 3;
+
+	size_t bytes = 0;
+	const double reference_ms = BenchMs(reps, [&]()
+	{
+		reference_obj_t obj;
+		ReferenceParse(filename, obj);
+		bytes = obj.bytes;
+		Consume(obj.faces.size());
+	});
+
+	// Parse times of OBJLoader, without normal generation
+	auto loader_ms = [&](unsigned max_threads)
+	{
+		double best = 1e30;
+		for (int i = 0; i < reps; i++)
+		{
+			OBJLoader loader;
+			loader.max_threads = max_threads;
+			loader.Load(filename, false);
+			best = std::min(best, loader.parse_secs * 1000.0);
+		}
+		return best;
+	};
+	const double single_ms = loader_ms(1);
+	const double parallel_ms = loader_ms(0);
+
+	const double mb = bytes / (1024.0 * 1024.0);
+	std::printf("\n%s, %.1f MB\n", filename.c_str(), mb);
+	std::printf("sscanf_s reference:    %8.1f ms  %7.1f MB/s\n", reference_ms, mb * 1000.0 / reference_ms);
+	std::printf("OBJLoader, 1 thread:   %8.1f ms  %7.1f MB/s  (%.1fx)\n", single_ms, mb * 1000.0 / single_ms, reference_ms / single_ms);
+	std::printf("OBJLoader, all threads:%8.1f ms  %7.1f MB/s  (%.1fx)\n", parallel_ms, mb * 1000.0 / parallel_ms, reference_ms / parallel_ms);
+	return 0;
+}
@@ -0,0 +1,133 @@
+//
+//  RenderQueueTests.cpp
+//
+//  RenderQueue sorting against std::stable_sort, and its sort keys
+//
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "RenderQueue.h"
+
+static std::mt19937 rng(1);
+
+static unsigned Random(unsigned n)
+{
+	return (unsigned)(rng() % n);
+}
+
+//
+// Push keys to a queue with the push order as object, sort it, and check it
+// against std::stable_sort of the same packets. Returns the sort passes
+//
+static unsigned CheckSort(const std::vector<uint64_t>& keys)
+{
+	RenderQueue queue;
+	std::vector<DrawPacket> expected;
+	for (unsigned i = 0; i < keys.size(); i++)
+	{
+		queue.Push(keys[i], i, i % 3);
+		expected.push_back({ keys[i], i, i % 3 });
+	}
+	std::stable_sort(expected.begin(), expected.end(),
+		[](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+
+	queue.Sort();
+	const std::vector<DrawPacket>& sorted = queue.Packets();
+	CHECK(sorted.size() == expected.size());
+	size_t mismatches = 0;
+	for (size_t i = 0; i < std::min(sorted.size(), expected.size()); i++)
+		mismatches += sorted[i].key != expected[i].key ||
+			sorted[i].object != expected[i].object ||
+			sorted[i].drawcall != expected[i].drawcall;
+	CHECK(mismatches == 0);
+	return queue.SortPasses();
+}
+
+//
+// Keys of a scene: few passes, shaders and texture sets, many materials and
+// depths, so that there are ties to keep in order
+//
+static std::vector<uint64_t> SceneKeys(size_t n)
+{
+	std::vector<uint64_t> keys(n);
+	for (uint64_t& key : keys)
+		key = RenderQueue::MakeKey(Random(2), Random(4), Random(20), Random(100),
+			(float)Random(50), Random(4) == 0);
+	return keys;
+}
+
+static void TestSort()
+{
+	// By comparison below 1024 packets, by radix sort from there
+	for (size_t n : { 0, 1, 2, 100, 1023 })
+		CHECK(CheckSort(SceneKeys(n)) == 0);
+	for (size_t n : { 1024, 5000, 100000 })
+		CHECK(CheckSort(SceneKeys(n)) > 0);
+
+	// Arbitrary 64-bit keys, every byte differs somewhere
+	std::vector<uint64_t> keys(20000);
+	for (uint64_t& key : keys)
+		key = (uint64_t)rng() << 32 | rng();
+	CHECK(CheckSort(keys) == 8);
+
+	// Reversed and already sorted
+	keys = SceneKeys(4096);
+	std::sort(keys.begin(), keys.end());
+	CheckSort(keys);
+	std::reverse(keys.begin(), keys.end());
+	CheckSort(keys);
+}
+
+//
+// Bytes that are the same in all keys are skipped, and equal keys keep
+// their push order without any pass
+//
+static void TestConstantBytes()
+{
+	// Depth varies in bytes 0-2 and texture sets below 256 in byte 5. The
+	// material (bytes 3-4), high texture set byte (6) and pass & shader (7)
+	// are constant
+	std::vector<uint64_t> keys(5000);
+	for (uint64_t& key : keys)
+		key = RenderQueue::MakeKey(1, 3, Random(256), 0, std::ldexp(1.0f + Random(1 << 20) / 1048576.0f, Random(64) - 32));
+	CHECK(CheckSort(keys) == 4);
+
+	// Depth only, in its top bytes: same sign and exponent range
+	for (uint64_t& key : keys)
+		key = RenderQueue::MakeKey(0, 0, 0, 0, 1.0f + Random(1 << 16) / 65536.0f);
+	CHECK(CheckSort(keys) == 2);
+
+	keys.assign(5000, RenderQueue::MakeKey(2, 5, 7, 9, 10.0f));
+	CHECK(CheckSort(keys) == 0);
+}
+
+static void TestKeys()
+{
+	const uint64_t key = RenderQueue::MakeKey(2, 5, 700, 9000, 3.0f);
+	CHECK(RenderQueue::KeyPass(key) == 2);
+	CHECK(RenderQueue::KeyShader(key) == 5);
+	CHECK(RenderQueue::KeyTextureSet(key) == 700);
+	CHECK(RenderQueue::KeyMaterial(key) == 9000);
+
+	// Fields order before depth, depth front to back or back to front
+	CHECK(RenderQueue::MakeKey(0, 1, 0, 0, 0.0f) > RenderQueue::MakeKey(0, 0, 9, 9, 1e30f));
+	CHECK(RenderQueue::MakeKey(0, 0, 0, 0, 1.0f) < RenderQueue::MakeKey(0, 0, 0, 0, 2.0f));
+	CHECK(RenderQueue::MakeKey(0, 0, 0, 0, 1.0f, true) > RenderQueue::MakeKey(0, 0, 0, 0, 2.0f, true));
+	CHECK(RenderQueue::MakeKey(0, 0, 0, 0, -5.0f) == RenderQueue::MakeKey(0, 0, 0, 0, 0.0f));
+
+	CHECK(RenderQueue::KeyChanges(key, key) == 0);
+	CHECK(RenderQueue::KeyChanges(key, RenderQueue::MakeKey(2, 5, 700, 9000, 8.0f)) == 0);
+	CHECK(RenderQueue::KeyChanges(key, RenderQueue::MakeKey(2, 5, 701, 9001, 3.0f)) ==
+		(RenderQueue::TextureSetChanged | RenderQueue::MaterialChanged));
+	CHECK(RenderQueue::KeyChanges(0, key) == RenderQueue::AllChanged);
+}
+
+int main()
+{
+	TestSort();
+	TestConstantBytes();
+	TestKeys();
+	return CheckResult();
+}
@@ -0,0 +1,255 @@
+//
+//  StateCacheTests.cpp
+//
+//  StateCacheT over a mock context: the bindings each draw sees, and the
+//  calls it filters and issues
+//
+
+#include <random>
+#include "Check.h"
+#include "MockContext.h"
+#include "StateCache.h"
+
+typedef StateCacheT<MockContext> MockStateCache;
+
+static void CheckStats(const MockStateCache& cache, unsigned requested, unsigned filtered, unsigned issued)
+{
+	const StateCacheStats& stats = cache.GetStats();
+	CHECK(stats.requested == requested);
+	CHECK(stats.filtered == filtered);
+	CHECK(stats.issued == issued);
+	CHECK(stats.issued == cache.GetContext()->calls.Bindings());
+}
+
+// Single-valued bindings are passed on when they change, at once
+static void TestSingleBindings()
+{
+	MockContext context;
+	MockStateCache cache(&context, &context);
+
+	cache.IASetInputLayout(Fake<ID3D11InputLayout>(1));
+	cache.IASetInputLayout(Fake<ID3D11InputLayout>(1));
+	cache.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	cache.IASetIndexBuffer(Fake<ID3D11Buffer>(1), DXGI_FORMAT_R16_UINT, 0);
+	cache.IASetIndexBuffer(Fake<ID3D11Buffer>(1), DXGI_FORMAT_R32_UINT, 0);
+	cache.IASetIndexBuffer(Fake<ID3D11Buffer>(1), DXGI_FORMAT_R32_UINT, 0);
+	cache.VSSetShader(Fake<ID3D11VertexShader>(1));
+	cache.VSSetShader(Fake<ID3D11VertexShader>(1));
+	cache.PSSetShader(Fake<ID3D11PixelShader>(1));
+	cache.PSSetShader(Fake<ID3D11PixelShader>(2));
+
+	CHECK(context.calls.input_layout == 1 && context.calls.topology == 1);
+	CHECK(context.calls.index_buffer == 2 && context.calls.vs == 1 && context.calls.ps == 2);
+	CHECK(context.state.index_format == DXGI_FORMAT_R32_UINT);
+	CHECK(context.state.ps == Fake<ID3D11PixelShader>(2));
+	CHECK(cache.GetInputLayout() == Fake<ID3D11InputLayout>(1));
+	CHECK(cache.GetVertexShader() == Fake<ID3D11VertexShader>(1));
+	CheckStats(cache, 10, 3, 7);
+
+	// Forgotten bindings are passed on again
+	cache.Invalidate();
+	CHECK(cache.GetInputLayout() == nullptr);
+	cache.IASetInputLayout(Fake<ID3D11InputLayout>(1));
+	CHECK(context.calls.input_layout == 2);
+	CheckStats(cache, 11, 3, 8);
+
+	cache.ResetStats();
+	CHECK(cache.GetStats().requested == 0 && cache.GetStats().issued == 0);
+}
+
+// Slot bindings are held until the draw, and runs of slots are bound with
+// one call
+static void TestSlotRuns()
+{
+	MockContext context;
+	MockStateCache cache(&context, &context);
+
+	ID3D11ShaderResourceView* a = Fake<ID3D11ShaderResourceView>(1);
+	ID3D11ShaderResourceView* b = Fake<ID3D11ShaderResourceView>(2);
+	ID3D11ShaderResourceView* c = Fake<ID3D11ShaderResourceView>(3);
+
+	// Slots 0 and 1 set apart, bound together
+	cache.PSSetShaderResources(0, 1, &a);
+	cache.PSSetShaderResources(1, 1, &b);
+	CHECK(context.calls.ps_resources == 0);
+	cache.Draw(3, 0);
+	CHECK(context.calls.ps_resources == 1);
+	CHECK(context.drawn.ps_stage.resources[0] == a && context.drawn.ps_stage.resources[1] == b);
+	CheckStats(cache, 2, 0, 1);
+
+	// The same bindings again are filtered, and so is setting a binding back
+	// before the draw, with the change in between not passed on
+	cache.PSSetShaderResources(0, 1, &a);
+	cache.PSSetShaderResources(1, 1, &c);
+	cache.PSSetShaderResources(1, 1, &b);
+	cache.Draw(3, 0);
+	CHECK(context.calls.ps_resources == 1);
+	CheckStats(cache, 5, 2, 1);
+
+	// Changed slots 0 and 2 around known slot 1, one call over all three
+	cache.PSSetShaderResources(0, 1, &c);
+	cache.PSSetShaderResources(2, 1, &a);
+	cache.Draw(3, 0);
+	CHECK(context.calls.ps_resources == 2);
+	CHECK(context.drawn.ps_stage.resources[0] == c && context.drawn.ps_stage.resources[1] == b &&
+		context.drawn.ps_stage.resources[2] == a);
+	CheckStats(cache, 7, 2, 2);
+
+	// Around an unknown slot, 4 and 6 with 5 never bound, two calls
+	cache.PSSetShaderResources(4, 1, &a);
+	cache.PSSetShaderResources(6, 1, &b);
+	cache.Draw(3, 0);
+	CHECK(context.calls.ps_resources == 4);
+	CHECK(context.drawn.ps_stage.resources[5] == nullptr);
+	CheckStats(cache, 9, 2, 4);
+
+	// Samplers, vertex buffers and the VS stage are tracked apart
+	ID3D11SamplerState* sampler = Fake<ID3D11SamplerState>(1);
+	ID3D11Buffer* vb[2] = { Fake<ID3D11Buffer>(1), Fake<ID3D11Buffer>(2) };
+	UINT strides[2] = { 20, 8 }, offsets[2] = { 0, 0 };
+	cache.VSSetSamplers(0, 1, &sampler);
+	cache.PSSetSamplers(0, 1, &sampler);
+	cache.VSSetShaderResources(0, 1, &a);
+	cache.IASetVertexBuffers(0, 2, vb, strides, offsets);
+	cache.IASetVertexBuffers(1, 1, vb + 1, strides + 1, offsets + 1);
+	cache.DrawIndexed(3, 0, 0);
+	CHECK(context.calls.vs_samplers == 1 && context.calls.ps_samplers == 1 && context.calls.vs_resources == 1);
+	CHECK(context.calls.vertex_buffers == 1);
+	CHECK(context.drawn.vertex_buffers[1] == vb[1] && context.drawn.strides[1] == 8);
+	CheckStats(cache, 14, 2, 8);
+	CHECK(cache.GetStats().draws == 5);
+}
+
+// Whole constant buffers and ranges in one run are bound with a call of
+// each kind, and a range is a different binding from its whole buffer
+static void TestConstantBufferRanges()
+{
+	MockContext context;
+	MockStateCache cache(&context, &context);
+
+	ID3D11Buffer* object = Fake<ID3D11Buffer>(1);
+	ID3D11Buffer* light = Fake<ID3D11Buffer>(2);
+	const UINT first = 16, count = 16;
+
+	cache.VSSetConstantBuffers(0, 1, &light);
+	cache.VSSetConstantBuffers1(1, 1, &object, &first, &count);
+	cache.DrawIndexed(3, 0, 0);
+	CHECK(context.calls.vs_constant_buffers == 1 && context.calls.vs_constant_buffers1 == 1);
+	CHECK(context.drawn.vs_stage.constant_buffers[0].buffer == light);
+	CHECK(context.drawn.vs_stage.constant_buffers[0].nbr_constants == 0);
+	CHECK(context.drawn.vs_stage.constant_buffers[1].buffer == object);
+	CHECK(context.drawn.vs_stage.constant_buffers[1].first_constant == 16);
+
+	// Same range filtered, next range bound, then the whole buffer
+	const UINT next = 32;
+	cache.VSSetConstantBuffers1(1, 1, &object, &first, &count);
+	cache.DrawIndexed(3, 0, 0);
+	cache.VSSetConstantBuffers1(1, 1, &object, &next, &count);
+	cache.DrawIndexed(3, 0, 0);
+	CHECK(context.drawn.vs_stage.constant_buffers[1].first_constant == 32);
+	cache.VSSetConstantBuffers(1, 1, &object);
+	cache.DrawIndexed(3, 0, 0);
+	CHECK(context.drawn.vs_stage.constant_buffers[1].nbr_constants == 0);
+	CHECK(context.calls.vs_constant_buffers == 2 && context.calls.vs_constant_buffers1 == 2);
+	CheckStats(cache, 5, 1, 4);
+
+	// Without a Direct3D 11.1 context, whole buffers are bound as before
+	MockContext base_context;
+	MockStateCache base_cache(&base_context);
+	CHECK(base_cache.GetContext1() == nullptr);
+	base_cache.VSSetConstantBuffers(0, 1, &light);
+	base_cache.PSSetConstantBuffers(0, 1, &object);
+	base_cache.DrawIndexed(3, 0, 0);
+	CHECK(base_context.drawn.vs_stage.constant_buffers[0].buffer == light);
+	CHECK(base_context.drawn.ps_stage.constant_buffers[0].buffer == object);
+	CHECK(base_context.calls.vs_constant_buffers1 == 0 && base_context.calls.ps_constant_buffers1 == 0);
+}
+
+// Slots past those tracked are passed on at once, after the held bindings
+static void TestUntrackedSlots()
+{
+	MockContext context;
+	MockStateCache cache(&context, &context);
+
+	ID3D11ShaderResourceView* views[2] = { Fake<ID3D11ShaderResourceView>(1), Fake<ID3D11ShaderResourceView>(2) };
+	cache.PSSetShaderResources(0, 1, views);
+	cache.PSSetShaderResources(MockStateCache::MaxSlots - 1, 2, views);
+	CHECK(context.calls.ps_resources == 2);
+	CHECK(context.state.ps_stage.resources[0] == views[0]);
+	CHECK(context.state.ps_stage.resources[MockStateCache::MaxSlots] == views[1]);
+
+	// Invalidated, so slot 0 is bound again
+	cache.PSSetShaderResources(0, 1, views);
+	cache.Draw(3, 0);
+	CHECK(context.calls.ps_resources == 3);
+	CheckStats(cache, 3, 0, 3);
+}
+
+//
+// Random binding calls and draws with few distinct bindings, through the
+// cache and straight to a second context: every draw sees the same state,
+// and the cache issues fewer calls
+//
+static void TestRandomCalls()
+{
+	MockContext cached_context, direct_context;
+	MockStateCache cache(&cached_context, &cached_context);
+	std::mt19937 rng(1);
+	auto random = [&](unsigned n) { return (unsigned)(rng() % n); };
+
+	unsigned mismatches = 0, nbr_calls = 0;
+	for (int i = 0; i < 100000; i++)
+	{
+		// Drawn once for both
+		const unsigned slot = random(MockStateCache::MaxSlots + 2), count = 1 + random(3), id = random(2);
+		ID3D11Buffer* buffers[3] = { Fake<ID3D11Buffer>(1 + random(3)), Fake<ID3D11Buffer>(1 + random(3)), Fake<ID3D11Buffer>(1 + random(3)) };
+		ID3D11ShaderResourceView* views[3] = { Fake<ID3D11ShaderResourceView>(random(3)), Fake<ID3D11ShaderResourceView>(random(3)), Fake<ID3D11ShaderResourceView>(random(3)) };
+		const UINT strides[3] = { 20, 20, 8 }, offsets[3] = { 0, 0, 0 };
+		const UINT first[3] = { 16 * random(2), 0, 16 }, sizes[3] = { 16, 16, 16 };
+
+		auto both = [&](auto&& call)
+		{
+			call(cache);
+			call(direct_context);
+			nbr_calls++;
+		};
+
+		switch (random(12))
+		{
+		case 0: both([&](auto& c) { c.IASetInputLayout(Fake<ID3D11InputLayout>(id)); }); break;
+		case 1: both([&](auto& c) { c.IASetIndexBuffer(buffers[0], DXGI_FORMAT_R16_UINT, 0); }); break;
+		case 2: both([&](auto& c) { c.IASetVertexBuffers(slot % 2, 1 + id, buffers, strides, offsets); }); break;
+		case 3: both([&](auto& c) { c.VSSetShader(Fake<ID3D11VertexShader>(id), nullptr, 0); }); break;
+		case 4: both([&](auto& c) { c.PSSetShader(Fake<ID3D11PixelShader>(id), nullptr, 0); }); break;
+		case 5: both([&](auto& c) { c.VSSetConstantBuffers(slot, count, buffers); }); break;
+		case 6: both([&](auto& c) { c.VSSetConstantBuffers1(slot, count, buffers, first, sizes); }); break;
+		case 7: both([&](auto& c) { c.PSSetConstantBuffers(slot, count, buffers); }); break;
+		case 8: both([&](auto& c) { c.PSSetShaderResources(slot, count, views); }); break;
+		case 9: both([&](auto& c) { c.VSSetShaderResources(slot, count, views); }); break;
+		case 10: both([&](auto& c) { c.PSSetSamplers(slot, count, reinterpret_cast<ID3D11SamplerState* const*>(views)); }); break;
+		default:
+			cache.DrawIndexed(3, 0, 0);
+			direct_context.DrawIndexed(3, 0, 0);
+			mismatches += !(cached_context.drawn == direct_context.drawn);
+		}
+	}
+	CHECK(mismatches == 0);
+	CHECK(cached_context.calls.draws == direct_context.calls.draws);
+
+	const StateCacheStats& stats = cache.GetStats();
+	CHECK(stats.requested == nbr_calls);
+	CHECK(stats.issued == cached_context.calls.Bindings());
+	CHECK(stats.issued < direct_context.calls.Bindings());
+	std::printf("random calls: %u requested, %u filtered, %u issued, %u draws\n",
+		stats.requested, stats.filtered, stats.issued, stats.draws);
+}
+
+int main()
+{
+	TestSingleBindings();
+	TestSlotRuns();
+	TestConstantBufferRanges();
+	TestUntrackedSlots();
+	TestRandomCalls();
+	return CheckResult();
+}
@@ -0,0 +1,170 @@
+//
+//  TransformHierarchyTests.cpp
+//
+//  TransformHierarchy::Update, by subtree walks and by levels, against
+//  world matrices multiplied out from the root of each node, and its update
+//  counts against the subtrees of the nodes set
+//
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "TransformHierarchy.h"
+
+typedef TransformHierarchy::NodeId NodeId;
+typedef mat4<double> mat4d;
+typedef quat<double> quatd;
+
+static std::mt19937 rng(1);
+
+static float Uniform(float lo, float hi)
+{
+	return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+static quatf RandomRotation()
+{
+	quatf q;
+	do
+		q = quatf(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1));
+	while (dot(q, q) < 0.1f);
+	return q.normalize();
+}
+
+static vec3f RandomTranslation()
+{
+	return vec3f(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1));
+}
+
+static vec3f RandomScale()
+{
+	return vec3f(Uniform(0.8f, 1.25f), Uniform(0.8f, 1.25f), Uniform(0.8f, 1.25f));
+}
+
+//
+// World matrices in double, each parent world * T * R * S
+//
+static std::vector<mat4d> BruteForceWorld(const TransformHierarchy& h)
+{
+	std::vector<mat4d> world(h.Size());
+	for (NodeId node = 0; node < h.Size(); node++)
+	{
+		const vec3f& t = h.GetTranslation(node);
+		const vec3f& s = h.GetScale(node);
+		const quatf& r = h.GetRotation(node);
+		const mat4d local = mat4d::translation(t.x, t.y, t.z) *
+			quatd(r.x, r.y, r.z, r.w).to_mat4() *
+			mat4d::scaling(s.x, s.y, s.z);
+		const NodeId parent = h.GetParent(node);
+		world[node] = parent == TransformHierarchy::NoParent ? local : world[parent] * local;
+	}
+	return world;
+}
+
+//
+// Every world matrix against the brute force, relative to the largest
+// element of the latter
+//
+static double MaxWorldError(const TransformHierarchy& h)
+{
+	const std::vector<mat4d> world = BruteForceWorld(h);
+	double max_error = 0;
+	for (NodeId node = 0; node < h.Size(); node++)
+	{
+		double diff = 0, scale = 1;
+		for (int k = 0; k < 16; k++)
+		{
+			diff = std::max(diff, std::fabs(h.GetWorldMatrix(node).array[k] - world[node].array[k]));
+			scale = std::max(scale, std::fabs(world[node].array[k]));
+		}
+		max_error = std::max(max_error, diff / scale);
+	}
+	return max_error;
+}
+
+//
+// Set the rotation or translation of nbr_set random nodes from first_node
+// on, Update, and check the recomputed nodes: those set and their
+// descendants
+//
+static double SetAndUpdate(TransformHierarchy& h, size_t nbr_set, NodeId first_node, unsigned max_threads)
+{
+	std::vector<char> set(h.Size(), 0);
+	for (size_t i = 0; i < nbr_set; i++)
+	{
+		const NodeId node = first_node + (NodeId)(rng() % (h.Size() - first_node));
+		if (rng() % 2)
+			h.SetRotation(node, RandomRotation());
+		else
+			h.SetTranslation(node, RandomTranslation());
+		set[node] = 1;
+	}
+
+	// Below a set node, in id order since parents come first
+	std::vector<char> expected(h.Size(), 0);
+	size_t nbr_expected = 0;
+	for (NodeId node = 0; node < h.Size(); node++)
+	{
+		const NodeId parent = h.GetParent(node);
+		expected[node] = set[node] || (parent != TransformHierarchy::NoParent && expected[parent]);
+		nbr_expected += expected[node];
+	}
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	const size_t nbr_updated = h.Update(max_threads);
+	const double us = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+	CHECK(nbr_updated == nbr_expected);
+	size_t changed_mismatches = 0;
+	for (NodeId node = 0; node < h.Size(); node++)
+		changed_mismatches += h.WorldChanged(node) != (expected[node] != 0);
+	CHECK(changed_mismatches == 0);
+
+	std::printf("%6zu nodes set, %6zu updated, %u threads: %9.1f us\n", nbr_set, nbr_updated, max_threads, us);
+	return MaxWorldError(h);
+}
+
+int main()
+{
+	// A few roots, each node below one of the 100 nodes added before it,
+	// so that the tree is some hundreds of levels deep
+	const size_t n = 20000;
+	TransformHierarchy h;
+	for (size_t i = 0; i < n; i++)
+	{
+		const NodeId parent = i < 4 ? TransformHierarchy::NoParent : (NodeId)(i - 1 - rng() % std::min<size_t>(i, 100));
+		h.AddNode(parent, RandomTranslation(), RandomRotation(), RandomScale());
+	}
+
+	// All nodes are new
+	const size_t nbr_updated = h.Update(1);
+	CHECK(nbr_updated == n);
+	for (NodeId node = 0; node < n; node++)
+		CHECK(h.WorldChanged(node));
+	double max_error = MaxWorldError(h);
+
+	for (unsigned max_threads : { 1, 8 })
+	{
+		// Scattered sets, walked as subtrees: deep nodes with small subtrees,
+		// then any nodes
+		for (size_t nbr_set : { 1, 10, 100 })
+			max_error = std::max(max_error, SetAndUpdate(h, nbr_set, n - n / 16, max_threads));
+		for (size_t nbr_set : { 1, 10, 100 })
+			max_error = std::max(max_error, SetAndUpdate(h, nbr_set, 0, max_threads));
+
+		// Many sets, level by level
+		max_error = std::max(max_error, SetAndUpdate(h, n / 8, 0, max_threads));
+
+		// Nothing set, nothing recomputed
+		CHECK(h.Update(max_threads) == 0);
+		size_t changed = 0;
+		for (NodeId node = 0; node < n; node++)
+			changed += h.WorldChanged(node);
+		CHECK(changed == 0);
+	}
+
+	CHECK(max_error < 1e-4);
+	std::printf("max relative error of world matrices %.3g\n", max_error);
+	return CheckResult();
+}
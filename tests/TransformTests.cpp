@@ -0,0 +1,141 @@
+//
+//  TransformTests.cpp
+//
+//  Per-object matrices from transform_matrices and normal_matrices, as the
+//  vertex shaders use them, against the per-vertex math they replaced
+//
+
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/transform.h"
+
+using namespace linalg;
+
+typedef vec3<double> vec3d;
+typedef vec4<double> vec4d;
+typedef mat4<double> mat4d;
+
+static std::mt19937 rng(1);
+
+static float Uniform(float lo, float hi)
+{
+	return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+static vec3f RandomUnit()
+{
+	vec3f v;
+	do
+		v = vec3f(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1));
+	while (v.norm2() < 0.1f || v.norm2() > 1.0f);
+	return normalize(v);
+}
+
+static mat4d ToDouble(const mat4f& m)
+{
+	mat4d M;
+	for (int i = 0; i < 16; i++)
+		M.array[i] = m.array[i];
+	return M;
+}
+
+// mul(M, v) of HLSL with column-major matrices, as M * v
+static vec4d Mul(const mat4d& M, const vec4d& v)
+{
+	return M.col[0] * v.x + M.col[1] * v.y + M.col[2] * v.z + M.col[3] * v.w;
+}
+
+static vec4d Mul(const mat4f& M, const vec4d& v)
+{
+	// In float, as the GPU does
+	const vec4f r = M * vec4f((float)v.x, (float)v.y, (float)v.z, (float)v.w);
+	return vec4d(r.x, r.y, r.z, r.w);
+}
+
+static double Distance(const vec4d& a, const vec4d& b)
+{
+	const vec4d d = a - b;
+	return std::sqrt(dot(d, d));
+}
+
+static vec3d Normalized(const vec3d& v)
+{
+	return v * (1.0 / v.norm2());
+}
+
+int main()
+{
+	// View-projection matrices as Camera builds them
+	const int nbr_cameras = 8;
+	std::vector<mat4f> projection(nbr_cameras), view(nbr_cameras);
+	for (int c = 0; c < nbr_cameras; c++)
+	{
+		projection[c] = mat4f::projection(Uniform(0.5f, 1.5f), Uniform(0.5f, 2.0f), 0.2f, 500.0f);
+		view[c] = inverse_rigid(mat4f::translation(Uniform(-50, 50), Uniform(-50, 50), Uniform(-50, 50)) *
+			mat4f::rotation(0, Uniform(-fPI, fPI), Uniform(-1.5f, 1.5f)));
+	}
+
+	// Model-to-world TRS matrices with non-uniform scaling
+	const int n = 4097;
+	std::vector<mat4f> model_to_world(n);
+	for (mat4f& M : model_to_world)
+		M = mat4f::translation(Uniform(-50, 50), Uniform(-50, 50), Uniform(-50, 50)) *
+			mat4f::rotation(Uniform(-fPI, fPI), RandomUnit()) *
+			mat4f::scaling(Uniform(0.1f, 10), Uniform(0.1f, 10), Uniform(0.1f, 10));
+
+	std::vector<mat4f> model_to_clip(n), model_to_clip_mt(n), normal(n);
+	normal_matrices(model_to_world.data(), normal.data(), n);
+
+	double max_clip = 0, max_clip_shader = 0, max_normal = 0, max_perpendicular = 0;
+	for (int c = 0; c < nbr_cameras; c++)
+	{
+		const mat4f view_projection = projection[c] * view[c];
+		transform_matrices(view_projection, model_to_world.data(), model_to_clip.data(), n);
+		transform_matrices(view_projection, model_to_world.data(), model_to_clip_mt.data(), n, 0);
+		const mat4d P = ToDouble(projection[c]), V = ToDouble(view[c]);
+
+		for (int i = 0; i < n; i++)
+		{
+			for (int k = 0; k < 16; k++)
+				CHECK(model_to_clip_mt[i].array[k] == model_to_clip[i].array[k]);
+
+			const mat4d W = ToDouble(model_to_world[i]);
+			const vec4d p(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1), 1);
+
+			// The current mul(ModelToClipMatrix, p) and the previous vertex
+			// shader, P * (V * (W * p)) in float, against the latter in double,
+			// relative to the clip w
+			const vec4d clip = Mul(P, Mul(V, Mul(W, p)));
+			const vec4d clip_cpu = Mul(model_to_clip[i], p);
+			const vec4d clip_shader = Mul(projection[c], Mul(view[c], Mul(model_to_world[i], p)));
+			max_clip = std::max(max_clip, Distance(clip_cpu, clip) / std::max(1.0, std::fabs(clip.w)));
+			max_clip_shader = std::max(max_clip_shader, Distance(clip_shader, clip) / std::max(1.0, std::fabs(clip.w)));
+
+			// mul(NormalMatrix, n).xyz against the inverse transpose of the
+			// upper 3x3 of W. Transformed normals stay perpendicular to
+			// tangents transformed by W
+			const vec3f nf = RandomUnit();
+			vec3f tf = nf % RandomUnit();
+			tf.normalize();
+			const vec3d nd(nf.x, nf.y, nf.z), td(tf.x, tf.y, tf.z);
+
+			const mat4d N = transpose(W.inverse());
+			const vec3d normal_ref = Normalized(Mul(N, vec4d(nd, 0)).xyz());
+			const vec3d normal_cpu = Normalized(Mul(normal[i], vec4d(nd, 0)).xyz());
+			const vec3d tangent = Normalized(Mul(W, vec4d(td, 0)).xyz());
+			max_normal = std::max(max_normal, (normal_cpu - normal_ref).norm2());
+			max_perpendicular = std::max(max_perpendicular, std::fabs(dot(normal_cpu, tangent)));
+		}
+	}
+	CHECK(max_clip < 1e-4);
+	CHECK(max_clip < 2 * max_clip_shader);
+	CHECK(max_normal < 1e-5);
+	CHECK(max_perpendicular < 1e-5);
+	std::printf("max error of clip positions relative to w %.3g (per-vertex in float %.3g), normals %.3g, |n.t| %.3g\n",
+		max_clip, max_clip_shader, max_normal, max_perpendicular);
+
+	return CheckResult();
+}
@@ -0,0 +1,176 @@
+//
+//  VertexFormatTests.cpp
+//
+//  Encode/decode round trips of the packed vertex format
+//
+
+#include <cfloat>
+#include <cstring>
+#include <random>
+#include "Check.h"
+#include "VertexFormat.h"
+
+using namespace linalg;
+
+// Angle in radians, atan2 of |a x b| and a.b to stay accurate near 0
+static float AngleBetween(const vec3f& a, const vec3f& b)
+{
+	const vec3<double> ad(a.x, a.y, a.z), bd(b.x, b.y, b.z);
+	return (float)std::atan2((ad % bd).norm2(), dot(ad, bd));
+}
+
+static vec3f RandomUnit(std::mt19937& rng)
+{
+	std::normal_distribution<float> N;
+	vec3f v;
+	do
+		v = { N(rng), N(rng), N(rng) };
+	while (v.norm2() < 1e-3f);
+	return normalize(v);
+}
+
+static void TestHalf()
+{
+	// Every half but NaN survives half -> float -> half
+	int mismatches = 0;
+	for (uint32_t h = 0; h < 0x10000; h++)
+	{
+		const bool nan = (h & 0x7c00) == 0x7c00 && (h & 0x3ff);
+		const float f = HalfToFloat((uint16_t)h);
+		if (nan)
+			mismatches += f == f;
+		else
+			mismatches += FloatToHalf(f) != h;
+	}
+	CHECK(mismatches == 0);
+
+	// float -> half -> float within half an ulp: relative 2^-11 for normal
+	// halves, absolute 2^-25 for subnormal ones
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> exponent(-24.0f, 15.9f);
+	double max_normal = 0, max_subnormal = 0;
+	for (int i = 0; i < 100000; i++)
+	{
+		const float f = std::exp2(exponent(rng)) * (i & 1 ? -1.0f : 1.0f);
+		const float g = HalfToFloat(FloatToHalf(f));
+		if (std::fabs(f) >= 6.103515625e-05f)
+			max_normal = std::max(max_normal, std::fabs((double)g - f) / std::fabs(f));
+		else
+			max_subnormal = std::max(max_subnormal, std::fabs((double)g - f));
+	}
+	CHECK(max_normal <= std::ldexp(1.0, -11));
+	CHECK(max_subnormal <= std::ldexp(1.0, -25));
+	std::printf("half: max relative error %.3g, max subnormal error %.3g\n", max_normal, max_subnormal);
+
+	// Rounding to nearest even, overflow, underflow and specials
+	CHECK(FloatToHalf(1.0f) == 0x3c00);
+	CHECK(FloatToHalf(1.0f + std::ldexp(1.0f, -11)) == 0x3c00);
+	CHECK(FloatToHalf(1.0f + 3 * std::ldexp(1.0f, -11)) == 0x3c02);
+	CHECK(FloatToHalf(-2.0f) == 0xc000);
+	CHECK(FloatToHalf(65504.0f) == 0x7bff);
+	CHECK(FloatToHalf(65520.0f) == 0x7c00);
+	CHECK(FloatToHalf(-1e10f) == 0xfc00);
+	CHECK(FloatToHalf(1e-10f) == 0x0000);
+	CHECK(FloatToHalf(-0.0f) == 0x8000);
+	CHECK(FloatToHalf(std::ldexp(1.0f, -24)) == 0x0001);
+	CHECK(HalfToFloat(0x7c00) == INFINITY);
+	CHECK(HalfToFloat(FloatToHalf(NAN)) != HalfToFloat(FloatToHalf(NAN)));
+}
+
+static void TestOctahedral()
+{
+	std::mt19937 rng(2);
+	const Vertex zero = {};
+	VertexQuantization quantization = ComputeVertexQuantization(&zero, 1);
+
+	// Unquantized, exact up to float rounding. Through SNORM16, within the
+	// angle of about half a quantization step
+	float max_exact = 0, max_packed = 0;
+	for (int i = 0; i < 100000; i++)
+	{
+		const vec3f n = RandomUnit(rng);
+		const vec2f e = OctEncode(n);
+		CHECK(std::fabs(e.x) <= 1.0f && std::fabs(e.y) <= 1.0f);
+		max_exact = std::max(max_exact, AngleBetween(OctDecode(e), n));
+
+		Vertex v = zero;
+		v.Normal = n;
+		v.Tangent = RandomUnit(rng);
+		v.Binormal = v.Normal % v.Tangent;
+		const Vertex u = UnpackVertex(PackVertex(v, quantization), quantization);
+		max_packed = std::max(max_packed, AngleBetween(u.Normal, v.Normal));
+		max_packed = std::max(max_packed, AngleBetween(u.Tangent, v.Tangent));
+		CHECK_NEAR(u.Normal.norm2(), 1.0, 1e-5);
+	}
+	CHECK(max_exact < 1e-6f);
+	CHECK(max_packed < 1e-4f);
+	std::printf("octahedral: max angle error %.3g rad, %.3g rad through SNORM16\n", max_exact, max_packed);
+
+	// Axes and the folded edges of the lower hemisphere
+	const vec3f axes[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	for (const vec3f& n : axes)
+		CHECK(AngleBetween(OctDecode(OctEncode(n)), n) < 1e-6f);
+}
+
+static void TestPositions()
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> U(-1.0f, 1.0f);
+
+	std::vector<Vertex> vertices(10000);
+	for (Vertex& v : vertices)
+	{
+		v.Pos = { 100.0f * U(rng), 0.01f * U(rng), 3.0f };	// z flat
+		v.Normal = { 0, 0, 1 };
+		v.Tangent = { 1, 0, 0 };
+		v.Binormal = U(rng) < 0 ? vec3f(0, 1, 0) : vec3f(0, -1, 0);
+		v.TexCoord = { U(rng), 4.0f * U(rng) };
+	}
+
+	std::vector<PackedVertex> packed;
+	VertexQuantization quantization;
+	PackVertices(vertices.data(), vertices.size(), packed, quantization);
+	CHECK(packed.size() == vertices.size());
+
+	// UNORM16 positions within half a step of the AABB extent, per axis
+	const vec3f step = quantization.PositionScale.xyz() * (1.0f / 65535.0f);
+	double max_error[3] = {};
+	int flipped = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& v = vertices[i];
+		const Vertex u = UnpackVertex(packed[i], quantization);
+		max_error[0] = std::max(max_error[0], std::fabs((double)u.Pos.x - v.Pos.x));
+		max_error[1] = std::max(max_error[1], std::fabs((double)u.Pos.y - v.Pos.y));
+		max_error[2] = std::max(max_error[2], std::fabs((double)u.Pos.z - v.Pos.z));
+		flipped += dot(u.Binormal, v.Binormal) < 0.0f;
+
+		CHECK_NEAR(u.TexCoord.x, v.TexCoord.x, std::ldexp(1.0, -11));
+		CHECK_NEAR(u.TexCoord.y, v.TexCoord.y, 4.0 * std::ldexp(1.0, -11));
+	}
+	// Plus float rounding of the dequantized value
+	CHECK(max_error[0] <= step.x * 0.5f + 100.0f * FLT_EPSILON);
+	CHECK(max_error[1] <= step.y * 0.5f + 0.01f * FLT_EPSILON);
+	CHECK(max_error[2] == 0.0);
+	CHECK(flipped == 0);
+	std::printf("positions: max error %.3g, %.3g, %.3g (half steps %.3g, %.3g)\n",
+		max_error[0], max_error[1], max_error[2], step.x * 0.5f, step.y * 0.5f);
+
+	// The AABB corners are exact
+	vertices[0].Pos = { -100, -0.01f, 3 };
+	vertices[1].Pos = { 100, 0.01f, 3 };
+	quantization = ComputeVertexQuantization(vertices.data(), vertices.size());
+	const Vertex lo = UnpackVertex(PackVertex(vertices[0], quantization), quantization);
+	const Vertex hi = UnpackVertex(PackVertex(vertices[1], quantization), quantization);
+	CHECK(lo.Pos.x == -100.0f && lo.Pos.y == -0.01f);
+	CHECK_NEAR(hi.Pos.x, 100.0, 1e-5);
+	CHECK_NEAR(hi.Pos.y, 0.01, 1e-9);
+}
+
+int main()
+{
+	TestHalf();
+	TestOctahedral();
+	TestPositions();
+	return CheckResult();
+}
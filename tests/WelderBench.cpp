@@ -0,0 +1,116 @@
+//
+//  WelderBench.cpp
+//
+//  Welding of OBJ index triplets with vertex_welder_t, against the
+//  unordered_map it replaced, on coherent and seam-heavy meshes
+//
+
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "Check.h"
+#include "VertexWelder.h"
+
+// The hash of the old OBJLoader, the position index only
+struct position_hash_t
+{
+	size_t operator ()(const int3& key) const { return key.x; }
+};
+
+// A hash of all three indices, to tell the table from the hash
+struct triplet_hash_t
+{
+	size_t operator ()(const int3& key) const { return vertex_welder_t::hash(key); }
+};
+
+//
+// Corners of a smooth grid mesh, w x h quads as triangles, where
+// position, normal and texcoord indices are the same
+//
+static std::vector<int3> SmoothGrid(int w, int h)
+{
+	std::vector<int3> corners;
+	corners.reserve((size_t)w * h * 6);
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+		{
+			const int i0 = y * (w + 1) + x, i1 = i0 + 1, i2 = i0 + w + 1, i3 = i2 + 1;
+			for (int i : { i0, i1, i2, i1, i3, i2 })
+				corners.push_back({ i, i, i });
+		}
+	return corners;
+}
+
+//
+// Corners of a hub mesh: nbr_quads faceted quads, as triangles, between
+// few positions, so that each position is welded into many vertices that
+// differ by normal and texcoord
+//
+static std::vector<int3> SeamHub(int nbr_positions, int nbr_quads)
+{
+	std::vector<int3> corners;
+	corners.reserve((size_t)nbr_quads * 6);
+	std::mt19937 rng(1);
+	for (int q = 0; q < nbr_quads; q++)
+	{
+		int p[4];
+		for (int& i : p)
+			i = (int)(rng() % nbr_positions);
+		for (int c : { 0, 1, 2, 0, 2, 3 })
+			corners.push_back({ p[c], q, c });
+	}
+	return corners;
+}
+
+//
+// Welded vertex count of corners, as OBJLoader welds a drawcall
+//
+static size_t WeldTable(vertex_welder_t& welder, const std::vector<int3>& corners)
+{
+	welder.Clear(corners.size() / 6);
+	unsigned nbr_vertices = 0, index;
+	for (const int3& key : corners)
+		nbr_vertices += welder.Insert(key, nbr_vertices, index);
+	return nbr_vertices;
+}
+
+template<class Hash>
+static size_t WeldMap(const std::vector<int3>& corners)
+{
+	std::unordered_map<int3, unsigned, Hash> map;
+	for (const int3& key : corners)
+		map.insert({ key, (unsigned)map.size() });
+	return map.size();
+}
+
+static void Bench(const char* name, const std::vector<int3>& corners, bool position_hash)
+{
+	const int reps = 3;
+	vertex_welder_t welder;
+	size_t vertices_table = 0, vertices_map = 0, vertices_position = 0;
+
+	const double table_ms = BenchMs(reps, [&]() { vertices_table = WeldTable(welder, corners); });
+	const double map_ms = BenchMs(reps, [&]() { vertices_map = WeldMap<triplet_hash_t>(corners); });
+	double position_ms = 0;
+	if (position_hash)
+		position_ms = BenchMs(1, [&]() { vertices_position = WeldMap<position_hash_t>(corners); });
+
+	CHECK(vertices_table == vertices_map);
+	CHECK(!position_hash || vertices_position == vertices_map);
+
+	const double ns = 1e6 / corners.size();
+	std::printf("%-12s %8zu corners %8zu vertices | welder %7.2f ms (%5.1f ns) | unordered_map %7.2f ms (%5.1f ns)",
+		name, corners.size(), vertices_table, table_ms, table_ms * ns, map_ms, map_ms * ns);
+	if (position_hash)
+		std::printf(" | old hash %8.2f ms (%6.1f ns)", position_ms, position_ms * ns);
+	std::printf("\n");
+}
+
+int main()
+{
+	Bench("grid 64x64", SmoothGrid(64, 64), true);
+	Bench("grid 1k x 1k", SmoothGrid(1000, 1000), true);
+	Bench("hub 64", SeamHub(64, 20000), true);
+	Bench("hub 1k", SeamHub(1024, 500000), false);
+	return CheckResult();
+}